@@ -24,6 +24,49 @@
 Area::Area(const std::string& localAuthorityCode)
         : areaAuthCode(localAuthorityCode) {}
 
+/*
+  Construct an empty Area whose containers allocate from `alloc`, e.g. when
+  a container of an Areas object creates one in place.
+
+  @param alloc
+    The allocator to use
+*/
+Area::Area(const allocator_type& alloc) : names(alloc), measures(alloc) {}
+
+/*
+  Copy (or move) an Area, allocating the copy's names and Measures from
+  `alloc`. The container in Areas uses these constructors to keep every
+  Area in its arena.
+
+  @param other
+    The Area to copy
+
+  @param alloc
+    The allocator to use
+*/
+Area::Area(const Area& other, const allocator_type& alloc)
+    : areaAuthCode(other.areaAuthCode),
+      names(other.names, alloc),
+      measures(other.measures, alloc) {}
+
+Area::Area(Area&& other, const allocator_type& alloc)
+    : areaAuthCode(other.areaAuthCode),
+      names(std::move(other.names), alloc),
+      measures(std::move(other.measures), alloc) {}
+
+/*
+  Construct an Area with an already interned local authority code.
+
+  @param localAuthorityCode
+    The local authority code of the Area
+
+  @param alloc
+    The allocator for the Area's names and Measures, e.g. of the Areas
+    object the Area is created in
+*/
+Area::Area(Symbol localAuthorityCode, const allocator_type& alloc)
+        : areaAuthCode(localAuthorityCode), names(alloc), measures(alloc) {}
+
 /*
   Retrieve the local authority code for this Area. Should be 
   callable from a constant context and not modify the state of the instance.
@@ -31,7 +74,7 @@ Area::Area(const std::string& localAuthorityCode)
   @return
     The Area's local authority code
 */
-std::string Area::getLocalAuthorityCode() const {
+const std::string& Area::getLocalAuthorityCode() const {
   return areaAuthCode;
 }
 
@@ -58,12 +101,14 @@ std::string Area::getLocalAuthorityCode() const {
     ...
     auto name = area.getName(langCode);
 */
-std::string Area::getName(const std::string& lang) const {
+const std::string& Area::getName(const std::string& lang) const {
     std::string langLower = lang;
     std::transform(langLower.begin(), langLower.end(), langLower.begin(), ::tolower);
 
-    auto it = names.find(langLower);
-    if (it == names.end()) {
+    // A language that has never been interned cannot be one of the names
+    auto langSymbol = Symbol::find(langLower);
+    auto it = langSymbol ? names.find(*langSymbol) : nullptr;
+    if (it == nullptr) {
         throw std::out_of_range("Language not found");
     }
 
@@ -97,7 +142,26 @@ std::string Area::getName(const std::string& lang) const {
 void Area::setName(const std::string& lang, const std::string& name) {
   std::string langLower = lang;
   std::transform(langLower.begin(), langLower.end(), langLower.begin(), ::tolower);
-  names[langLower] = name;
+  names[Symbol(langLower)] = Symbol(name);
+}
+
+/*
+  Set a name for the Area in a specific language, from already interned
+  strings.
+
+  @param lang
+    A three-letter language code in ISO 639-3 format, which must already
+    be in lowercase
+
+  @param name
+    The name of the Area in `lang`
+
+  @example
+    Area area("W06000023");
+    area.setName(Symbol("eng"), Symbol("Powys"));
+*/
+void Area::setName(Symbol lang, Symbol name) {
+  names[lang] = name;
 }
 
 /*
@@ -107,7 +171,7 @@ void Area::setName(const std::string& lang, const std::string& name) {
     The codename for the measure you want to retrieve
 
   @return
-    A Measure object
+    A reference to the Measure in this Area, which is not copied
 
   @throws
     std::out_of_range if there is no measure with the given code, throwing
@@ -121,17 +185,14 @@ void Area::setName(const std::string& lang, const std::string& name) {
     ...
     auto measure2 = area.getMeasure("pop");
 */
-Measure Area::getMeasure(const std::string &key) const {
-  // Convert key to lowercase for case-insensitivity
-  std::string keyLower = key;
-  std::transform(keyLower.begin(), keyLower.end(), keyLower.begin(), ::tolower);
-
-
-  // Look up measure in the map
-  auto it = measures.find(key);
+const Measure& Area::getMeasure(const std::string &key) const {
+  // Look up measure in the map (the codenames are interned in lowercase, so
+  // a key that is not in lowercase is never found)
+  auto keySymbol = Symbol::find(key);
+  auto it = keySymbol ? measures.find(*keySymbol) : nullptr;
 
   // If the measure is not found, throw an exception
-  if (it == measures.end()) {
+  if (it == nullptr) {
     throw std::out_of_range("No measure found matching " + key);
   }
 
@@ -139,6 +200,25 @@ Measure Area::getMeasure(const std::string &key) const {
   return it->second;
 }
 
+/*
+  As above, but the Measure returned can be modified.
+
+  @param key
+    The codename for the measure you want to retrieve
+
+  @return
+    A reference to the Measure in this Area
+
+  @throws
+    std::out_of_range if there is no measure with the given code
+
+  @example
+    area.getMeasure("pop").setValue(2020, 12345678.9);
+*/
+Measure& Area::getMeasure(const std::string &key) {
+  return const_cast<Measure&>(static_cast<const Area&>(*this).getMeasure(key));
+}
+
 
 /*
   Add a particular Measure to this Area object. Measure's codename should be
@@ -173,11 +253,144 @@ void Area::setMeasure(const std::string& code, const Measure& measure) {
   std::string codeLower = code;
   std::transform(codeLower.begin(), codeLower.end(), codeLower.begin(), ::tolower);
 
-  auto it = measures.find(codeLower);
-  if (it != measures.end()) {
-    it->second.combine(measure);
-  } else {
-    measures[codeLower] = measure;
+  setMeasure(Symbol(codeLower), measure);
+}
+
+/*
+  As above, but moves the Measure into this Area if it does not have one
+  with the same codename yet, rather than copying it.
+
+  @param codename
+    The codename for the Measure
+
+  @param measure
+    The Measure object, which is left in a valid but unspecified state
+
+  @example
+    Area area("W06000023");
+    Measure measure("Pop", "Population");
+    measure.setValue(1999, 12345678.9);
+    area.setMeasure("Pop", std::move(measure));
+*/
+void Area::setMeasure(const std::string& code, Measure&& measure) {
+  std::string codeLower = code;
+  std::transform(codeLower.begin(), codeLower.end(), codeLower.begin(), ::tolower);
+
+  setMeasure(Symbol(codeLower), std::move(measure));
+}
+
+
+/*
+  Add a particular Measure to this Area object, as with the function above,
+  given an already interned codename.
+
+  @param codename
+    The codename for the Measure, which must already be in lowercase
+
+  @param measure
+    The Measure object
+
+  @return
+    void
+
+  @example
+    Area area("W06000023");
+    Measure measure("pop", "Population");
+    area.setMeasure(measure.getCodenameSymbol(), measure);
+*/
+void Area::setMeasure(Symbol code, const Measure& measure) {
+  auto emplaced = measures.try_emplace(code, measure);
+  if (!emplaced.second) {
+    emplaced.first->second.combine(measure);
+  }
+}
+
+/*
+  As above, but moves the Measure into this Area if it does not have one
+  with the same codename yet. A Measure built with this Area's allocator
+  (see Measure(Symbol, Symbol, const allocator_type&)) is moved without
+  copying its values.
+
+  @param codename
+    The codename for the Measure, which must already be in lowercase
+
+  @param measure
+    The Measure object, which is left in a valid but unspecified state
+
+  @example
+    Area area("W06000023");
+    Measure measure(Symbol("pop"), Symbol("Population"));
+    area.setMeasure(measure.getCodenameSymbol(), std::move(measure));
+*/
+void Area::setMeasure(Symbol code, Measure&& measure) {
+  auto emplaced = measures.try_emplace(code, std::move(measure));
+  if (!emplaced.second) {
+    emplaced.first->second.combine(measure);
+  }
+}
+
+
+/*
+  Retrieve the Measure with a given codename, creating an empty one with the
+  given label if the Area does not have it yet, in a single lookup. Setting
+  values on the returned Measure has the same effect as passing a Measure
+  with those values to setMeasure().
+
+  @param codename
+    The codename for the Measure, which must already be in lowercase
+
+  @param label
+    The label for the Measure, if it has to be created
+
+  @return
+    A reference to the Measure in this Area
+
+  @example
+    Area area("W06000023");
+    area.emplaceMeasure(Symbol("pop"), Symbol("Population"))
+        .setValue(1999, 12345678.9);
+*/
+Measure& Area::emplaceMeasure(Symbol code, Symbol label) {
+  return measures.try_emplace(code, code, label).first->second;
+}
+
+/*
+  Add every Measure of another Area to this one, as setMeasure() would,
+  moving the Measures this Area does not have yet rather than copying them.
+  The names of this Area are not changed.
+
+  @param other
+    The Area whose Measures to add, which is left without Measures
+
+  @example
+    Area area("W06000023");
+    Area more("W06000023");
+    ...
+    area.combineMeasures(std::move(more));
+*/
+void Area::combineMeasures(Area&& other) {
+  for (auto& measurePair : other.measures) {
+    setMeasure(measurePair.first, std::move(measurePair.second));
+  }
+  other.measures.clear();
+}
+
+/*
+  As above, but copies every Measure of another Area into this one (and
+  its allocator), leaving `other` unchanged.
+
+  @param other
+    The Area whose Measures to add
+
+  @example
+    Area area("W06000023");
+    Area more("W06000023");
+    ...
+    area.combineMeasures(more);
+*/
+void Area::combineMeasures(const Area& other) {
+  for (const auto& measurePair : other.measures) {
+    setMeasure(measurePair.first, measurePair.second);
   }
 }
 
@@ -239,7 +452,7 @@ std::ostream& operator<<(std::ostream& os, const Area& area) {
     } else if (area.names.size() == 1) {
         os << area.names.begin()->second << std::endl;
     } else {
-        os << area.names.find("eng")->second << " / " << area.names.find("cym")->second << std::endl;
+        os << area.names.find(Symbol("eng"))->second << " / " << area.names.find(Symbol("cym"))->second << std::endl;
     }
 
     // Output the local authority code
@@ -249,7 +462,7 @@ std::ostream& operator<<(std::ostream& os, const Area& area) {
     if (area.measures.empty()) {
         os << "<no measures>" << std::endl;
     } else {
-        for (std::pair<std::string, Measure> const& p : area.measures) {
+        for (const auto &p : area.measures) {
             os << p.second << std::endl;
         }
     }
@@ -15,34 +15,63 @@
 
 #include <string>
 #include <map>
+#include <memory_resource>
 #include <algorithm>
 
+#include "containers.h"
 #include "measure.h"
+#include "symbol.h"
 
 /*
   An Area object consists of a unique authority code, a container for names
   for the area in any number of different languages, and a container for the
-  Measures objects.
+  Measures objects. The codes and names are interned (see Symbol), so
+  copying an Area or looking up one of its Measures does not copy strings.
+
+  Area is allocator-aware, so the Areas stored in an Areas object (and their
+  Measures) allocate from that Areas object's arena.
 */
 class Area {
   private:
-    std::string areaAuthCode;
-    std::map<std::string, std::string> names;
-    std::map<std::string, Measure> measures;
+    Symbol areaAuthCode;
+    SortedVectorMap<Symbol, Symbol> names;
+    SortedVectorMap<Symbol, Measure> measures;
   public:
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
     Area() {};
+    explicit Area(const allocator_type& alloc);
+    Area(const Area& other) = default;
+    Area(Area&& other) = default;
+    Area(const Area& other, const allocator_type& alloc);
+    Area(Area&& other, const allocator_type& alloc);
+    Area& operator=(const Area& other) = default;
+    Area& operator=(Area&& other) = default;
     Area(const std::string& localAuthorityCode);
-    std::string getLocalAuthorityCode() const;
+    Area(Symbol localAuthorityCode, const allocator_type& alloc = {});
+    const std::string& getLocalAuthorityCode() const;
+    Symbol getLocalAuthoritySymbol() const { return areaAuthCode; }
     void setName(const std::string& lang, const std::string& name);
-    std::string getName(const std::string& lang) const;
+    void setName(Symbol lang, Symbol name);
+    const std::string& getName(const std::string& lang) const;
     void setMeasure(const std::string& code, const Measure& measure);
-    Measure getMeasure(const std::string& code) const;
+    void setMeasure(const std::string& code, Measure&& measure);
+    void setMeasure(Symbol code, const Measure& measure);
+    void setMeasure(Symbol code, Measure&& measure);
+    Measure& emplaceMeasure(Symbol code, Symbol label);
+    void combineMeasures(Area&& other);
+    void combineMeasures(const Area& other);
+    const Measure& getMeasure(const std::string& code) const;
+    Measure& getMeasure(const std::string& code);
     std::size_t size() const;
     friend std::ostream& operator<<(std::ostream& os, const Area& area);
     friend bool operator==(const Area& lhs, const Area& rhs);
-    const std::map<std::string, Measure>& getMeasures() const {
+    const SortedVectorMap<Symbol, Measure>& getMeasures() const {
       return measures;
     };
+    const SortedVectorMap<Symbol, Symbol>& getNames() const {
+      return names;
+    };
 };
 
 #endif // AREA_H_
\ No newline at end of file
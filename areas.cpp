@@ -16,28 +16,383 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <stdexcept>
 #include <tuple>
+#include <unordered_map>
 #include <unordered_set>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <exception>
+#include <functional>
 
 #include "lib_json.hpp"
 
+#include "csv.h"
 #include "datasets.h"
 #include "areas.h"
+#include "filter.h"
 #include "measure.h"
+#include "output.h"
+#include "profile.h"
+#include "parallel.h"
+#include "symbol.h"
 
 /*
   An alias for the imported JSON parsing library.
 */
 using json = nlohmann::json;
 
+/*
+  The language codes of the names in the datasets.
+*/
+static const Symbol LANG_ENG("eng");
+static const Symbol LANG_CYM("cym");
+
+/*
+  A SAX event handler for the WelshStatsJSON format. Rather than building the
+  whole document in memory, the values of each element of the top-level
+  "value" array are collected into a fixed set of fields (one for each key
+  named in the column mapping), handed to a callback, and then reused for
+  the next element. Peak memory therefore depends on the size of a single
+  row, not on the size of the file, and once the fields have grown to fit
+  the longest values no memory is allocated per row.
+
+  Each key is looked up in the column mapping once per dataset: rows tend
+  to list their keys in the same order, so a key is first compared with the
+  key in the same position of the previous row.
+*/
+class WelshStatsJSONHandler : public nlohmann::json_sax<json> {
+public:
+  /*
+    The value of a column in the current row.
+  */
+  struct Field {
+    enum Type { ABSENT, STRING, NUMBER, BOOLEAN };
+
+    Type type = ABSENT;
+    std::string text;
+    double number = 0;
+  };
+
+  using RowCallback = std::function<void(const WelshStatsJSONHandler&)>;
+
+  WelshStatsJSONHandler(const BethYw::SourceColumnMapping &cols,
+                        RowCallback onRow)
+      : onRow(std::move(onRow)), fields(1) {
+    // Field 0 is always absent, for keys and columns not in the mapping
+    columnFields.fill(0);
+    for (const auto &col : cols) {
+      auto it = keyFields.find(col.second);
+      if (it == keyFields.end()) {
+        it = keyFields.emplace(col.second, fields.size()).first;
+        fields.emplace_back();
+      }
+      columnFields[col.first] = it->second;
+    }
+  }
+
+  /*
+    The field of a column in the current row, which is absent if the column
+    is not in the mapping or the row has no (scalar, non-null) value for it.
+  */
+  const Field& field(BethYw::SourceColumn col) const {
+    return fields[columnFields[col]];
+  }
+
+  /*
+    Whether any column of the current row has a boolean value.
+  */
+  bool hasBoolean() const {
+    return rowHasBoolean;
+  }
+
+  bool null() override { return scalar(); }
+  bool boolean(bool) override {
+    if (Field *f = scalarField()) {
+      f->type = Field::BOOLEAN;
+      rowHasBoolean = true;
+    }
+    return scalar();
+  }
+  bool number_integer(number_integer_t val) override {
+    return number(static_cast<double>(val));
+  }
+  bool number_unsigned(number_unsigned_t val) override {
+    return number(static_cast<double>(val));
+  }
+  bool number_float(number_float_t val, const string_t&) override {
+    return number(val);
+  }
+  bool string(string_t& val) override {
+    if (Field *f = scalarField()) {
+      f->type = Field::STRING;
+      // The parser clears its buffer before reusing it, so the buffers can
+      // be swapped rather than copied
+      f->text.swap(val);
+    }
+    return scalar();
+  }
+  bool binary(binary_t&) override { return scalar(); }
+
+  bool start_object(std::size_t) override {
+    if (inValues && depth == valuesDepth) {
+      for (auto &f : fields) {
+        f.type = Field::ABSENT;
+      }
+      rowHasBoolean = false;
+      keyPosition = 0;
+      inRow = true;
+    }
+    currentField = 0;
+    depth++;
+    return true;
+  }
+
+  bool key(string_t& val) override {
+    if (depth == 1) {
+      nextIsValues = (val == "value");
+    } else if (inRow && depth == valuesDepth + 1) {
+      if (keyPosition < keyOrder.size() && keyOrder[keyPosition].first == val) {
+        currentField = keyOrder[keyPosition].second;
+      } else {
+        auto it = keyFields.find(val);
+        currentField = it == keyFields.end() ? 0 : it->second;
+        if (keyPosition < keyOrder.size()) {
+          keyOrder[keyPosition] = {val, currentField};
+        } else {
+          keyOrder.emplace_back(val, currentField);
+        }
+      }
+      keyPosition++;
+    }
+    return true;
+  }
+
+  bool end_object() override {
+    depth--;
+    if (inRow && depth == valuesDepth) {
+      inRow = false;
+      onRow(*this);
+    }
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    if (depth == 1 && nextIsValues) {
+      inValues = true;
+      valuesDepth = depth + 1;
+    }
+    currentField = 0;
+    depth++;
+    return true;
+  }
+
+  bool end_array() override {
+    depth--;
+    if (inValues && depth + 1 == valuesDepth) {
+      inValues = false;
+    }
+    return true;
+  }
+
+  bool parse_error(std::size_t,
+                   const std::string&,
+                   const nlohmann::detail::exception& ex) override {
+    throw std::runtime_error(ex.what());
+  }
+
+private:
+  /*
+    The field a scalar value should be stored in, or null if it should be
+    ignored. Only scalars directly inside a row are kept, nested values are
+    ignored.
+  */
+  Field* scalarField() {
+    if (inRow && currentField != 0 && depth == valuesDepth + 1) {
+      return &fields[currentField];
+    }
+    return nullptr;
+  }
+
+  bool number(double val) {
+    if (Field *f = scalarField()) {
+      f->type = Field::NUMBER;
+      f->number = val;
+    }
+    return scalar();
+  }
+
+  bool scalar() {
+    currentField = 0;
+    return true;
+  }
+
+  RowCallback onRow;
+  std::vector<Field> fields;
+  std::array<std::size_t, BethYw::VALUE + 1> columnFields;
+  std::unordered_map<std::string, std::size_t> keyFields;
+  std::vector<std::pair<std::string, std::size_t>> keyOrder;
+
+  std::size_t keyPosition = 0;
+  std::size_t currentField = 0;
+  std::size_t depth = 0;
+  std::size_t valuesDepth = 0;
+  bool nextIsValues = false;
+  bool inValues = false;
+  bool inRow = false;
+  bool rowHasBoolean = false;
+};
+
+/*
+  The text of a WelshStatsJSON field, with numbers formatted as by
+  std::to_string() and absent fields as an empty string.
+
+  @param field
+    The field
+
+  @param scratch
+    A buffer for formatting numbers in
+
+  @return
+    A view of the field's text, valid until the next row or use of `scratch`
+*/
+static std::string_view fieldText(const WelshStatsJSONHandler::Field &field,
+                                  std::string &scratch) {
+  switch (field.type) {
+  case WelshStatsJSONHandler::Field::STRING:
+    return field.text;
+  case WelshStatsJSONHandler::Field::NUMBER:
+    scratch = std::to_string(field.number);
+    return scratch;
+  default:
+    return std::string_view();
+  }
+}
+
+/*
+  Resolves a value of successive rows (e.g. the area code) to a Symbol. The
+  previous value is remembered, so runs of rows with the same value skip
+  the interning table. A value that is not in the filter is rejected
+  without being interned.
+*/
+class RowSymbol {
+public:
+  RowSymbol(const Filter::Set &filter, bool lowercase)
+      : filter(filter), lowercase(lowercase) {}
+
+  /*
+    Resolve a value, setting `symbol` if it passes the filter.
+
+    @param text
+      The value, as it appears in the row
+
+    @return
+      true if the value passes the filter
+  */
+  bool resolve(std::string_view text) {
+    if (hasLast && text == lastText) {
+      return lastPasses;
+    }
+    hasLast = true;
+    lastText.assign(text.data(), text.size());
+
+    std::string_view key = text;
+    if (lowercase) {
+      lowered.assign(text.data(), text.size());
+      std::transform(lowered.begin(), lowered.end(), lowered.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+      key = lowered;
+    }
+
+    auto found = filter.find(key);
+    lastPasses = found.has_value();
+    if (lastPasses) {
+      symbol = *found;
+    }
+    return lastPasses;
+  }
+
+  Symbol symbol;
+
+private:
+  const Filter::Set &filter;
+  const bool lowercase;
+  std::string lastText;
+  std::string lowered;
+  bool hasLast = false;
+  bool lastPasses = false;
+};
+
 /*
   Constructor for an Areas object.
 */
-Areas::Areas() {
+Areas::Areas() : storage(std::make_unique<Storage>()) {
+
+}
+
+/*
+  Copy an Areas object, copying all of its data into a new arena.
+
+  @param other
+    The Areas object to copy
+*/
+Areas::Areas(const Areas& other)
+    : storage(std::make_unique<Storage>()), threads(other.threads) {
+  // Assignment keeps the container's own allocator, unlike copy construction
+  storage->areas = other.storage->areas;
+}
+
+/*
+  Move an Areas object, taking its arena with it. `other` is left empty.
+
+  @param other
+    The Areas object to move from
+*/
+Areas::Areas(Areas&& other)
+    : storage(std::make_unique<Storage>()), threads(other.threads) {
+  std::swap(storage, other.storage);
+}
+
+/*
+  Replace the data in this Areas object with a copy of another's, in a new
+  arena.
+
+  @param other
+    The Areas object to copy
+
+  @return
+    This Areas object
+*/
+Areas& Areas::operator=(const Areas& other) {
+  if (this != &other) {
+    auto copy = std::make_unique<Storage>();
+    copy->areas = other.storage->areas;
+    storage = std::move(copy);
+    threads = other.threads;
+  }
+  return *this;
+}
+
+/*
+  Replace the data in this Areas object with another's, taking its arena
+  with it. `other` is left empty.
+
+  @param other
+    The Areas object to move from
 
+  @return
+    This Areas object
+*/
+Areas& Areas::operator=(Areas&& other) {
+  if (this != &other) {
+    storage = std::move(other.storage);
+    other.storage = std::make_unique<Storage>();
+    threads = other.threads;
+  }
+  return *this;
 }
 
 /*
@@ -64,16 +419,180 @@ Areas::Areas() {
     data.setArea(localAuthorityCode, area);
 */
 void Areas::setArea(const std::string &localAuthorityCode, Area area) {
-  // check if the area already exists
-  auto it = areas.find(localAuthorityCode);
-  if (it != areas.end()) {
-    // if it exists, update the existing area with the new area's data
-    Area& existingArea = it->second;
-    existingArea = area;
-  } else {
-    // if it doesn't exist, insert the new area into the map
-    areas.emplace(localAuthorityCode, std::move(area));
+  setArea(Symbol(localAuthorityCode), std::move(area));
+}
+
+/*
+  As above, given an already interned local authority code. The Area is
+  moved into place rather than copied (into this Areas object's arena).
+
+  @param localAuthorityCode
+    The local authority code of the Area
+
+  @param area
+    The Area object that will contain the Measure objects
+
+  @example
+    Areas data = Areas();
+    Area area(Symbol("W06000023"));
+    data.setArea(area.getLocalAuthoritySymbol(), std::move(area));
+*/
+void Areas::setArea(Symbol localAuthorityCode, Area area) {
+  invalidateIndexes();
+
+  // insert the area if it doesn't exist yet, otherwise replace the existing
+  // area's data with the new area's
+  auto emplaced = storage->areas.try_emplace(localAuthorityCode, std::move(area));
+  if (!emplaced.second) {
+    emplaced.first->second = std::move(area);
+  }
+}
+
+
+
+/*
+  Merge the Area objects of another Areas instance into this one, e.g. when
+  datasets have been imported into separate Areas objects in parallel.
+
+  Areas that do not exist yet are moved across as they are. For Areas that
+  already exist, the names already stored are kept (as with insertArea())
+  and every Measure is added with Area::setMeasure(), so values from `other`
+  take precedence (see Measure::combine()). Merging the results of several
+  imports in the order they would have been imported therefore gives the
+  same result as importing them all into one Areas instance.
+
+  @param other
+    The Areas instance to merge into this one, which is left in a valid but
+    unspecified state
+
+  @return
+    void
+
+  @example
+    Areas data = Areas();
+    Areas popden = Areas();
+    ...
+    data.merge(std::move(popden));
+*/
+void Areas::merge(Areas&& other) {
+  invalidateIndexes();
+  other.invalidateIndexes();
+  for (auto &areaPair : other.storage->areas) {
+    auto emplaced = storage->areas.try_emplace(areaPair.first, std::move(areaPair.second));
+    if (!emplaced.second) {
+      emplaced.first->second.combineMeasures(std::move(areaPair.second));
+    }
+  }
+  other.storage->areas.clear();
+}
+
+/*
+  As above, but copies the Areas and Measures of `other` straight into this
+  Areas object's arena, leaving `other` unchanged. This saves copying all of
+  `other` first to move it in.
+
+  @param other
+    The Areas instance to merge into this one
+
+  @return
+    void
+
+  @example
+    Areas data = Areas();
+    const Areas &popden = ...;
+    data.merge(popden);
+*/
+void Areas::merge(const Areas& other) {
+  if (this == &other) {
+    return;
+  }
+  invalidateIndexes();
+  for (const auto &areaPair : other.storage->areas) {
+    auto emplaced = storage->areas.try_emplace(areaPair.first, areaPair.second);
+    if (!emplaced.second) {
+      emplaced.first->second.combineMeasures(areaPair.second);
+    }
+  }
+}
+
+/*
+  Copy the areas, measures and years that match a Filter into a new Areas
+  object, as if only they had been imported. As with importing, every
+  matching Area is kept (even if none of its Measures match), and a Measure
+  is only kept if it has a value in one of the matching years.
+
+  @param filter
+    The areas, measures and years to keep
+
+  @return
+    A new Areas object with copies of the matching data
+
+  @example
+    StringFilterSet measures = {"pop"};
+    Areas populations = data.select(Filter(nullptr, &measures, nullptr));
+*/
+Areas Areas::select(const Filter &filter) const {
+  Areas selected;
+  selected.threads = threads;
+
+  for (const auto &areaPair : storage->areas) {
+    if (!filter.areas().contains(areaPair.first)) {
+      continue;
+    }
+
+    const auto &area = areaPair.second;
+    Area &copy = selected.storage->areas.try_emplace(areaPair.first,
+                                                     areaPair.first).first->second;
+    for (const auto &namePair : area.getNames()) {
+      copy.setName(namePair.first, namePair.second);
+    }
+
+    for (const auto &measurePair : area.getMeasures()) {
+      if (!filter.measures().contains(measurePair.first)) {
+        continue;
+      }
+
+      const auto &measure = measurePair.second;
+      if (filter.allYears()) {
+        copy.setMeasure(measurePair.first, measure);
+        continue;
+      }
+
+      Measure* kept = nullptr;
+      for (const auto &yearValue : measure.getYears()) {
+        if (!filter.matchesYear(yearValue.first)) {
+          continue;
+        }
+        if (kept == nullptr) {
+          kept = &copy.emplaceMeasure(measurePair.first, measure.getLabelSymbol());
+        }
+        kept->setValue(yearValue.first, yearValue.second);
+      }
+    }
   }
+
+  return selected;
+}
+
+
+
+/*
+  Set the number of threads a single populate() call may use. Currently only
+  large AuthorityByYearCSV buffers are split between threads.
+
+  @param numThreads
+    The maximum number of threads, where 1 (the default) parses everything
+    on the calling thread
+
+  @return
+    void
+
+  @example
+    Areas data = Areas();
+    data.setThreads(4);
+*/
+void Areas::setThreads(unsigned int numThreads) {
+  threads = std::max(1u, numThreads);
 }
 
 
@@ -100,8 +619,13 @@ void Areas::setArea(const std::string &localAuthorityCode, Area area) {
     Area area2 = areas.getArea("W06000023");
 */
 Area& Areas::getArea(const std::string& localAuthorityCode) {
-    auto it = areas.find(localAuthorityCode);
-    if (it == areas.end()) {
+    // The caller may modify the Area through the reference
+    invalidateIndexes();
+
+    // A code that has never been interned cannot be one of the areas
+    auto code = Symbol::find(localAuthorityCode);
+    auto it = code ? storage->areas.find(*code) : nullptr;
+    if (it == nullptr) {
         throw std::out_of_range("Area not found");
     }
     return it->second;
@@ -126,7 +650,163 @@ Area& Areas::getArea(const std::string& localAuthorityCode) {
     auto size = areas.size(); // returns 1
 */
 std::size_t Areas::size() const {
-    return areas.size();
+    return storage->areas.size();
+}
+
+
+
+/*
+  Build the secondary indexes over the areas, or return them if they are
+  already built. They are built at most once between modifications, however
+  many threads ask for them at once.
+
+  @return
+    The secondary indexes, which are valid until the Areas object is next
+    modified
+*/
+const Areas::Indexes& Areas::indexes() const {
+  std::lock_guard<std::mutex> lock(storage->indexMutex);
+  if (storage->indexes) {
+    return *storage->indexes;
+  }
+
+  auto built = std::make_unique<Indexes>();
+  for (const auto &areaPair : storage->areas) {
+    for (const auto &measurePair : areaPair.second.getMeasures()) {
+      built->measures[measurePair.first].push_back({areaPair.first,
+                                                    &measurePair.second});
+    }
+  }
+
+  // Going through the measures in order, and each measure's areas in order,
+  // leaves every year's values sorted by measure then area
+  for (const auto &measurePair : built->measures) {
+    for (const auto &entry : measurePair.second) {
+      for (const auto &yearValue : entry.measure->getYears()) {
+        built->years[yearValue.first].push_back({entry.area,
+                                                 measurePair.first,
+                                                 yearValue.second});
+      }
+    }
+  }
+
+  storage->indexes = std::move(built);
+  return *storage->indexes;
+}
+
+/*
+  Throw away the secondary indexes, before the areas are modified.
+*/
+void Areas::invalidateIndexes() {
+  std::lock_guard<std::mutex> lock(storage->indexMutex);
+  storage->indexes.reset();
+}
+
+/*
+  Retrieve every Area's Measure with a given codename, without searching
+  each Area for it. The index is built (over all measures) on first use.
+
+  @param measureCode
+    The codename of the Measure
+
+  @return
+    A (possibly empty) view of the local authority codes and Measures, in
+    order of local authority code, which is valid until the Areas object is
+    next modified
+
+  @example
+    Areas data = Areas();
+    ...
+    for (const auto &entry : data.getMeasureIndex("pop")) {
+      std::cout << entry.area << " " << entry.measure->getAverage() << std::endl;
+    }
+*/
+Areas::IndexRange<Areas::MeasureEntry> Areas::getMeasureIndex(
+    const std::string &measureCode) const {
+  // A codename that has never been interned cannot be one of the measures
+  auto code = Symbol::find(measureCode);
+  if (!code) {
+    return {};
+  }
+
+  const auto &measures = indexes().measures;
+  auto it = measures.find(*code);
+  if (it == measures.end()) {
+    return {};
+  }
+  return {it->second.data(), it->second.data() + it->second.size()};
+}
+
+/*
+  Retrieve every value in a given year, across all areas and measures. The
+  index is built (over all years) on first use.
+
+  @param year
+    The year
+
+  @return
+    A (possibly empty) view of the values with their local authority code
+    and measure codename, in order of measure codename then local authority
+    code, which is valid until the Areas object is next modified
+
+  @example
+    Areas data = Areas();
+    ...
+    std::cout << data.getYearIndex(2015).size() << " values" << std::endl;
+*/
+Areas::IndexRange<Areas::YearEntry> Areas::getYearIndex(int year) const {
+  const auto &years = indexes().years;
+  auto it = years.find(year);
+  if (it == years.end()) {
+    return {};
+  }
+  return {it->second.data(), it->second.data() + it->second.size()};
+}
+
+/*
+  Retrieve every Area's value of a given Measure in a given year (e.g. all
+  areas' rail journeys in 2015), in time proportional to the number of
+  values found.
+
+  @param year
+    The year
+
+  @param measureCode
+    The codename of the Measure
+
+  @return
+    A (possibly empty) view of the values with their local authority code,
+    in order of local authority code, which is valid until the Areas object
+    is next modified
+
+  @example
+    Areas data = Areas();
+    ...
+    for (const auto &entry : data.getYearIndex(2015, "rail")) {
+      std::cout << entry.area << " " << entry.value << std::endl;
+    }
+*/
+Areas::IndexRange<Areas::YearEntry> Areas::getYearIndex(
+    int year,
+    const std::string &measureCode) const {
+  auto code = Symbol::find(measureCode);
+  if (!code) {
+    return {};
+  }
+
+  // The year's values are sorted by measure codename
+  struct ByMeasure {
+    bool operator()(const YearEntry &entry, Symbol measure) const {
+      return entry.measure < measure;
+    }
+    bool operator()(Symbol measure, const YearEntry &entry) const {
+      return measure < entry.measure;
+    }
+  };
+
+  const auto values = getYearIndex(year);
+  auto range = std::equal_range(values.begin(), values.end(), *code, ByMeasure());
+  return {range.first, range.second};
 }
 
 
@@ -170,50 +850,175 @@ void Areas::populateFromAuthorityCodeCSV(
     std::istream &is,
     const BethYw::SourceColumnMapping &cols,
     const StringFilterSet * const areasFilter) {
+  populateFromAuthorityCodeCSV(is, cols, Filter(areasFilter, nullptr, nullptr));
+}
 
-  std::string line;
+/*
+  As above, but parses the areas.csv file from an in-memory buffer of its
+  contents, such as the view returned by InputMappedFile::open().
+
+  @param buffer
+    The contents of the file
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param areasFilter
+    An umodifiable pointer to set of umodifiable strings for areas to import,
+    or an empty set if all areas should be imported
+
+  @example
+    InputMappedFile input("data/areas.csv");
+    Areas data = Areas();
+    data.populateFromAuthorityCodeCSV(input.open(), InputFiles::AREAS.COLS);
+*/
+void Areas::populateFromAuthorityCodeCSV(
+    std::string_view buffer,
+    const BethYw::SourceColumnMapping &cols,
+    const StringFilterSet * const areasFilter) {
+  populateFromAuthorityCodeCSV(buffer, cols,
+                               Filter(areasFilter, nullptr, nullptr));
+}
+
+/*
+  As above, but only imports the areas let through by a compiled Filter
+  (its measures and years are not relevant to areas.csv).
+
+  @param is
+    The input stream from InputSource
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param filter
+    The areas to import
+
+  @example
+    Filter filter(&areasFilter, nullptr, nullptr);
+
+    Areas data = Areas();
+    data.populateFromAuthorityCodeCSV(is, InputFiles::AREAS.COLS, filter);
+*/
+void Areas::populateFromAuthorityCodeCSV(
+    std::istream &is,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  CSVReader reader(is);
+  populateFromAuthorityCodeCSV(reader, cols, filter);
+}
+
+/*
+  As above, but parses the file from an in-memory buffer of its contents.
+
+  @param buffer
+    The contents of the file
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param filter
+    The areas to import
+*/
+void Areas::populateFromAuthorityCodeCSV(
+    std::string_view buffer,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  CSVReader reader(buffer);
+  populateFromAuthorityCodeCSV(reader, cols, filter);
+}
+
+/*
+  Shared implementation of the populateFromAuthorityCodeCSV() functions,
+  reading rows from a CSVReader over either a stream or buffer.
+*/
+void Areas::populateFromAuthorityCodeCSV(
+    CSVReader &reader,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  Profile::Timer timer("populateFromAuthorityCodeCSV");
+  Profile::Rows rows;
+  invalidateIndexes();
 
   // Skip the header line
-  std::getline(is, line);
+  reader.next();
 
-  // Read each line from the input stream
-  while (std::getline(is, line)) {
-    std::istringstream ss(line);
-    std::string token;
+  // Read each row from the input stream
+  while (reader.next()) {
+    rows.read++;
 
-    std::vector<std::string> tokens;
-    while (std::getline(ss, token, ',')) {
-      tokens.push_back(token);
+    // Check if the area should be imported, before splitting the row
+    auto authorityCode = filter.areas().find(reader.firstField());
+    if (!authorityCode) {
+      rows.filtered++;
+      continue;
     }
 
     // Check if there are enough columns in the CSV
-    if (tokens.size() < 3) {
+    if (reader.size() < 3) {
       throw std::out_of_range("Not enough columns in the CSV file.");
     }
 
-    // Extract data from tokens
-    std::string authorityCode = tokens.at(0);
-    std::string authorityNameEng = tokens.at(1);
-    std::string authorityNameCym = tokens.at(2);
-
-    // Check if the area should be imported based on areasFilter
-    if (areasFilter != nullptr && !areasFilter->empty()) {
-      if (areasFilter->find(authorityCode) == areasFilter->end()) {
-        continue;
-      }
+    // Create the Area object in place in the Areas container, unless it is
+    // already there (as insertArea() would)
+    auto emplaced = storage->areas.try_emplace(*authorityCode, *authorityCode);
+    if (emplaced.second) {
+      Area &area = emplaced.first->second;
+      area.setName(LANG_ENG, Symbol(reader.field(1)));
+      area.setName(LANG_CYM, Symbol(reader.field(2)));
     }
-
-    // Create Area object and insert it into the Areas container
-    Area area(authorityCode);
-    area.setName("eng", authorityNameEng);
-    area.setName("cym", authorityNameCym);
-
-    this->insertArea(area);
   }
 }
 
+/*
+  Add an Area to the Areas object, unless it already has one with the same
+  local authority code (unlike setArea(), which replaces it).
+
+  @param area
+    The Area to add
+
+  @example
+    Areas data = Areas();
+    data.insertArea(Area("W06000023"));
+*/
 void Areas::insertArea(const Area& area) {
-    areas.insert({area.getLocalAuthorityCode(), area});
+    invalidateIndexes();
+    storage->areas.try_emplace(area.getLocalAuthoritySymbol(), area);
+}
+
+/*
+  As above, but moves the Area into place rather than copying it.
+
+  @param area
+    The Area to add, which is left in a valid but unspecified state if it is
+    added
+*/
+void Areas::insertArea(Area&& area) {
+    invalidateIndexes();
+    storage->areas.try_emplace(area.getLocalAuthoritySymbol(), std::move(area));
+}
+
+/*
+  Retrieve the Area with a local authority code, creating an empty one in
+  place if there is none yet, in a single lookup.
+
+  @param localAuthorityCode
+    The local authority code of the Area
+
+  @return
+    A reference to the Area in this Areas object
+
+  @example
+    Areas data = Areas();
+    data.emplaceArea(Symbol("W06000023"))
+        .setName(Symbol("eng"), Symbol("Powys"));
+*/
+Area& Areas::emplaceArea(Symbol localAuthorityCode) {
+  invalidateIndexes();
+  return storage->areas.try_emplace(localAuthorityCode, localAuthorityCode)
+      .first->second;
 }
 
 /*
@@ -223,6 +1028,10 @@ void Areas::insertArea(const Area& area) {
   If an Area that does not exist in the Areas container is found, create the
   Area object.
 
+  The stream is parsed as a sequence of SAX events (see WelshStatsJSONHandler)
+  and each element of the "value" array is filtered and imported as soon as it
+  has been read, so the full document is never held in memory.
+
   If areasFilter is a non-empty set, only include areas matching the filter. If
   measuresFilter is a non-empty set, only include measures matching the filter.
   If yearsFilter is not equal to <0,0>, only import years within the range
@@ -278,76 +1087,289 @@ void Areas::populateFromWelshStatsJSON(std::istream &is,
                                        const StringFilterSet * const areasFilter,
                                        const StringFilterSet * const measuresFilter,
                                        const YearFilterTuple * const yearsFilter) {
-  // Parse JSON data from the input stream
-  json j;
-  is >> j;
+  // Like `is >> j`, trailing content after the document is not an error
+  populateFromWelshStatsJSON(
+      [&](WelshStatsJSONHandler &handler) {
+        json::sax_parse(is, &handler, json::input_format_t::json, false);
+      },
+      cols, Filter(areasFilter, measuresFilter, yearsFilter));
+}
+
+/*
+  As above, but parses the JSON from an in-memory buffer of the file's
+  contents, such as the view returned by InputMappedFile::open().
 
-  for (auto& el : j["value"].items()) {
-    auto &data = el.value();
+  @param buffer
+    The contents of the file
 
-    std::map<BethYw::SourceColumn, std::string> mappedData;
-    for (const auto &col : cols) {
-      if (data[col.second].is_null()) {
-        continue;
-      } else if (data[col.second].is_number()) {
-        mappedData[col.first] = std::to_string(data[col.second].get<double>());
-      } else {
-        mappedData[col.first] = data[col.second];
-      }
-    }
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param areasFilter
+    An umodifiable pointer to set of umodifiable strings of areas to import,
+    or an empty set if all areas should be imported
+
+  @param measuresFilter
+    An umodifiable pointer to set of umodifiable strings of measures to import,
+    or an empty set if all measures should be imported
+
+  @param yearsFilter
+    An umodifiable pointer to an umodifiable tuple of two unsigned integers,
+    where if both values are 0, then all years should be imported
+
+  @example
+    InputMappedFile input("data/popu1009.json");
+    Areas data = Areas();
+    data.populateFromWelshStatsJSON(
+      input.open(),
+      InputFiles::POPDEN.COLS,
+      &areasFilter,
+      &measuresFilter,
+      &yearsFilter);
+*/
+void Areas::populateFromWelshStatsJSON(std::string_view buffer,
+                                       const BethYw::SourceColumnMapping &cols,
+                                       const StringFilterSet * const areasFilter,
+                                       const StringFilterSet * const measuresFilter,
+                                       const YearFilterTuple * const yearsFilter) {
+  populateFromWelshStatsJSON(
+      [&](WelshStatsJSONHandler &handler) {
+        json::sax_parse(buffer.data(), buffer.data() + buffer.size(), &handler,
+                        json::input_format_t::json, false);
+      },
+      cols, Filter(areasFilter, measuresFilter, yearsFilter));
+}
+
+/*
+  As above, but filters the rows with a compiled Filter.
+
+  @param is
+    The input stream from InputSource
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param filter
+    The areas, measures and years to import
+
+  @example
+    Filter filter(&areasFilter, &measuresFilter, &yearsFilter);
+
+    Areas data = Areas();
+    data.populateFromWelshStatsJSON(is, InputFiles::POPDEN.COLS, filter);
+*/
+void Areas::populateFromWelshStatsJSON(std::istream &is,
+                                       const BethYw::SourceColumnMapping &cols,
+                                       const Filter &filter) {
+  populateFromWelshStatsJSON(
+      [&](WelshStatsJSONHandler &handler) {
+        json::sax_parse(is, &handler, json::input_format_t::json, false);
+      },
+      cols, filter);
+}
+
+/*
+  As above, but parses the JSON from an in-memory buffer of the file's
+  contents.
+
+  @param buffer
+    The contents of the file
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param filter
+    The areas, measures and years to import
+*/
+void Areas::populateFromWelshStatsJSON(std::string_view buffer,
+                                       const BethYw::SourceColumnMapping &cols,
+                                       const Filter &filter) {
+  populateFromWelshStatsJSON(
+      [&](WelshStatsJSONHandler &handler) {
+        json::sax_parse(buffer.data(), buffer.data() + buffer.size(), &handler,
+                        json::input_format_t::json, false);
+      },
+      cols, filter);
+}
+
+/*
+  Shared implementation of the populateFromWelshStatsJSON() functions. The
+  `parse` function is given the handler and runs the SAX parser over either
+  a stream or buffer.
+
+  The layout of the rows is worked out once, from the column mapping, and
+  the rows are then imported by the instantiation of populateWelshStatsRows()
+  for that layout, so the per-row code has no branches for the layouts it
+  is not importing.
+*/
+void Areas::populateFromWelshStatsJSON(
+    const std::function<void(WelshStatsJSONHandler&)> &parse,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  Profile::Timer timer("populateFromWelshStatsJSON");
+  invalidateIndexes();
+
+  if (cols.count(BethYw::MEASURE_CODE)) {
+    populateWelshStatsRows<JSONLayout::MEASURE_COLUMN>(parse, cols, filter);
+  } else {
+    populateWelshStatsRows<JSONLayout::SINGLE_MEASURE>(parse, cols, filter);
+  }
+}
+
+/*
+  Import the rows of a WelshStatsJSON file with a given layout. A row
+  without a measure is imported as the file's single measure, which is the
+  one named by the column mapping, or (as for any file of rows with their
+  own measures) that of InputFiles::TRAINS.
+
+  @tparam Layout
+    The layout of the file's rows
 
-    bool isSingleMeasure = true;
-    for (const auto& element : mappedData) {
-      if (element.first == 3) {
-        isSingleMeasure = false;
-        break;
+  @param parse
+    Runs the SAX parser with the given handler
+
+  @param cols
+    The column mapping of the dataset
+
+  @param filter
+    The areas, measures and years to import
+*/
+template <Areas::JSONLayout Layout>
+void Areas::populateWelshStatsRows(
+    const std::function<void(WelshStatsJSONHandler&)> &parse,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  Profile::Rows rows;
+
+  // The single measure of rows without a measure
+  const auto &singleCols =
+      cols.count(BethYw::SINGLE_MEASURE_CODE) && cols.count(BethYw::SINGLE_MEASURE_NAME)
+          ? cols
+          : BethYw::InputFiles::TRAINS.COLS;
+  std::string singleCode = singleCols.at(BethYw::SINGLE_MEASURE_CODE);
+  std::string singleLabel = singleCols.at(BethYw::SINGLE_MEASURE_NAME);
+  std::transform(singleCode.begin(), singleCode.end(), singleCode.begin(), [](unsigned char c) { return std::tolower(c); });
+  std::transform(singleLabel.begin(), singleLabel.end(), singleLabel.begin(), [](unsigned char c) { return std::tolower(c); });
+  const Symbol singleCodeSymbol(singleCode);
+  const Symbol singleLabelSymbol(singleLabel);
+  const bool singleInFilter = filter.measures().contains(singleCodeSymbol);
+
+  const Filter::Set noFilter;
+  RowSymbol areaSymbol(filter.areas(), false);
+  RowSymbol measureSymbol(filter.measures(), true);
+  RowSymbol labelSymbol(noFilter, true);
+  std::string scratch;
+
+  using Field = WelshStatsJSONHandler::Field;
+
+  // Process each element of the "value" array as soon as it has been read,
+  // rather than parsing the whole document into memory first. Every check
+  // is made on the row's fields in place, and a value is only added to its
+  // Area and Measure once it has passed all of the filters.
+  WelshStatsJSONHandler handler(cols, [&](const WelshStatsJSONHandler &row) {
+    rows.read++;
+    if (row.hasBoolean()) {
+      for (const auto &col : cols) {
+        if (row.field(col.first).type == Field::BOOLEAN) {
+          throw std::runtime_error("Areas::populateFromWelshStatsJSON: " +
+                                   col.second + " is a boolean, not a string "
+                                   "or number");
+        }
       }
     }
 
-    std::string localAuthorityCode = mappedData[BethYw::AUTH_CODE];
-    std::string localAuthorityNameEng = mappedData[BethYw::AUTH_NAME_ENG];
-
     // Skip areas NOT in filter
-    if (!areasFilter->empty() && areasFilter->find(localAuthorityCode) == areasFilter->end()) {
-      continue;
+    if (!areaSymbol.resolve(fieldText(row.field(BethYw::AUTH_CODE), scratch))) {
+      rows.filtered++;
+      return;
     }
-
-    std::string measureCode;
-    std::string measureLabel;
-
-    if (isSingleMeasure) {
-      measureCode = BethYw::InputFiles::TRAINS.COLS.at(BethYw::SINGLE_MEASURE_CODE);
-      measureLabel = BethYw::InputFiles::TRAINS.COLS.at(BethYw::SINGLE_MEASURE_NAME);
+    const Symbol localAuthorityCode = areaSymbol.symbol;
+
+    // Skip measures NOT in filter. Without a measure column, no row has a
+    // measure of its own.
+    Symbol measureCode = singleCodeSymbol;
+    Symbol measureLabel = singleLabelSymbol;
+    if (Layout == JSONLayout::SINGLE_MEASURE ||
+        row.field(BethYw::MEASURE_CODE).type == Field::ABSENT) {
+      if (!singleInFilter) {
+        rows.filtered++;
+        return;
+      }
     } else {
-      measureCode = mappedData[BethYw::MEASURE_CODE];
-      measureLabel = mappedData[BethYw::MEASURE_NAME];
+      if (!measureSymbol.resolve(fieldText(row.field(BethYw::MEASURE_CODE), scratch))) {
+        rows.filtered++;
+        return;
+      }
+      labelSymbol.resolve(fieldText(row.field(BethYw::MEASURE_NAME), scratch));
+      measureCode = measureSymbol.symbol;
+      measureLabel = labelSymbol.symbol;
     }
 
-    std::transform(measureCode.begin(), measureCode.end(), measureCode.begin(), [](unsigned char c) { return std::tolower(c); });
-    std::transform(measureLabel.begin(), measureLabel.end(), measureLabel.begin(), [](unsigned char c) { return std::tolower(c); });
-
-    // Skip measures NOT in filter
-    if (!measuresFilter->empty() && measuresFilter->find(measureCode) == measuresFilter->end()) {
-      continue;
+    // Read the year as std::stoi() would have read it as a string
+    const Field &yearField = row.field(BethYw::YEAR);
+    unsigned int year;
+    if (yearField.type == Field::NUMBER) {
+      if (!(yearField.number > INT_MIN - 1.0 && yearField.number < INT_MAX + 1.0)) {
+        throw std::out_of_range(
+            "Areas::populateFromWelshStatsJSON: year is out of range");
+      }
+      year = static_cast<int>(yearField.number);
+    } else if (yearField.type == Field::STRING) {
+      try {
+        year = std::stoi(yearField.text);
+      } catch (const std::invalid_argument &) {
+        throw std::invalid_argument(
+            "Areas::populateFromWelshStatsJSON: year is not a number: " +
+            yearField.text);
+      } catch (const std::out_of_range &) {
+        throw std::out_of_range(
+            "Areas::populateFromWelshStatsJSON: year is out of range: " +
+            yearField.text);
+      }
+    } else {
+      throw std::invalid_argument(
+          "Areas::populateFromWelshStatsJSON: year is not a string or number");
     }
 
-    std::string yearString = mappedData[BethYw::YEAR];
-    unsigned int year = std::stoi(yearString);
-
     // Skip years NOT in filter
-    if ((std::get<0>(*yearsFilter) == 0 && std::get<1>(*yearsFilter) == 0) ||
-          (year >= std::get<0>(*yearsFilter) && year <= std::get<1>(*yearsFilter))) {
-      std::string valueString = mappedData[BethYw::VALUE];
-      Measure measure = Measure(measureCode, measureLabel);
-      measure.setValue(year, std::stod(valueString));
+    if (filter.matchesYear(year)) {
+      const Field &valueField = row.field(BethYw::VALUE);
+      double value;
+      if (valueField.type == Field::NUMBER) {
+        value = valueField.number;
+      } else if (valueField.type == Field::STRING) {
+        try {
+          value = std::stod(valueField.text);
+        } catch (const std::invalid_argument &) {
+          throw std::invalid_argument(
+              "Areas::populateFromWelshStatsJSON: value is not a number: " +
+              valueField.text);
+        } catch (const std::out_of_range &) {
+          throw std::out_of_range(
+              "Areas::populateFromWelshStatsJSON: value is out of range: " +
+              valueField.text);
+        }
+      } else {
+        throw std::invalid_argument(
+            "Areas::populateFromWelshStatsJSON: value is not a string or number");
+      }
 
-      Area area(localAuthorityCode);
-      area.setName("eng", localAuthorityNameEng);
-      insertArea(area);
+      auto emplaced = storage->areas.try_emplace(localAuthorityCode, localAuthorityCode);
+      Area &area = emplaced.first->second;
+      if (emplaced.second) {
+        area.setName(LANG_ENG, Symbol(fieldText(row.field(BethYw::AUTH_NAME_ENG), scratch)));
+      }
 
-      areas[localAuthorityCode].setMeasure(measureCode, measure);
+      area.emplaceMeasure(measureCode, measureLabel).setValue(year, value);
+    } else {
+      rows.filtered++;
     }
-  }
+  });
+
+  parse(handler);
 }
 
 
@@ -405,84 +1427,493 @@ void Areas::populateFromAuthorityByYearCSV(
     const StringFilterSet * const areasFilter,
     const StringFilterSet * const measuresFilter,
     const YearFilterTuple * const yearsFilter) {
+  populateFromAuthorityByYearCSV(is, cols,
+                                 Filter(areasFilter, measuresFilter, yearsFilter));
+}
 
-  std::string line;
+/*
+  As above, but parses the CSV from an in-memory buffer of the file's
+  contents, such as the view returned by InputMappedFile::open(). If more
+  than one thread has been allowed with setThreads(), large files are parsed
+  in chunks on several threads.
 
-  // Skip the header line
-  std::getline(is, line);
+  @param buffer
+    The contents of the file
 
-  std::istringstream header_ss(line);
-  std::vector<unsigned int> years;
-  std::string year_token;
-  std::getline(header_ss, year_token, ','); // Skip first col a.k.a authority code
-  while (std::getline(header_ss, year_token, ',')) {
-      years.push_back(std::stoi(year_token));
-  }
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
 
-  const auto& firstElement = *cols.begin();
+  @param areasFilter
+    An umodifiable pointer to set of umodifiable strings for areas to import,
+    or an empty set if all areas should be imported
 
-  std::string measureCode;
-  std::string measureLabel;
+  @param measuresFilter
+    An umodifiable pointer to set of strings for measures to import, or an empty 
+    set if all measures should be imported
 
-  for (const auto& dataset : BethYw::InputFiles::DATASETS) {
-    if (dataset.PARSER == BethYw::SourceDataType::AuthorityByYearCSV &&
-        dataset.COLS.at(BethYw::SINGLE_MEASURE_NAME) == firstElement.second) {
-      measureCode = dataset.COLS.at(BethYw::SINGLE_MEASURE_CODE);
-      measureLabel = dataset.COLS.at(BethYw::SINGLE_MEASURE_NAME);
-      break;
-    }
-  }
+  @param yearsFilter
+    An umodifiable pointer to an umodifiable tuple of two unsigned integers,
+    where if both values are 0, then all years should be imported
 
-  // Read each line from the input stream
-  while (std::getline(is, line)) {
-    std::istringstream ss(line);
-    std::string token;
+  @example
+    InputMappedFile input("data/complete-popu1009-pop.csv");
+    Areas data = Areas();
+    data.populateFromAuthorityByYearCSV(
+      input.open(),
+      InputFiles::COMPLETE_POP.COLS,
+      &areasFilter,
+      &measuresFilter,
+      &yearsFilter);
+*/
+void Areas::populateFromAuthorityByYearCSV(
+    std::string_view buffer,
+    const BethYw::SourceColumnMapping &cols,
+    const StringFilterSet * const areasFilter,
+    const StringFilterSet * const measuresFilter,
+    const YearFilterTuple * const yearsFilter) {
+  populateFromAuthorityByYearCSV(buffer, cols,
+                                 Filter(areasFilter, measuresFilter, yearsFilter));
+}
 
-    std::vector<std::string> tokens;
-    while (std::getline(ss, token, ',')) {
-      tokens.push_back(token);
-    }
+/*
+  As above, but filters the rows with a compiled Filter.
+
+  @param is
+    The input stream from InputSource
 
-    // Extract data from tokens
-    std::string localAuthorityCode = tokens.at(0);
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
 
-    // Check if the area should be imported based on areasFilter
-    if (areasFilter != nullptr && !areasFilter->empty()) {
-      if (areasFilter->find(localAuthorityCode) == areasFilter->end()) {
-        continue;
-      }
-    }
+  @param filter
+    The areas, measures and years to import
 
-    // Create the Measure object
-    Measure measure(measureCode, measureLabel);
+  @example
+    Filter filter(&areasFilter, &measuresFilter, &yearsFilter);
 
-    // Iterate through the rest of the tokens (year-value pairs)
-    for (size_t i = 1, year_idx = 0; i < tokens.size(); i += 1, year_idx += 1) {
-      unsigned int year = years.at(year_idx);
-      double value = std::stod(tokens.at(i));
+    Areas data = Areas();
+    data.populateFromAuthorityByYearCSV(is, InputFiles::COMPLETE_POP.COLS,
+                                        filter);
+*/
+void Areas::populateFromAuthorityByYearCSV(
+    std::istream &is,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  CSVReader reader(is);
+  populateFromAuthorityByYearCSV(reader, cols, filter);
+}
 
-      // Check if the year should be imported based on yearsFilter
-      if (yearsFilter != nullptr &&
-          std::get<0>(*yearsFilter) != 0 &&
-          std::get<1>(*yearsFilter) != 0) {
-        if (year < std::get<0>(*yearsFilter) || year > std::get<1>(*yearsFilter)) {
-          continue;
-        }
-      }
+/*
+  As above, but parses the CSV from an in-memory buffer of the file's
+  contents, on several threads if the file is large enough (see
+  setThreads()).
 
-      // Add the year-value pair to the Measure object
-      measure.setValue(year, value);
-    }
+  @param buffer
+    The contents of the file
 
-    // Insert the Measure object into the corresponding Area object
-    this->areas.at(localAuthorityCode).setMeasure(measureCode, measure);
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param filter
+    The areas, measures and years to import
+*/
+void Areas::populateFromAuthorityByYearCSV(
+    std::string_view buffer,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  CSVReader reader(buffer);
+
+  // Large files are split up between threads
+  if (threads > 1 && buffer.size() >= 2 * MIN_CHUNK_SIZE) {
+    populateFromAuthorityByYearCSVChunks(reader, buffer, cols, filter);
+    return;
   }
+
+  populateFromAuthorityByYearCSV(reader, cols, filter);
 }
 
+/*
+  Read the header line of an AuthorityByYearCSV file, giving the year of each
+  column, and work out which measure the file contains from `cols`.
 
+  @param reader
+    A CSVReader positioned at the start of the file
 
+  @param cols
+    The column mapping of the dataset
 
-/*
+  @param years
+    Set to the year of each column after the authority code
+
+  @param measureCode
+    Set to the codename of the measure in the file
+
+  @param measureLabel
+    Set to the label of the measure in the file
+*/
+static void readAuthorityByYearHeader(CSVReader &reader,
+                                      const BethYw::SourceColumnMapping &cols,
+                                      std::vector<unsigned int> &years,
+                                      Symbol &measureCode,
+                                      Symbol &measureLabel) {
+  // Read the years from the header line
+  if (reader.next()) {
+    const auto &header = reader.fields();
+    // Skip first col a.k.a authority code
+    for (size_t i = 1; i < header.size(); i++) {
+      years.push_back(CSVReader::toInt(header[i]));
+    }
+  }
+
+  // The measure is named by the column mapping of every AuthorityByYearCSV
+  // dataset in datasets.h
+  auto code = cols.find(BethYw::SINGLE_MEASURE_CODE);
+  auto label = cols.find(BethYw::SINGLE_MEASURE_NAME);
+  if (code != cols.end() && label != cols.end()) {
+    std::string lowered = code->second;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+    measureCode = Symbol(lowered);
+    measureLabel = Symbol(label->second);
+    return;
+  }
+
+  // Otherwise, look for a dataset the mapping could be for
+  const auto& firstElement = *cols.begin();
+
+  for (const auto& dataset : BethYw::InputFiles::DATASETS) {
+    if (dataset.PARSER == BethYw::SourceDataType::AuthorityByYearCSV &&
+        dataset.COLS.at(BethYw::SINGLE_MEASURE_NAME) == firstElement.second) {
+      std::string code = dataset.COLS.at(BethYw::SINGLE_MEASURE_CODE);
+      std::transform(code.begin(), code.end(), code.begin(), ::tolower);
+      measureCode = Symbol(code);
+      measureLabel = Symbol(dataset.COLS.at(BethYw::SINGLE_MEASURE_NAME));
+      break;
+    }
+  }
+}
+
+/*
+  A column of an AuthorityByYearCSV file with a year that is to be imported.
+*/
+struct YearColumn {
+  std::size_t field;
+  unsigned int year;
+};
+
+/*
+  Work out, from the years in the header of an AuthorityByYearCSV file,
+  which of its columns hold years the filter lets through, so that each row
+  only has to look at (and convert) those columns.
+
+  @param years
+    The year of each column after the authority code
+
+  @param filter
+    The years to import
+
+  @return
+    The columns to import, in the order they appear in the file
+*/
+static std::vector<YearColumn> projectYearColumns(
+    const std::vector<unsigned int> &years,
+    const Filter &filter) {
+  std::vector<YearColumn> columns;
+  for (std::size_t i = 0; i < years.size(); i++) {
+    if (filter.matchesYear(years[i])) {
+      columns.push_back({i + 1, years[i]});
+    }
+  }
+  return columns;
+}
+
+/*
+  Parse the current row of an AuthorityByYearCSV file into a Measure, or
+  anything else with a setValue(year, value) member (see ChunkValues). The
+  area is checked against the filter before the row is split into fields,
+  so rows for other areas are skipped having only looked at their first
+  field, and the row is only split as far as the last projected column.
+  Values in other columns are neither split out nor converted.
+
+  @param reader
+    A CSVReader positioned at the row
+
+  @param numYears
+    The number of years in the header
+
+  @param columns
+    The columns to import, from projectYearColumns()
+
+  @param filter
+    The areas to import
+
+  @param localAuthorityCode
+    Set to the authority code of the row
+
+  @param measure
+    The Measure (or ChunkValues) to add the row's values to
+
+  @return
+    false if the row's area should not be imported, true otherwise
+
+  @throws
+    std::out_of_range if the row has more values than there are years, or
+    std::runtime_error if an imported value is not a number
+*/
+template <typename Values>
+static bool readAuthorityByYearRow(const CSVReader &reader,
+                                   std::size_t numYears,
+                                   const std::vector<YearColumn> &columns,
+                                   const Filter &filter,
+                                   Symbol &localAuthorityCode,
+                                   Values &measure) {
+  // Check if the area should be imported based on the filter
+  auto code = filter.areas().find(reader.firstField());
+  if (!code) {
+    return false;
+  }
+  localAuthorityCode = *code;
+
+  const std::size_t numFields = reader.size();
+  if (numFields > numYears + 1) {
+    throw std::out_of_range("More values than years in the CSV file.");
+  }
+
+  // Only read the year-value pairs of the projected columns
+  for (const auto &column : columns) {
+    if (column.field >= numFields) {
+      break;
+    }
+
+    // An empty cell means there is no value for that year
+    std::string_view text = reader.field(column.field);
+    if (text.empty()) {
+      continue;
+    }
+
+    // Add the year-value pair to the Measure object
+    measure.setValue(column.year, CSVReader::toDouble(text));
+  }
+
+  return true;
+}
+
+/*
+  Shared implementation of the populateFromAuthorityByYearCSV() functions,
+  reading rows from a CSVReader over either a stream or buffer.
+*/
+void Areas::populateFromAuthorityByYearCSV(
+    CSVReader &reader,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  Profile::Timer timer("populateFromAuthorityByYearCSV");
+  Profile::Rows rows;
+  invalidateIndexes();
+
+  std::vector<unsigned int> years;
+  Symbol measureCode;
+  Symbol measureLabel;
+  readAuthorityByYearHeader(reader, cols, years, measureCode, measureLabel);
+
+  // The file only has one measure, so there is nothing to import if the
+  // filter leaves it out
+  if (!filter.measures().contains(measureCode)) {
+    return;
+  }
+  const auto columns = projectYearColumns(years, filter);
+
+  // Read each row from the input stream
+  Symbol localAuthorityCode;
+  while (reader.next()) {
+    rows.read++;
+
+    // Create the Measure object in this Areas object's arena, so that it is
+    // moved into its Area without copying its values
+    Measure measure(measureCode, measureLabel, storage->areas.get_allocator());
+    if (!readAuthorityByYearRow(reader, years.size(), columns, filter,
+                                localAuthorityCode, measure)) {
+      rows.filtered++;
+      continue;
+    }
+
+    // Insert the Measure object into the corresponding Area object
+    storage->areas.at(localAuthorityCode).setMeasure(measureCode, std::move(measure));
+  }
+}
+
+/*
+  Find the end of the line that a position of a CSV buffer is in. As in
+  CSVReader::nextLine(), every '"' starts or ends a quoted field, and a line
+  break inside a quoted field does not end the line.
+
+  @param text
+    The CSV buffer
+
+  @param from
+    The position to start looking from
+
+  @param quoted
+    Whether `from` is inside a quoted field
+
+  @return
+    The position just past the '\n' that ends the line, or the size of
+    `text` if the line is the last one
+*/
+static std::size_t findLineEnd(std::string_view text, std::size_t from, bool quoted) {
+  while (from < text.size()) {
+    const std::size_t found = text.find_first_of(quoted ? "\"" : "\"\n", from);
+    if (found == std::string_view::npos) {
+      break;
+    }
+    if (text[found] == '\n') {
+      return found + 1;
+    }
+    quoted = !quoted;
+    from = found + 1;
+  }
+  return text.size();
+}
+
+/*
+  The rows of one chunk of an AuthorityByYearCSV file parsed by a worker of
+  populateFromAuthorityByYearCSVChunks(): the year-value pairs of all of its
+  rows in one buffer, and for each imported row its area and the range of
+  its pairs. The Measures are only built from these when they are merged,
+  in the Areas object's arena, so their values are not allocated twice.
+*/
+struct ChunkValues {
+  struct Row {
+    Symbol area;
+    std::size_t first;
+    std::size_t count;
+  };
+
+  std::vector<Row> rows;
+  std::vector<std::pair<int, double>> values;
+
+  void setValue(int year, double value) {
+    values.emplace_back(year, value);
+  }
+};
+
+/*
+  Parse the rows of an AuthorityByYearCSV buffer on several threads. The
+  rows after the header are split into chunks that each end at a line break
+  outside of any quoted field (so a quoted field may span lines, as in a
+  sequential parse), and each chunk is parsed into a ChunkValues by a
+  worker. The Measures are then built and added to their Area objects in
+  file order, so the result (including the point at which an error stops
+  the import) is the same as a sequential parse.
+
+  @param reader
+    A CSVReader over `buffer`, positioned at the start of the file
+
+  @param buffer
+    The contents of the file
+
+  @param cols
+    The column mapping of the dataset
+
+  @param filter
+    The areas, measures and years to import
+*/
+void Areas::populateFromAuthorityByYearCSVChunks(
+    CSVReader &reader,
+    std::string_view buffer,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  Profile::Timer timer("populateFromAuthorityByYearCSVChunks");
+  invalidateIndexes();
+
+  std::vector<unsigned int> years;
+  Symbol measureCode;
+  Symbol measureLabel;
+  readAuthorityByYearHeader(reader, cols, years, measureCode, measureLabel);
+
+  if (!filter.measures().contains(measureCode)) {
+    return;
+  }
+  const auto columns = projectYearColumns(years, filter);
+
+  std::string_view body = buffer.substr(std::min(reader.offset(), buffer.size()));
+
+  // Several chunks per thread keeps the workers balanced
+  std::size_t numChunks = std::min<std::size_t>(
+      threads * 4, std::max<std::size_t>(1, body.size() / MIN_CHUNK_SIZE));
+
+  std::vector<std::string_view> chunks;
+  std::size_t start = 0;
+  for (std::size_t i = 1; i <= numChunks && start < body.size(); i++) {
+    std::size_t end = body.size() * i / numChunks;
+    if (end < start) {
+      end = start;
+    }
+    if (i < numChunks) {
+      // Each chunk starts a line, outside of any quoted field, so an odd
+      // number of quotes since its start means `end` is inside one
+      const bool quoted = std::count(body.begin() + start, body.begin() + end, '"') % 2;
+      end = findLineEnd(body, end, quoted);
+    } else {
+      end = body.size();
+    }
+    chunks.push_back(body.substr(start, end - start));
+    start = end;
+  }
+
+  struct ChunkResult {
+    ChunkValues parsed;
+    std::uint64_t read = 0;
+    std::exception_ptr error;
+  };
+  std::vector<ChunkResult> results(chunks.size());
+
+  BethYw::parallelFor(chunks.size(), threads, [&](std::size_t i) {
+    CSVReader chunkReader(chunks[i]);
+    ChunkValues &parsed = results[i].parsed;
+    Symbol localAuthorityCode;
+    try {
+      while (chunkReader.next()) {
+        results[i].read++;
+        const std::size_t first = parsed.values.size();
+        if (readAuthorityByYearRow(chunkReader, years.size(), columns, filter,
+                                   localAuthorityCode, parsed)) {
+          parsed.rows.push_back(
+              {localAuthorityCode, first, parsed.values.size() - first});
+        }
+      }
+    } catch (...) {
+      // Stop at the first bad row, as the sequential parse would
+      results[i].error = std::current_exception();
+    }
+  });
+
+  // The workers count their own rows, as they are not working on a dataset
+  // as far as Profile is concerned
+  Profile::Rows rows;
+  for (auto &result : results) {
+    const ChunkValues &parsed = result.parsed;
+    rows.read += result.read;
+    rows.filtered += result.read - parsed.rows.size();
+    for (const auto &row : parsed.rows) {
+      // As in the sequential parse, the Measure is created in this Areas
+      // object's arena, so it is moved into its Area without copying
+      Measure measure(measureCode, measureLabel, storage->areas.get_allocator());
+      for (std::size_t v = row.first; v < row.first + row.count; v++) {
+        measure.setValue(parsed.values[v].first, parsed.values[v].second);
+      }
+      storage->areas.at(row.area).setMeasure(measureCode, std::move(measure));
+    }
+    if (result.error) {
+      std::rethrow_exception(result.error);
+    }
+  }
+}
+
+
+
+
+/*
   Parse data from an standard input stream `is`, that has data of a particular
   `type`, and with a given column mapping in `cols`. By looking at the `type`,
   hand off to one of the three functions populate………() functions.
@@ -524,26 +1955,44 @@ void Areas::populateFromAuthorityByYearCSV(
 void Areas::populate(std::istream &is,
                      const BethYw::SourceDataType &type,
                      const BethYw::SourceColumnMapping &cols) {
-  if (!is) {
-    throw std::runtime_error("Input stream is not open or not in a valid state");
-  }
+  populate(is, type, cols, Filter());
+}
 
-  if (is.peek() == std::istream::traits_type::eof()) {
-    throw std::runtime_error("Input stream is empty");
-  }
 
-  const StringFilterSet emptyFilter;
-  const YearFilterTuple emptyYearFilter;
 
-  if (type == BethYw::AuthorityCodeCSV) {
-    populateFromAuthorityCodeCSV(is, cols, &emptyFilter);
-  } else if (type == BethYw::WelshStatsJSON) {
-    populateFromWelshStatsJSON(is, cols, &emptyFilter, &emptyFilter, &emptyYearFilter);
-  } else if (type == BethYw::AuthorityByYearCSV) {
-    populateFromAuthorityByYearCSV(is, cols, &emptyFilter, &emptyFilter, &emptyYearFilter);
-  } else {
-    throw std::runtime_error("Areas::populate: Unexpected data type");
-  }
+/*
+  As above, but parses an in-memory buffer of a file's contents, such as the
+  view returned by InputMappedFile::open(), instead of a stream.
+
+  @param buffer
+    The contents of the file
+
+  @param type
+    A value from the BethYw::SourceDataType enum which states the underlying
+    data file structure
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @throws 
+    std::runtime_error if a parsing error occurs (e.g. due to a malformed file),
+    the buffer is empty, or an unexpected type is passed in.
+    std::out_of_range if there are not enough columns in cols
+
+  @example
+    InputMappedFile input("data/popu1009.json");
+
+    Areas data = Areas();
+    areas.populate(
+      input.open(),
+      DataType::WelshStatsJSON,
+      InputFiles::POPDEN.COLS);
+*/
+void Areas::populate(std::string_view buffer,
+                     const BethYw::SourceDataType &type,
+                     const BethYw::SourceColumnMapping &cols) {
+  populate(buffer, type, cols, Filter());
 }
 
 
@@ -618,6 +2067,100 @@ void Areas::populate(
     const StringFilterSet * const areasFilter,
     const StringFilterSet * const measuresFilter,
     const YearFilterTuple * const yearsFilter) {
+  populate(is, type, cols, Filter(areasFilter, measuresFilter, yearsFilter));
+}
+
+/*
+  As above, but parses an in-memory buffer of a file's contents, such as the
+  view returned by InputMappedFile::open(), instead of a stream, filtering
+  for specific areas, measures, and years.
+
+  @param buffer
+    The contents of the file
+
+  @param type
+    A value from the BethYw::SourceDataType enum which states the underlying
+    data file structure
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param areasFilter
+    An umodifiable pointer to set of umodifiable strings for areas to import,
+    or an empty set if all areas should be imported
+
+  @param measuresFilter
+    An umodifiable pointer to set of umodifiable strings for measures to import,
+    or an empty set if all measures should be imported
+
+  @param yearsFilter
+    An umodifiable pointer to an umodifiable tuple of two unsigned integers,
+    where if both values are 0, then all years should be imported
+
+  @throws 
+    std::runtime_error if a parsing error occurs (e.g. due to a malformed file),
+    the buffer is empty, or an unexpected type is passed in.
+    std::out_of_range if there are not enough columns in cols
+
+  @example
+    InputMappedFile input("data/popu1009.json");
+
+    Areas data = Areas();
+    areas.populate(
+      input.open(),
+      DataType::WelshStatsJSON,
+      InputFiles::POPDEN.COLS,
+      &areasFilter,
+      &measuresFilter,
+      &yearsFilter);
+*/
+void Areas::populate(
+    std::string_view buffer,
+    const BethYw::SourceDataType &type,
+    const BethYw::SourceColumnMapping &cols,
+    const StringFilterSet * const areasFilter,
+    const StringFilterSet * const measuresFilter,
+    const YearFilterTuple * const yearsFilter) {
+  populate(buffer, type, cols, Filter(areasFilter, measuresFilter, yearsFilter));
+}
+
+/*
+  As above, but with the areas, measures and years to import compiled into
+  a Filter, e.g. once for every dataset imported by BethYw::run().
+
+  @param is
+    The input stream from InputSource
+
+  @param type
+    A value from the BethYw::SourceDataType enum which states the underlying
+    data file structure
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param filter
+    The areas, measures and years to import
+
+  @throws 
+    std::runtime_error if a parsing error occurs (e.g. due to a malformed file),
+    the stream is not open/valid/has any contents, or an unexpected type
+    is passed in.
+    std::out_of_range if there are not enough columns in cols
+
+  @example
+    Filter filter(&areasFilter, &measuresFilter, &yearsFilter);
+
+    Areas data = Areas();
+    data.populate(is, DataType::WelshStatsJSON, InputFiles::POPDEN.COLS,
+                  filter);
+*/
+void Areas::populate(
+    std::istream &is,
+    const BethYw::SourceDataType &type,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
   if (!is) {
     throw std::runtime_error("Input stream is not open or not in a valid state");
   }
@@ -627,138 +2170,455 @@ void Areas::populate(
   }
 
   if (type == BethYw::AuthorityCodeCSV) {
-    populateFromAuthorityCodeCSV(is, cols, areasFilter);
+    populateFromAuthorityCodeCSV(is, cols, filter);
+  } else if (type == BethYw::WelshStatsJSON) {
+    populateFromWelshStatsJSON(is, cols, filter);
+  } else if (type == BethYw::AuthorityByYearCSV) {
+    populateFromAuthorityByYearCSV(is, cols, filter);
+  } else {
+    throw std::runtime_error("Areas::populate: Unexpected data type");
+  }
+}
+
+/*
+  As above, but parses an in-memory buffer of a file's contents.
+
+  @param buffer
+    The contents of the file
+
+  @param type
+    A value from the BethYw::SourceDataType enum which states the underlying
+    data file structure
+
+  @param cols
+    A map of the enum BethyYw::SourceColumnMapping (see datasets.h) to strings
+    that give the column header in the CSV file
+
+  @param filter
+    The areas, measures and years to import
+
+  @throws 
+    std::runtime_error if a parsing error occurs (e.g. due to a malformed file),
+    the buffer is empty, or an unexpected type is passed in.
+    std::out_of_range if there are not enough columns in cols
+*/
+void Areas::populate(
+    std::string_view buffer,
+    const BethYw::SourceDataType &type,
+    const BethYw::SourceColumnMapping &cols,
+    const Filter &filter) {
+  if (buffer.empty()) {
+    throw std::runtime_error("Input buffer is empty");
+  }
+
+  if (type == BethYw::AuthorityCodeCSV) {
+    populateFromAuthorityCodeCSV(buffer, cols, filter);
   } else if (type == BethYw::WelshStatsJSON) {
-    populateFromWelshStatsJSON(is, cols, areasFilter, measuresFilter, yearsFilter);
+    populateFromWelshStatsJSON(buffer, cols, filter);
   } else if (type == BethYw::AuthorityByYearCSV) {
-    populateFromAuthorityByYearCSV(is, cols, areasFilter, measuresFilter, yearsFilter);
+    populateFromAuthorityByYearCSV(buffer, cols, filter);
   } else {
     throw std::runtime_error("Areas::populate: Unexpected data type");
   }
 }
 
+/*
+  Write the years and values of a Measure with at least one value as a JSON
+  object, with its keys in alphabetical order as nlohmann::json orders them.
+  When every year is non-negative and has the same number of digits, which
+  is the case for any real dataset, numeric order is alphabetical and the
+  years are written as they are stored. Otherwise the year keys are sorted
+  as strings first, so that e.g. 999 comes after 2005.
+*/
+static void writeJSONYears(OutputBuffer &out, const Measure &measure) {
+  const std::string first = std::to_string(measure.getFirstYear());
+  const std::string last = std::to_string(measure.getLastYear());
+  const bool numericIsAlphabetical = measure.getFirstYear() >= 0
+                                     && first.size() == last.size();
+
+  out.write('{');
+  if (numericIsAlphabetical) {
+    bool firstYear = true;
+    for (const auto &yearPair : measure.getYears()) {
+      if (!firstYear) {
+        out.write(',');
+      }
+      firstYear = false;
+
+      out.write('"');
+      out.writeInteger(yearPair.first);
+      out.write("\":");
+      out.writeJSONNumber(yearPair.second);
+    }
+  } else {
+    std::vector<std::pair<std::string, double>> keys;
+    keys.reserve(measure.size());
+    for (const auto &yearPair : measure.getYears()) {
+      keys.emplace_back(std::to_string(yearPair.first), yearPair.second);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    bool firstYear = true;
+    for (const auto &keyPair : keys) {
+      if (!firstYear) {
+        out.write(',');
+      }
+      firstYear = false;
+
+      out.writeJSONString(keyPair.first);
+      out.write(':');
+      out.writeJSONNumber(keyPair.second);
+    }
+  }
+  out.write('}');
+}
+
+/*
+  Write an Areas object, and all its containing Area instances, and the
+  Measure instances within those, to an output stream as JSON, a piece at
+  a time through an OutputBuffer rather than by building the document in
+  memory first.
+
+  The output is the same as nlohmann::json::dump() of the equivalent
+  document: keys are in alphabetical order (including the years, see
+  writeJSONYears()), an Area or Measure without any Measures or values is
+  written as null, and so is an empty Areas object.
+
+  @param os
+    The stream to write to
+
+  @example
+    Areas data = Areas();
+    ...
+    data.writeJSON(std::cout);
+*/
+void Areas::writeJSON(std::ostream &os) const {
+  OutputBuffer out(os);
+
+  if (storage->areas.empty()) {
+    out.write("null");
+    return;
+  }
+
+  out.write('{');
+  bool firstArea = true;
+  for (const auto &areaPair : storage->areas) {
+    const auto &area = areaPair.second;
+    if (!firstArea) {
+      out.write(',');
+    }
+    firstArea = false;
+
+    out.writeJSONString(areaPair.first.str());
+    out.write(":{\"measures\":");
+
+    const auto &measures = area.getMeasures();
+    if (measures.empty()) {
+      out.write("null");
+    } else {
+      out.write('{');
+      bool firstMeasure = true;
+      for (const auto &measurePair : measures) {
+        const auto &measure = measurePair.second;
+        if (!firstMeasure) {
+          out.write(',');
+        }
+        firstMeasure = false;
+
+        out.writeJSONString(measure.getCodename());
+        out.write(':');
+
+        const auto years = measure.getYears();
+        if (years.empty()) {
+          out.write("null");
+          continue;
+        }
+
+        writeJSONYears(out, measure);
+      }
+      out.write('}');
+    }
+
+    // "cym" comes before "eng" alphabetically
+    out.write(",\"names\":{");
+    const auto &names = area.getNames();
+    auto cym = names.find(LANG_CYM);
+    auto eng = names.find(LANG_ENG);
+    if (cym != nullptr) {
+      out.write("\"cym\":");
+      out.writeJSONString(cym->second.str());
+    }
+    if (eng != nullptr) {
+      if (cym != nullptr) {
+        out.write(',');
+      }
+      out.write("\"eng\":");
+      out.writeJSONString(eng->second.str());
+    }
+    out.write("}}");
+  }
+  out.write('}');
+}
+
 /*
   Convert an Areas object, and all its containing Area instances, and
   the Measure instances within those, to values.
-  
+
   @return
-    std::string of JSON // `{}` is Areas is empty
+    std::string of JSON, in the format written by writeJSON()
 
   @example
-    InputFile input("data/popu1009.json");
-    auto is = input.open();
+    Areas data = Areas();
+    std::cout << data.toJSON();
+*/
+std::string Areas::toJSON() const {
+  std::ostringstream ss;
+  writeJSON(ss);
+  return ss.str();
+}
 
-    auto cols = InputFiles::DATASETS["popden"].COLS;
+/*
+  Write the line that introduces an Area in the output tables, i.e. its
+  names and local authority code, e.g.
+    Isle of Anglesey / Ynys Môn (W06000001)
+*/
+static void writeAreaHeading(OutputBuffer &out, Symbol code, const Area &area) {
+  const auto &names = area.getNames();
 
-    auto areasFilter = BethYw::parseAreasArg();
-    auto measuresFilter = BethYw::parseMeasuresArg();
-    auto yearsFilter = BethYw::parseMeasuresArg();
+  auto eng = names.find(LANG_ENG);
+  auto cym = names.find(LANG_CYM);
+  if (eng != nullptr) {
+    out.write(eng->second.str());
+  }
+  if (cym != nullptr) {
+    out.write(" / ");
+    out.write(cym->second.str());
+  }
+  out.write(" (");
+  out.write(code.str());
+  out.write(")\n");
+}
+
+/*
+  Write all of the imported data to an output stream as tables, a piece at
+  a time through an OutputBuffer.
+
+  Areas are written in alphabetical order of their local authority code,
+  and the Measures within each Area in alphabetical order of their
+  codename. Each Measure is a table of its values by year, followed by
+  their average, difference and percentage difference, all to 6 decimal
+  places in columns 11 characters wide.
 
+  @param os
+    The stream to write to
+
+  @example
     Areas data = Areas();
-    std::cout << data.toJSON();
+    ...
+    data.writeTable(std::cout);
 */
-std::string Areas::toJSON() const {
-  json j;
+void Areas::writeTable(std::ostream &os) const {
+  OutputBuffer out(os);
 
-  for (const auto &areaPair : areas) {
-    const auto &localAuthorityCode = areaPair.first;
+  for (const auto &areaPair : storage->areas) {
     const auto &area = areaPair.second;
+    writeAreaHeading(out, areaPair.first, area);
 
-    json areaJson;
-    bool hasCym = true;
-    try {
-      area.getName("cym");
-    } catch (const std::out_of_range &e) {
-      hasCym = false;
-    }
-    areaJson["names"]["eng"] = area.getName("eng");
-    if (hasCym) {
-      areaJson["names"]["cym"] = area.getName("cym");
+    if (area.getMeasures().empty()) {
+      out.write("<no measures>\n");
+      continue;
     }
 
-    json measuresJson;
     for (const auto &measurePair : area.getMeasures()) {
       const auto &measure = measurePair.second;
-      const auto &measureCode = measure.getCodename();
 
-      json yearsJson;
+      out.write(measure.getLabel());
+      out.write(" (");
+      out.write(measure.getCodename());
+      out.write(")\n");
+
+      // Print years header
       for (const auto &yearPair : measure.getYears()) {
-        const auto &year = yearPair.first;
-        const auto &value = yearPair.second;
-        yearsJson[std::to_string(year)] = value;
+        out.writeInteger(yearPair.first, 11);
       }
+      out.writePadded("Average", 11);
+      out.writePadded("Diff.", 11);
+      out.writePadded("% Diff.\n", 11);
 
-      measuresJson[measureCode] = yearsJson;
+      // Print values for each year
+      for (const auto &yearPair : measure.getYears()) {
+        out.writeFixed(yearPair.second, 6, 11);
+        out.write(' ');
+      }
 
+      // Print average, difference, and percentage difference
+      out.writeFixed(measure.getAverage(), 6, 11);
+      out.writeFixed(measure.getDifference(), 6, 11);
+      out.writeFixed(measure.getDifferenceAsPercentage(), 6, 11);
+      out.write("\n\n");
     }
-
-    areaJson["measures"] = measuresJson;
-    j[localAuthorityCode] = areaJson;
   }
-
-  return j.dump();
 }
 
 /*
-  Overloaded << operator to print all of the imported data.
-
-  Areas should be printed and ordered alphabetically by their local authority code.
-  Measures within each Area should be ordered alphabetically by their codename.
-
-  @param areas
-    The Areas object to write to the output stream
+  Summarise every Measure of every Area in one pass over the data, using the
+  batch kernel BethYw::summariseSeries() on each Measure's contiguous
+  values. Years without a value are skipped.
 
   @return
-    Reference to the output stream
+    The statistics of each Measure, ordered by local authority code and
+    then measure codename
 
   @example
-    Areas areas();
-    std::cout << areas << std::end;
+    Areas data = Areas();
+    ...
+    for (const auto &row : data.computeStats()) {
+      std::cout << row.area << " " << row.measure << " "
+                << row.stats.mean << std::endl;
+    }
 */
-std::ostream& operator<<(std::ostream& os, const Areas& areas) {
-  for (const auto& areaPair : areas.areas) {
-    const auto& areaCode = areaPair.first;
-    const auto& area = areaPair.second;
+std::vector<Areas::MeasureStats> Areas::computeStats() const {
+  std::vector<MeasureStats> rows;
+  for (const auto &areaPair : storage->areas) {
+    for (const auto &measurePair : areaPair.second.getMeasures()) {
+      const auto &measure = measurePair.second;
+      rows.push_back({areaPair.first,
+                      measurePair.first,
+                      BethYw::summariseSeries(measure.data(), measure.slots())});
+    }
+  }
+  return rows;
+}
 
-    bool hasCym = true;
+/*
+  Write the summary statistics of every Measure (see computeStats()) to an
+  output stream as JSON, e.g.
+    {"W06000001":{"pop":{"average":...,"count":...,"difference":...,
+    "differencePercentage":...,"max":...,"min":...,"sum":...}}}
 
-    try {
-      area.getName("cym");
-    } catch (const std::out_of_range &e) {
-      hasCym = false;
+  @param os
+    The stream to write to
+
+  @example
+    Areas data = Areas();
+    ...
+    data.writeStatsJSON(std::cout);
+*/
+void Areas::writeStatsJSON(std::ostream &os) const {
+  OutputBuffer out(os);
+
+  out.write('{');
+  bool firstArea = true;
+  for (const auto &areaPair : storage->areas) {
+    if (!firstArea) {
+      out.write(',');
     }
+    firstArea = false;
 
-    if (hasCym) {
-      os << area.getName("eng") << " / " << area.getName("cym") << " (" << areaCode << ")\n";
-    } else {
-      os << area.getName("eng") << " (" << areaCode << ")\n";
+    out.writeJSONString(areaPair.first.str());
+    out.write(":{");
+    bool firstMeasure = true;
+    for (const auto &measurePair : areaPair.second.getMeasures()) {
+      const auto &measure = measurePair.second;
+      const auto stats = BethYw::summariseSeries(measure.data(), measure.slots());
+      if (!firstMeasure) {
+        out.write(',');
+      }
+      firstMeasure = false;
+
+      out.writeJSONString(measure.getCodename());
+      out.write(":{\"average\":");
+      out.writeJSONNumber(stats.mean);
+      out.write(",\"count\":");
+      out.writeInteger(stats.count);
+      out.write(",\"difference\":");
+      out.writeJSONNumber(stats.difference);
+      out.write(",\"differencePercentage\":");
+      out.writeJSONNumber(stats.differencePercentage);
+      out.write(",\"max\":");
+      out.writeJSONNumber(stats.max);
+      out.write(",\"min\":");
+      out.writeJSONNumber(stats.min);
+      out.write(",\"sum\":");
+      out.writeJSONNumber(stats.sum);
+      out.write('}');
     }
+    out.write('}');
+  }
+  out.write('}');
+}
 
-    if (area.getMeasures().empty()) {
-      os << "<no measures>\n";
-    } else {
-      for (const auto& measurePair : area.getMeasures()) {
-        const auto& measure = measurePair.second;
-
-        os << measure.getLabel() << " (" << measure.getCodename() << ")\n";
-        
-        // Print years header
-        for (const auto& yearPair : measure.getYears()) {
-          os << std::setw(11) << yearPair.first;
-        }
-        os << std::setw(11) << "Average" << std::setw(11) << "Diff." << std::setw(11) << "% Diff.\n";
+/*
+  Write the summary statistics of every Measure (see computeStats()) to an
+  output stream as tables, in the same layout as writeTable() but with one
+  row of statistics in place of each Measure's values.
 
-        // Print values for each year
-        for (const auto& yearPair : measure.getYears()) {
-          os << std::fixed << std::setprecision(6) << std::setw(11) << yearPair.second << " ";
-        }
+  @param os
+    The stream to write to
+
+  @example
+    Areas data = Areas();
+    ...
+    data.writeStatsTable(std::cout);
+*/
+void Areas::writeStatsTable(std::ostream &os) const {
+  OutputBuffer out(os);
+
+  for (const auto &areaPair : storage->areas) {
+    const auto &area = areaPair.second;
+    writeAreaHeading(out, areaPair.first, area);
+
+    if (area.getMeasures().empty()) {
+      out.write("<no measures>\n");
+      continue;
+    }
 
-        // Print average, difference, and percentage difference
-        os << std::fixed << std::setprecision(6) << std::setw(11) << measure.getAverage()
-          << std::setw(11) << measure.getDifference()
-          << std::setw(11) << measure.getDifferenceAsPercentage() << "\n\n";
+    for (const auto &measurePair : area.getMeasures()) {
+      const auto &measure = measurePair.second;
+      const auto stats = BethYw::summariseSeries(measure.data(), measure.slots());
+
+      out.write(measure.getLabel());
+      out.write(" (");
+      out.write(measure.getCodename());
+      out.write(")\n");
+
+      // Each column is at least 15 characters wide, and always starts with
+      // a space, so that large sums stay apart from their neighbours
+      out.write(" ");
+      out.writePadded("Count", 14);
+      for (const char* heading : {"Sum", "Average", "Min", "Max", "Diff.", "% Diff."}) {
+        out.write(" ");
+        out.writePadded(heading, 14);
+      }
+      out.write('\n');
+
+      out.write(" ");
+      out.writeInteger(stats.count, 14);
+      for (double value : {stats.sum, stats.mean, stats.min, stats.max,
+                           stats.difference, stats.differencePercentage}) {
+        out.write(" ");
+        out.writeFixed(value, 6, 14);
       }
+      out.write("\n\n");
     }
   }
+}
+
+/*
+  Overloaded << operator to print all of the imported data, as tables (see
+  Areas::writeTable()).
+
+  @param areas
+    The Areas object to write to the output stream
+
+  @return
+    Reference to the output stream
+
+  @example
+    Areas areas();
+    std::cout << areas << std::end;
+*/
+std::ostream& operator<<(std::ostream& os, const Areas& areas) {
+  areas.writeTable(os);
   return os;
 }
@@ -23,39 +23,137 @@
         +-> Areas A class that contains all Area objects.
  */
 
+#include <cstddef>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <string>
-#include <tuple>
-#include <unordered_set>
+#include <string_view>
+#include <vector>
 
 #include "datasets.h"
 #include "area.h"
+#include "containers.h"
+#include "filter.h"
+#include "kernels.h"
+#include "profile.h"
+#include "symbol.h"
 
 /*
-  An alias for filters based on strings such as categorisations e.g. area,
-  and measures.
+  An alias for the container within an Areas object that stores its Area
+  objects, by local authority code. Any container with the interface of
+  those in containers.h can be used, e.g. SortedVectorMap<Symbol, Area>,
+  which is smaller but slower to import into, since each new area moves the
+  ones after it. Either way, iterating visits the areas in order of their
+  codes.
 */
-using StringFilterSet = std::unordered_set<std::string>;
+using AreasContainer = FlatHashMap<Symbol, Area>;
 
-/*
-  An alias for a year filter.
-*/
-using YearFilterTuple = std::tuple<unsigned int, unsigned int>;
-
-/*
-  An alias for the data within an Areas object stores Area objects.
-*/
-class Null { };
-using AreasContainer = Null;
+class CSVReader;
+class WelshStatsJSONHandler;
 
 /*
   Areas is a class that stores all the data categorised by area.
+
+  Each populate() function can read from either a standard input stream or
+  an in-memory buffer of the whole file (e.g. from InputMappedFile). The
+  areas, measures and years to import can be given either as separate
+  filters or as a Filter compiled from them once (see filter.h), which is
+  what each parser checks its rows against.
+
+  Every Area and Measure stored in an Areas object is allocated from an arena
+  owned by it, which is only freed (all at once) when the Areas object is
+  destroyed. Copying an Areas object copies its data into a new arena, and
+  moving one moves the arena with it.
 */
 class Areas {
+public:
+  /*
+    The size of the arena's first block of memory (later blocks grow
+    geometrically)
+  */
+  static constexpr std::size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+  /*
+    One Area's Measure with a given codename, in getMeasureIndex()
+  */
+  struct MeasureEntry {
+    Symbol area;
+    const Measure* measure;
+  };
+
+  /*
+    One Area's value of one Measure in a given year, in getYearIndex()
+  */
+  struct YearEntry {
+    Symbol area;
+    Symbol measure;
+    double value;
+  };
+
+  /*
+    A read-only view of a contiguous run of entries in one of the secondary
+    indexes, which is valid until the Areas object is next modified.
+  */
+  template <typename Entry>
+  class IndexRange {
+  public:
+    IndexRange() : first(nullptr), last(nullptr) {}
+    IndexRange(const Entry* first, const Entry* last) : first(first), last(last) {}
+
+    const Entry* begin() const { return first; }
+    const Entry* end() const { return last; }
+    std::size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const Entry& operator[](std::size_t i) const { return first[i]; }
+
+  private:
+    const Entry* first;
+    const Entry* last;
+  };
+
 private:
-  std::map<std::string, Area> areas;
+  /*
+    The secondary indexes over the areas: each measure codename's Measures
+    in order of local authority code, and each year's values in order of
+    measure codename then local authority code.
+  */
+  struct Indexes {
+    std::map<Symbol, std::vector<MeasureEntry>> measures;
+    std::map<int, std::vector<YearEntry>> years;
+  };
+
+  /*
+    The arena and the container allocating from it, kept together so that
+    they can be moved as one, along with the secondary indexes over the
+    container, which are built on first use and thrown away whenever the
+    container is modified.
+  */
+  struct Storage {
+    std::pmr::monotonic_buffer_resource arena{ARENA_BLOCK_SIZE, Profile::upstream()};
+    AreasContainer areas{&arena};
+    std::mutex indexMutex;
+    std::unique_ptr<const Indexes> indexes;
+  };
+
+  std::unique_ptr<Storage> storage;
+  unsigned int threads = 1;
 public:
   Areas();
+  Areas(const Areas& other);
+  Areas(Areas&& other);
+  Areas& operator=(const Areas& other);
+  Areas& operator=(Areas&& other);
+
+  /*
+    The smallest part of a file worth handing to its own thread
+  */
+  static constexpr std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+  void setThreads(unsigned int numThreads);
   
   void populateFromAuthorityCodeCSV(
       std::istream& is,
@@ -63,11 +161,34 @@ public:
       const StringFilterSet * const areas = nullptr)
       noexcept(false);
 
+  void populateFromAuthorityCodeCSV(
+      std::string_view buffer,
+      const BethYw::SourceColumnMapping& cols,
+      const StringFilterSet * const areas = nullptr)
+      noexcept(false);
+
+  void populateFromAuthorityCodeCSV(
+      std::istream& is,
+      const BethYw::SourceColumnMapping& cols,
+      const Filter& filter)
+      noexcept(false);
+
+  void populateFromAuthorityCodeCSV(
+      std::string_view buffer,
+      const BethYw::SourceColumnMapping& cols,
+      const Filter& filter)
+      noexcept(false);
+
   void populate(
       std::istream& is,
       const BethYw::SourceDataType& type,
       const BethYw::SourceColumnMapping& cols) noexcept(false);
 
+  void populate(
+      std::string_view buffer,
+      const BethYw::SourceDataType& type,
+      const BethYw::SourceColumnMapping& cols) noexcept(false);
+
   void populate(
       std::istream& is,
       const BethYw::SourceDataType& type,
@@ -77,9 +198,49 @@ public:
       const YearFilterTuple * const yearsFilter = nullptr)
       noexcept(false);
 
+  void populate(
+      std::string_view buffer,
+      const BethYw::SourceDataType& type,
+      const BethYw::SourceColumnMapping& cols,
+      const StringFilterSet * const areasFilter = nullptr,
+      const StringFilterSet * const measuresFilter = nullptr,
+      const YearFilterTuple * const yearsFilter = nullptr)
+      noexcept(false);
+
+  void populate(
+      std::istream& is,
+      const BethYw::SourceDataType& type,
+      const BethYw::SourceColumnMapping& cols,
+      const Filter& filter)
+      noexcept(false);
+
+  void populate(
+      std::string_view buffer,
+      const BethYw::SourceDataType& type,
+      const BethYw::SourceColumnMapping& cols,
+      const Filter& filter)
+      noexcept(false);
+
   std::string toJSON() const;
+  void writeJSON(std::ostream& os) const;
+  void writeTable(std::ostream& os) const;
+
+  /*
+    The summary statistics of one Measure of one Area
+  */
+  struct MeasureStats {
+    Symbol area;
+    Symbol measure;
+    BethYw::SeriesStats stats;
+  };
+
+  std::vector<MeasureStats> computeStats() const;
+  void writeStatsJSON(std::ostream& os) const;
+  void writeStatsTable(std::ostream& os) const;
 
   void insertArea(const Area& area);
+  void insertArea(Area&& area);
+  Area& emplaceArea(Symbol localAuthorityCode);
 
   void populateFromWelshStatsJSON(std::istream &is,
                                        const BethYw::SourceColumnMapping &cols,
@@ -87,18 +248,96 @@ public:
                                        const StringFilterSet * const measuresFilter,
                                        const YearFilterTuple * const yearsFilter);
 
+  void populateFromWelshStatsJSON(std::string_view buffer,
+                                       const BethYw::SourceColumnMapping &cols,
+                                       const StringFilterSet * const areasFilter,
+                                       const StringFilterSet * const measuresFilter,
+                                       const YearFilterTuple * const yearsFilter);
+
+  void populateFromWelshStatsJSON(std::istream &is,
+                                  const BethYw::SourceColumnMapping &cols,
+                                  const Filter &filter);
+
+  void populateFromWelshStatsJSON(std::string_view buffer,
+                                  const BethYw::SourceColumnMapping &cols,
+                                  const Filter &filter);
+
   void populateFromAuthorityByYearCSV(std::istream &is,
                                       const BethYw::SourceColumnMapping &cols,
                                       const StringFilterSet *const areasFilter,
                                       const StringFilterSet *const measuresFilter,
                                       const YearFilterTuple *const yearsFilter);
+
+  void populateFromAuthorityByYearCSV(std::string_view buffer,
+                                      const BethYw::SourceColumnMapping &cols,
+                                      const StringFilterSet *const areasFilter,
+                                      const StringFilterSet *const measuresFilter,
+                                      const YearFilterTuple *const yearsFilter);
+
+  void populateFromAuthorityByYearCSV(std::istream &is,
+                                      const BethYw::SourceColumnMapping &cols,
+                                      const Filter &filter);
+
+  void populateFromAuthorityByYearCSV(std::string_view buffer,
+                                      const BethYw::SourceColumnMapping &cols,
+                                      const Filter &filter);
   
   void setArea(const std::string &localAuthorityCode, Area area);
+  void setArea(Symbol localAuthorityCode, Area area);
+
+  void merge(Areas&& other);
+  void merge(const Areas& other);
+  Areas select(const Filter& filter) const;
 
   Area& getArea(const std::string& localAuthorityCode);
 
   std::size_t size() const;
   friend std::ostream& operator<<(std::ostream& os, const Areas& _areas);
+  const AreasContainer& getAreas() const {
+    return storage->areas;
+  };
+
+  IndexRange<MeasureEntry> getMeasureIndex(const std::string& measureCode) const;
+  IndexRange<YearEntry> getYearIndex(int year) const;
+  IndexRange<YearEntry> getYearIndex(int year, const std::string& measureCode) const;
+
+private:
+  const Indexes& indexes() const;
+  void invalidateIndexes();
+
+  void populateFromAuthorityCodeCSV(
+      CSVReader& reader,
+      const BethYw::SourceColumnMapping& cols,
+      const Filter& filter);
+
+  /*
+    The row layouts of WelshStatsJSON files: each row names its measure
+    (e.g. popden, biz and aqi), or the file holds a single measure named by
+    the column mapping (e.g. trains).
+  */
+  enum class JSONLayout { MEASURE_COLUMN, SINGLE_MEASURE };
+
+  void populateFromWelshStatsJSON(
+      const std::function<void(WelshStatsJSONHandler&)>& parse,
+      const BethYw::SourceColumnMapping &cols,
+      const Filter &filter);
+
+  template <JSONLayout Layout>
+  void populateWelshStatsRows(
+      const std::function<void(WelshStatsJSONHandler&)>& parse,
+      const BethYw::SourceColumnMapping &cols,
+      const Filter &filter);
+
+  void populateFromAuthorityByYearCSV(
+      CSVReader& reader,
+      const BethYw::SourceColumnMapping &cols,
+      const Filter &filter);
+
+  void populateFromAuthorityByYearCSVChunks(
+      CSVReader& reader,
+      std::string_view buffer,
+      const BethYw::SourceColumnMapping &cols,
+      const Filter &filter);
 };
 
 #endif // AREAS_H
\ No newline at end of file
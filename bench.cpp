@@ -0,0 +1,298 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the entry point of bethyw-bench (bash build.sh bench),
+  which generates synthetic datasets (see synthetic.h) of a given size and
+  times the import pipeline on them: every populate() path (from a buffer,
+  a stream and a stream read ahead on its own thread), writing the
+  result as JSON and as tables, and computing the Measure statistics. Each
+  benchmark is run several times and the fastest run is reported, with its
+  throughput and the peak resident memory of the process so far.
+ */
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "lib_cxxopts.hpp"
+
+#include "areas.h"
+#include "bethyw.h"
+#include "columnar.h"
+#include "filter.h"
+#include "input.h"
+#include "kernels.h"
+#include "synthetic.h"
+
+/*
+  The peak resident set size of the process so far, in megabytes, or 0
+  where it cannot be found.
+*/
+static double peakMegabytes() {
+#ifdef _WIN32
+  return 0;
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+  return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+/*
+  Run a benchmark `repeats` times and return the fastest run, in seconds.
+  The benchmark times itself (so that it can leave out its set up), by
+  returning its own duration.
+*/
+template <typename Run>
+static double fastest(unsigned int repeats, Run run) {
+  double best = 0;
+  for (unsigned int i = 0; i < repeats; i++) {
+    const double seconds = run();
+    if (i == 0 || seconds < best) {
+      best = seconds;
+    }
+  }
+  return best;
+}
+
+/*
+  Time a piece of work, in seconds.
+*/
+template <typename Work>
+static double timed(Work work) {
+  const auto start = std::chrono::steady_clock::now();
+  work();
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+/*
+  Print one benchmark's results as a row of the results table.
+*/
+static void report(const std::string &name,
+                   double seconds,
+                   std::size_t rows,
+                   std::uintmax_t bytes) {
+  std::cout << std::left << std::setw(36) << name << std::right
+            << std::fixed << std::setprecision(2)
+            << std::setw(12) << seconds * 1000
+            << std::setw(16) << std::setprecision(0) << rows / seconds
+            << std::setw(12) << std::setprecision(2) << bytes / seconds / (1024 * 1024)
+            << std::setw(15) << peakMegabytes() << std::endl;
+}
+
+/*
+  The number of values in every Measure of every Area.
+*/
+static std::size_t countValues(const Areas &areas) {
+  std::size_t values = 0;
+  for (const auto &areaPair : areas.getAreas()) {
+    for (const auto &measurePair : areaPair.second.getMeasures()) {
+      values += measurePair.second.size();
+    }
+  }
+  return values;
+}
+
+int main(int argc, char *argv[]) {
+  cxxopts::Options cxxopts(
+      "bethyw-bench",
+      "Generates synthetic datasets and benchmarks importing and writing "
+      "them.\n");
+
+  cxxopts.add_options()(
+      "areas",
+      "Number of areas in each synthetic dataset",
+      cxxopts::value<unsigned int>()->default_value("1000"))(
+
+      "measures",
+      "Number of measures in each synthetic dataset with a measure column",
+      cxxopts::value<unsigned int>()->default_value("10"))(
+
+      "years",
+      "Number of years of each measure",
+      cxxopts::value<unsigned int>()->default_value("30"))(
+
+      "repeat",
+      "Number of times to run each benchmark (the fastest run is reported)",
+      cxxopts::value<unsigned int>()->default_value("3"))(
+
+      "dir",
+      "Directory to write the synthetic datasets to, which are kept (by "
+      "default they are written to a temporary directory and deleted)",
+      cxxopts::value<std::string>())(
+
+      "generate-only",
+      "Only write the synthetic datasets (to --dir), without benchmarking")(
+
+      "h,help",
+      "Print usage.");
+
+  auto args = cxxopts.parse(argc, argv);
+  if (args.count("help")) {
+    std::cerr << cxxopts.help() << std::endl;
+    return 0;
+  }
+
+  BethYw::SyntheticShape shape;
+  shape.areas = args["areas"].as<unsigned int>();
+  shape.measures = args["measures"].as<unsigned int>();
+  shape.years = args["years"].as<unsigned int>();
+  const unsigned int repeats = std::max(1u, args["repeat"].as<unsigned int>());
+
+  const bool keep = args.count("dir");
+  if (args.count("generate-only") && !keep) {
+    std::cerr << "--generate-only needs --dir" << std::endl;
+    return 1;
+  }
+
+  std::string dir;
+  if (keep) {
+    dir = args["dir"].as<std::string>();
+  } else {
+    const auto ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+    dir = (std::filesystem::temp_directory_path() /
+           ("bethyw-bench-" + std::to_string(ticks))).string();
+  }
+  dir += DIR_SEP;
+
+  std::vector<BethYw::SyntheticFile> files;
+  const double generating = timed([&] {
+    files = BethYw::generateSynthetic(dir, shape);
+  });
+
+  std::uintmax_t totalBytes = 0;
+  for (const auto &file : files) {
+    totalBytes += file.bytes;
+  }
+  std::cout << "Generated " << files.size() << " files ("
+            << std::fixed << std::setprecision(2)
+            << totalBytes / (1024.0 * 1024.0) << " MB) for "
+            << shape.areas << " areas, " << shape.measures << " measures and "
+            << shape.years << " years in " << generating << " s, in "
+            << dir << std::endl;
+  if (args.count("generate-only")) {
+    return 0;
+  }
+
+  std::cout << std::endl
+            << std::left << std::setw(36) << "Benchmark" << std::right
+            << std::setw(12) << "Time (ms)"
+            << std::setw(16) << "Rows/s"
+            << std::setw(12) << "MB/s"
+            << std::setw(15) << "Peak RSS (MB)" << std::endl;
+
+  // The areas every dataset is imported into, as in BethYw::run()
+  const Filter everything;
+  Areas base;
+  Areas all;
+  for (const auto &file : files) {
+    const auto &source = *file.source;
+    const bool isAreas = source.PARSER == BethYw::AuthorityCodeCSV;
+
+    InputMappedFile input(file.path);
+    const std::string_view buffer = input.open();
+
+    const double bufferSeconds = fastest(repeats, [&] {
+      Areas areas = isAreas ? Areas() : base;
+      return timed([&] { areas.populate(buffer, source.PARSER, source.COLS, everything); });
+    });
+    report("populate " + source.CODE + " (buffer)", bufferSeconds, file.rows, file.bytes);
+
+    const double streamSeconds = fastest(repeats, [&] {
+      Areas areas = isAreas ? Areas() : base;
+      InputFile stream(file.path);
+      return timed([&] { areas.populate(stream.open(), source.PARSER, source.COLS, everything); });
+    });
+    report("populate " + source.CODE + " (stream)", streamSeconds, file.rows, file.bytes);
+
+    const double readAheadSeconds = fastest(repeats, [&] {
+      Areas areas = isAreas ? Areas() : base;
+      InputFile stream(file.path, InputFile::READ_AHEAD);
+      return timed([&] { areas.populate(stream.open(), source.PARSER, source.COLS, everything); });
+    });
+    report("populate " + source.CODE + " (read-ahead)", readAheadSeconds, file.rows, file.bytes);
+
+    if (isAreas) {
+      base.populate(buffer, source.PARSER, source.COLS, everything);
+      all = base;
+    } else {
+      all.populate(buffer, source.PARSER, source.COLS, everything);
+    }
+  }
+
+  const std::size_t values = countValues(all);
+
+  std::size_t jsonBytes = 0;
+  const double jsonSeconds = fastest(repeats, [&] {
+    return timed([&] { jsonBytes = all.toJSON().size(); });
+  });
+  report("Areas::toJSON", jsonSeconds, values, jsonBytes);
+
+  std::size_t tableBytes = 0;
+  const double tableSeconds = fastest(repeats, [&] {
+    std::ostringstream os;
+    const double seconds = timed([&] { os << all; });
+    tableBytes = os.str().size();
+    return seconds;
+  });
+  report("operator<<", tableSeconds, values, tableBytes);
+
+  std::size_t columnarBytes = 0;
+  const double columnarSeconds = fastest(repeats, [&] {
+    std::ostringstream os;
+    const double seconds = timed([&] { ColumnarFile::write(os, all); });
+    columnarBytes = os.str().size();
+    return seconds;
+  });
+  report("ColumnarFile::write", columnarSeconds, values, columnarBytes);
+
+  // Sum the statistics so that computing them cannot be optimised away
+  std::size_t measures = 0;
+  std::size_t slotBytes = 0;
+  double checksum = 0;
+  const double statsSeconds = fastest(repeats, [&] {
+    measures = 0;
+    slotBytes = 0;
+    checksum = 0;
+    return timed([&] {
+      for (const auto &areaPair : all.getAreas()) {
+        for (const auto &measurePair : areaPair.second.getMeasures()) {
+          const auto &measure = measurePair.second;
+          checksum += measure.getAverage() + measure.getDifference() +
+                      measure.getDifferenceAsPercentage() + measure.getVariance();
+          checksum += BethYw::summariseSeries(measure.data(), measure.slots()).sum;
+          measures++;
+          slotBytes += measure.slots() * sizeof(double);
+        }
+      }
+    });
+  });
+  report("Measure statistics", statsSeconds, measures, slotBytes);
+
+  std::cout << std::endl << "Rows are CSV lines or JSON objects for populate, "
+            << "values for the writers, and measures for the statistics "
+            << "(checksum " << std::setprecision(6) << checksum << ")." << std::endl;
+
+  if (!keep) {
+    std::error_code error;
+    std::filesystem::remove_all(dir, error);
+  }
+  return 0;
+}
@@ -12,7 +12,12 @@
   Beth Yw?
 */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <tuple>
 #include <unordered_set>
@@ -22,13 +27,41 @@
 #include "lib_cxxopts.hpp"
 
 #include "areas.h"
+#include "columnar.h"
 #include "datasets.h"
 #include "bethyw.h"
 #include "input.h"
+#include "live.h"
+#include "metadata.h"
+#include "parallel.h"
+#include "profile.h"
+#include "query.h"
+#include "server.h"
+#include "snapshot.h"
+
+/*
+  Print the profile to std::cerr, if profiling is on, once the timer of the
+  whole run has been stopped.
+*/
+static void reportProfile(Profile::Timer &total, bool json) {
+  if (!Profile::enabled()) {
+    return;
+  }
+
+  total.stop();
+  if (json) {
+    Profile::writeJSON(std::cerr);
+    std::cerr << std::endl;
+  } else {
+    Profile::writeReport(std::cerr);
+  }
+}
 
 /*
   Run Beth Yw?, parsing the command line arguments, importing the data,
-  and outputting the requested data to the standard output/error.
+  and outputting the requested data to the standard output/error. If the
+  first argument is "merge", the merge subcommand is run instead (see
+  mergeShards()).
 
   @param argc
     Number of program arguments
@@ -40,6 +73,10 @@
     Exit code
 */
 int BethYw::run(int argc, char *argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "merge") {
+    return BethYw::mergeShards(argc - 1, argv + 1);
+  }
+
   auto cxxopts = BethYw::cxxoptsSetup();
   auto args = cxxopts.parse(argc, argv);
 
@@ -49,13 +86,24 @@ int BethYw::run(int argc, char *argv[]) {
     return 0;
   }
 
+  // Validate the profile argument before doing any of the work it times
+  const bool profileJSON = BethYw::parseProfileArg(args);
+  Profile::Timer total("run");
+
+  BethYw::setReadAhead(args.count("read-ahead") > 0);
+
   // Parse data directory argument
   std::string dir = args["dir"].as<std::string>() + DIR_SEP;
   try {
     std::string exampleFile = "areas.csv";
-    std::string inputFilePath = dir + exampleFile;
-    InputFile inputFile(inputFilePath);
-    inputFile.open();
+    std::string inputFilePath = findInputFile(dir + exampleFile);
+    if (detectCompression(inputFilePath) != Compression::NONE) {
+      InputCompressedFile inputFile(inputFilePath);
+      inputFile.open();
+    } else {
+      InputFile inputFile(inputFilePath);
+      inputFile.open();
+    }
   } catch (const std::exception &e) {
     std::cerr << "Error importing dataset: " << std::endl;
     std::cerr << e.what();
@@ -65,29 +113,245 @@ int BethYw::run(int argc, char *argv[]) {
 
   // Parse other arguments and import data
   auto datasetsToImport = BethYw::parseDatasetsArg(args);
-  auto areasFilter      = BethYw::parseAreasArg(args);
-  auto measuresFilter   = BethYw::parseMeasuresArg(args);
-  auto yearsFilter      = BethYw::parseYearsArg(args);
 
   Areas data = Areas();
+  MetadataIndex index;
+
+  // A snapshot can only stand in for a run with exactly the same arguments,
+  // so the filter arguments need not be parsed (or validated against the
+  // datasets) again when one is used. Even when it can't, its index can
+  // save scanning the datasets for their measures.
+  std::string query = BethYw::cacheQuery(args);
+  const bool serving = args.count("serve");
+  bool fromCache = !serving &&
+                   args.count("load-cache") &&
+                   BethYw::loadCache(data,
+                                     index,
+                                     args["load-cache"].as<std::string>(),
+                                     query);
+
+  if (!fromCache) {
+    // Read areas.csv once, both to validate the areas argument and to
+    // provide the areas to import
+    Areas allAreas;
+    BethYw::loadAreas(allAreas, dir, {});
+    index.addAreas(allAreas);
+
+    auto areasFilter      = BethYw::parseAreasArg(args, index);
+    auto measuresFilter   = BethYw::parseMeasuresArg(args, index, dir);
+    auto yearsFilter      = BethYw::parseYearsArg(args);
+    auto shard            = BethYw::parseShardArg(args);
+
+    // Compile the filters once, for every dataset and thread to share
+    const Filter filter(&areasFilter, &measuresFilter, &yearsFilter, shard);
+
+    for (const auto &areaPair : allAreas.getAreas()) {
+      if (filter.areas().contains(areaPair.first)) {
+        data.setArea(areaPair.first, areaPair.second);
+      }
+    }
+
+    if (serving) {
+      // The server imports the datasets itself, to be able to import again
+      // only the ones that change
+      return BethYw::serve(args, dir, datasetsToImport, filter,
+                           std::move(data), std::move(index));
+    }
+
+    // Fingerprint the sources before reading them, so that a file changing
+    // during the import invalidates the snapshot rather than being missed
+    std::vector<SourceFingerprint> sources;
+    std::string cachePath;
+    if (args.count("save-cache")) {
+      cachePath = args["save-cache"].as<std::string>();
+    } else if (args.count("load-cache")) {
+      cachePath = args["load-cache"].as<std::string>();
+    }
+    if (!cachePath.empty()) {
+      sources = BethYw::cacheSources(dir, datasetsToImport);
+    }
+
+    BethYw::loadDatasets(data,
+                         dir,
+                         BethYw::planDatasets(datasetsToImport, measuresFilter, index),
+                         filter,
+                         args["threads"].as<unsigned int>());
+
+    if (!cachePath.empty()) {
+      BethYw::saveCache(data, index, cachePath, query, sources);
+    }
+  }
+
+  const int status = BethYw::writeOutput(data, args);
+  reportProfile(total, profileJSON);
+  return status;
+}
+
+/*
+  Import the datasets and answer queries for them over HTTP (--serve) until
+  the process is killed, re-importing any dataset whose file changes every
+  --reload seconds (if given).
+
+  @param args
+    Parsed program arguments
 
-  BethYw::loadAreas(data, dir, areasFilter);
-  
-  BethYw::loadDatasets(data,
-                       dir,
-                       datasetsToImport,
-                       areasFilter,
-                       measuresFilter,
-                       yearsFilter);
+  @param dir
+    The directory the datasets are in
+
+  @param datasetsToImport
+    The datasets to import
+
+  @param filter
+    The areas, measures and years to import
+
+  @param base
+    The areas to import the datasets into, from areas.csv
+
+  @param index
+    The metadata index holding the area codes
+
+  @return
+    Exit code, if the server stops
+
+  @throws
+    std::invalid_argument if the serve argument is not a valid port, with
+    the message: Invalid input for serve argument
+    std::runtime_error if the port cannot be listened on
+
+  @example
+    return BethYw::serve(args, dir, datasetsToImport, filter,
+                         std::move(data), std::move(index));
+*/
+int BethYw::serve(cxxopts::ParseResult& args,
+                  const std::string &dir,
+                  const std::vector<BethYw::InputFileSource> &datasetsToImport,
+                  const Filter &filter,
+                  Areas base,
+                  MetadataIndex index) {
+  const unsigned int port = args["serve"].as<unsigned int>();
+  if (port == 0 || port > 65535) {
+    throw std::invalid_argument("Invalid input for serve argument");
+  }
+
+  // With no --threads, import on one thread but answer requests on many
+  unsigned int workers = 0;
+  unsigned int importThreads = 1;
+  if (args.count("threads")) {
+    workers = importThreads = args["threads"].as<unsigned int>();
+  }
 
-  if (args.count("json")) {
+  LiveAreas live(dir, datasetsToImport, filter,
+                 std::move(base), std::move(index), importThreads);
+  if (args.count("reload")) {
+    live.watch(std::chrono::seconds(args["reload"].as<unsigned int>()));
+  }
+
+  Server server(live);
+  server.serve(static_cast<unsigned short>(port), workers);
+  return 0;
+}
+
+/*
+  Write the imported data to an output stream in the form the arguments ask
+  for: an aggregate (--aggregate), a ranking (--top), summary statistics
+  (--stats-only) or the data itself, as JSON (--json) or tables.
+
+  @param os
+    The stream to write to
+
+  @param data
+    The imported data
+
+  @param args
+    Parsed program arguments
+
+  @throws
+    std::invalid_argument if the aggregate, group-by or range argument is
+    invalid (see parseQueryArgs())
+
+  @example
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, argv);
+    ...
+    BethYw::writeOutput(std::cout, data, args);
+*/
+void BethYw::writeOutput(std::ostream &os,
+                         const Areas &data,
+                         cxxopts::ParseResult& args) {
+  Profile::Timer timer("writeOutput");
+  if (args.count("aggregate")) {
+    // Reduce the values across areas, grouped by measure and/or year
+    const Query q = BethYw::parseQueryArgs(args);
+    const auto groups = q.aggregate(data);
+    if (args.count("json")) {
+      q.writeAggregateJSON(os, groups);
+    } else {
+      q.writeAggregateTable(os, groups);
+    }
+    os << std::endl;
+  } else if (args.count("top")) {
+    // Rank the measures of every area by percentage difference
+    const Query q = BethYw::parseQueryArgs(args);
+    const auto rows = q.top(data, args["top"].as<unsigned int>());
+    if (args.count("json")) {
+      q.writeTopJSON(os, rows);
+    } else {
+      q.writeTopTable(os, rows);
+    }
+    os << std::endl;
+  } else if (args.count("stats-only")) {
+    // Only the summary statistics of each measure
+    if (args.count("json")) {
+      data.writeStatsJSON(os);
+    } else {
+      data.writeStatsTable(os);
+    }
+    os << std::endl;
+  } else if (args.count("json")) {
     // The output as JSON
-    std::cout << data.toJSON() << std::endl;
+    data.writeJSON(os);
+    os << std::endl;
   } else {
     // The output as tables
-    std::cout << data << std::endl;
+    os << data << std::endl;
+  }
+}
+
+/*
+  Write the imported data as the arguments ask for: to the file given by
+  the output argument as a columnar file (see ColumnarFile), or otherwise
+  to the standard output as above. A file that cannot be written is
+  reported to std::cerr.
+
+  @param data
+    The imported data
+
+  @param args
+    Parsed program arguments
+
+  @return
+    Exit code: 0, or 1 if the output file could not be written
+
+  @throws
+    std::invalid_argument if the aggregate, group-by or range argument is
+    invalid (see parseQueryArgs())
+
+  @example
+    return BethYw::writeOutput(data, args);
+*/
+int BethYw::writeOutput(const Areas &data, cxxopts::ParseResult &args) {
+  if (!args.count("output")) {
+    writeOutput(std::cout, data, args);
+    return 0;
   }
 
+  try {
+    ColumnarFile::save(args["output"].as<std::string>(), data);
+  } catch (const std::exception &e) {
+    std::cerr << "Error writing output: " << std::endl;
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
   return 0;
 }
 
@@ -136,6 +400,81 @@ cxxopts::Options BethYw::cxxoptsSetup() {
       "j,json",
       "Print the output as JSON instead of tables.")(
 
+      "stats-only",
+      "Print only the count, sum, average, minimum, maximum and (percentage) "
+      "difference of each measure, instead of its values.")(
+
+      "aggregate",
+      "Print the sum, avg, min or max of the values across all areas, "
+      "grouped as set by --group-by, instead of the values themselves",
+      cxxopts::value<std::string>())(
+
+      "group-by",
+      "How to group the values for --aggregate, as a comma-separated list of "
+      "measure and/or year (set to 'none' for a single group)",
+      cxxopts::value<std::vector<std::string>>()->default_value("measure,year"))(
+
+      "top",
+      "Print the given number of (area, measure) pairs with the largest "
+      "percentage difference, instead of the values themselves",
+      cxxopts::value<unsigned int>())(
+
+      "range",
+      "Only consider values (for --aggregate) or percentage differences (for "
+      "--top) in the inclusive range MIN:MAX, either of which may be omitted",
+      cxxopts::value<std::string>())(
+
+      "serve",
+      "Import the datasets once and answer queries for them over HTTP on "
+      "the given port of 127.0.0.1, e.g. GET /?areas=W06000011&measures=pop"
+      "&json (see server.h)",
+      cxxopts::value<unsigned int>())(
+
+      "reload",
+      "With --serve, check the datasets for changes every given number of "
+      "seconds, and import again (in the background) the ones that changed",
+      cxxopts::value<unsigned int>())(
+
+      "save-cache",
+      "Import the datasets and save the result as a binary snapshot to the "
+      "given file",
+      cxxopts::value<std::string>())(
+
+      "load-cache",
+      "Use the binary snapshot in the given file if it was saved with the "
+      "same arguments and its datasets have not changed, otherwise import "
+      "the datasets and save a new snapshot to the file",
+      cxxopts::value<std::string>())(
+
+      "shard",
+      "Import only the areas in shard i of N (e.g. 2/4), as split by a hash "
+      "of their authority codes, e.g. to save a partial snapshot with "
+      "--save-cache on each of N machines and combine them with the merge "
+      "subcommand",
+      cxxopts::value<std::string>())(
+
+      "output",
+      "Write the imported data to the given file as a columnar Apache Arrow "
+      "IPC (Feather) file, for e.g. pandas or DuckDB to read, instead of "
+      "printing it",
+      cxxopts::value<std::string>())(
+
+      "profile",
+      "Print how long each phase of the import and output took, and how many "
+      "rows and bytes it handled, for each dataset to stderr, as a table or "
+      "as JSON with --profile=json",
+      cxxopts::value<std::string>()->implicit_value("table"))(
+
+      "read-ahead",
+      "Read the datasets in large blocks on a thread that keeps ahead of "
+      "parsing them, instead of memory mapping them (e.g. for datasets on a "
+      "network filesystem)")(
+
+      "t,threads",
+      "Number of threads used to import datasets in parallel "
+      "(0 for one per hardware thread)",
+      cxxopts::value<unsigned int>()->default_value("1"))(
+
       "h,help",
       "Print usage.");
 
@@ -232,17 +571,20 @@ std::vector<BethYw::InputFileSource> BethYw::parseDatasetsArg(
 
 /*
   Parses the areas command line argument, which is optional. If it doesn't 
-  exist or exists and contains "all" as value (any case), all areas should be
-  imported, i.e., the filter should be an empty set.
+  exist, all areas should be imported, i.e., the filter should be an empty
+  set. If it contains "all" as its first value (any case), every area in
+  areas.csv is imported.
 
-  Unlike datasets validity of the values can't be checked as it depends
-  on each individual file imported (which hasn't happened until runtime).
-  Therefore, simply fetch the list of areas and later pass it to the
-  Areas::populate() function.
+  Each value is validated against the local authority codes in the
+  MetadataIndex, which should contain the areas in areas.csv (see
+  MetadataIndex::addAreas()).
 
   @param args
     Parsed program arguments
 
+  @param index
+    The MetadataIndex holding the valid area codes
+
   @return 
     An std::unordered_set of std::strings corresponding to specific areas
     to import, or an empty set if all areas should be imported.
@@ -250,84 +592,88 @@ std::vector<BethYw::InputFileSource> BethYw::parseDatasetsArg(
   @throws
     std::invalid_argument if the argument contains an invalid areas value with
     message: Invalid input for area argument
-*/
-std::unordered_set<std::string> BethYw::parseAreasArg(
-    cxxopts::ParseResult& args) {
-  // The unordered set you will return
-  std::unordered_set<std::string> areasToReturn;
 
-  // Read CSV file to obtain area codes
-  std::vector<std::vector<std::string>> content;
-  std::vector<std::string> row;
-  std::string line, word;
-
-  std::fstream file ("datasets/areas.csv", std::ios::in);
-  if (file.is_open()) {
-    while (getline(file, line)) {
-      row.clear();
-      std::stringstream sr(line);
-      while (getline(sr, word, ',')) {
-        row.push_back(word);
-      }
-      content.push_back(row);
-    }
-  } else {
-    try {
-      throw std::logic_error("File: datasets/areas.csv could not be opened.");
-    } catch (const std::logic_error &e) {
-      std::cerr << e.what();
-      std::cerr.flush();
-      abort();
-    }
-  }
+  @example
+    Areas allAreas;
+    BethYw::loadAreas(allAreas, dir, {});
 
-  // Create a list of area codes
-  std::vector<std::string> areaCodes;
-  for (unsigned int i = 1; i < content.size(); i++) {
-    areaCodes.push_back(content[i][0]);
-  }
+    MetadataIndex index;
+    index.addAreas(allAreas);
 
+    auto areasFilter = BethYw::parseAreasArg(args, index);
+*/
+std::unordered_set<std::string> BethYw::parseAreasArg(
+    cxxopts::ParseResult& args,
+    const MetadataIndex& index) {
+  std::unordered_set<std::string> areasToReturn;
 
-  // If the below tag is passed as a command-line argument...:
   if (args.count("areas")) {
     // Obtain the values passed with the tag
     auto inputAreas = args["areas"].as<std::vector<std::string>>();
     std::string firstVal = inputAreas[0];
     std::transform(firstVal.begin(), firstVal.end(), firstVal.begin(), [](unsigned char c) {return std::tolower(c);});
-    // If the first value is all then import all lists
+    // If the first value is all then import all areas in areas.csv
     if (firstVal == "all") {
-      for (unsigned int i = 0; i < areaCodes.size(); i++) {
-        areasToReturn.insert(areaCodes[i]);
-      }
-      return areasToReturn;
-    } else { // If not, parse through the parameters and check if they are a real area code
-      for (unsigned int i = 0; i < inputAreas.size(); i++) {
-        auto element = find(areaCodes.begin() ,areaCodes.end(), inputAreas[i]);
-        if (element != areaCodes.end()) { // If element exists...:
-          int index = element - areaCodes.begin();
-          areasToReturn.insert(areaCodes[index]);
-        } else { // Error
-          // throw std::logic_error("Area with name: " + inputAreas[i] + " not found");
-          throw std::invalid_argument("Invalid input for area argument");
-        }
-      }
+      return index.getAreaCodes();
     }
 
-
+    // If not, check each parameter is a real area code
+    for (const auto &area : inputAreas) {
+      if (!index.hasArea(area)) {
+        throw std::invalid_argument("Invalid input for area argument");
+      }
+      areasToReturn.insert(area);
+    }
   }
+
   return areasToReturn;
 }
 
+/*
+  Parses the areas command line argument, validating it against the areas
+  in the areas.csv file in the directory given by the dir argument.
+
+  @param args
+    Parsed program arguments
+
+  @return 
+    An std::unordered_set of std::strings corresponding to specific areas
+    to import, or an empty set if all areas should be imported.
+
+  @throws
+    std::invalid_argument if the argument contains an invalid areas value with
+    message: Invalid input for area argument
+    std::runtime_error if areas.csv cannot be read
+*/
+std::unordered_set<std::string> BethYw::parseAreasArg(
+    cxxopts::ParseResult& args) {
+  Areas allAreas;
+  loadAreas(allAreas, args["dir"].as<std::string>() + DIR_SEP, {});
+
+  MetadataIndex index;
+  index.addAreas(allAreas);
+  return parseAreasArg(args, index);
+}
+
 /*
   Parses the measures command line argument, which is optional. If it doesn't 
   exist or exists and contains "all" as value (any case), all measures should
-  be imported.
+  be imported, i.e., the filter should be an empty set.
 
-  The filtering of inputs should be case insensitive.
+  The filtering of inputs should be case insensitive. Only when specific
+  measures are given are they validated, against the measure codes of the
+  datasets in `dir`, which are added to the MetadataIndex (by scanning the
+  datasets) if it does not already have them.
 
   @param args
     Parsed program arguments
 
+  @param index
+    The MetadataIndex to find the valid measure codes in
+
+  @param dir
+    The directory where the datasets are
+
   @return 
     An std::unordered_set of std::strings corresponding to specific measures
     to import, or an empty set if all measures should be imported.
@@ -335,131 +681,105 @@ std::unordered_set<std::string> BethYw::parseAreasArg(
   @throws
     std::invalid_argument if the argument contains an invalid measures value
     with the message: Invalid input for measures argument
+
+  @example
+    MetadataIndex index;
+    auto measuresFilter = BethYw::parseMeasuresArg(args, index, "datasets/");
 */
 std::unordered_set<std::string> BethYw::parseMeasuresArg(
-  cxxopts::ParseResult& args) {
+    cxxopts::ParseResult& args,
+    MetadataIndex& index,
+    const std::string& dir) {
+  std::unordered_set<std::string> measuresToReturn;
 
-    // Construct variable to be returned at the head of this scope
-    std::unordered_set<std::string> measuresToReturn;
+  if (!args.count("measures")) {
+    return measuresToReturn;
+  }
 
-    // Construct variable that stores all measures
-    std::vector<std::string> allMeasures;
+  // Obtain the command-line arguments in lower case
+  auto inputMeasures = args["measures"].as<std::vector<std::string>>();
+  for (auto &measure : inputMeasures) {
+    std::transform(measure.begin(), measure.end(), measure.begin(), [](unsigned char c) {return std::tolower(c);});
+    if (measure == "all") {
+      return {};
+    }
+  }
 
-    // Obtain raw data of all measures importable
-    std::ifstream popu1009JSON("datasets/popu1009.json");
-    std::string popuRawData((std::istreambuf_iterator<char>(popu1009JSON)), std::istreambuf_iterator<char>());
-    popu1009JSON.close();
+  index.indexMeasures(dir);
+  return parseMeasuresArg(args, index);
+}
 
-    std::ifstream econ0080JSON("datasets/econ0080.json");
-    std::string econRawData((std::istreambuf_iterator<char>(econ0080JSON)), std::istreambuf_iterator<char>());
-    econ0080JSON.close();
+/*
+  Parses the measures command line argument as above, but validates it
+  against the measure codes already in the MetadataIndex, without scanning
+  any datasets (so the index can be shared between threads).
 
-    std::ifstream envi0201JSON("datasets/envi0201.json");
-    std::string enviRawData((std::istreambuf_iterator<char>(envi0201JSON)), std::istreambuf_iterator<char>());
-    envi0201JSON.close();
+  @param args
+    Parsed program arguments
 
-    std::ifstream tran0152JSON("datasets/tran0152.json");
-    std::string tranRawData((std::istreambuf_iterator<char>(tran0152JSON)), std::istreambuf_iterator<char>());
-    tran0152JSON.close();
+  @param index
+    The MetadataIndex, with the measures of every dataset already indexed
+    (see MetadataIndex::indexMeasures())
 
-    // Convert raw data strings to JSON objects
-    nlohmann::json popuJSON = nlohmann::json::parse(popuRawData);
-    nlohmann::json econJSON = nlohmann::json::parse(econRawData);
-    nlohmann::json enviJSON = nlohmann::json::parse(enviRawData);
-    nlohmann::json tranJSON = nlohmann::json::parse(tranRawData);
+  @return
+    An std::unordered_set of std::strings corresponding to specific measures
+    to import, or an empty set if all measures should be imported.
 
-    // Store unique measures into a list
+  @throws
+    std::invalid_argument if the argument contains an invalid measures value
+    with the message: Invalid input for measures argument
 
-    // popson unique measures
-    for (auto determinent : popuJSON["value"]) {
-      auto element = find(allMeasures.begin() ,allMeasures.end(), determinent["Measure_Code"]);
-        // If element isn't in list
-        if (element == allMeasures.end()) {
-          std::string measureCode = determinent["Measure_Code"];
-          allMeasures.push_back(measureCode);
-        }
-    }
+  @example
+    MetadataIndex index;
+    index.indexMeasures("datasets/");
+    auto measuresFilter = BethYw::parseMeasuresArg(args, index);
+*/
+std::unordered_set<std::string> BethYw::parseMeasuresArg(
+    cxxopts::ParseResult& args,
+    const MetadataIndex& index) {
+  std::unordered_set<std::string> measuresToReturn;
 
-    // econ unique measures
-    for (auto determinent : econJSON["value"]) {
-      auto element = find(allMeasures.begin() ,allMeasures.end(), determinent["Variable_Code"]);
-        // If element isn't in list
-        if (element == allMeasures.end()) {
-          std::string measureCode = determinent["Variable_Code"];
-          allMeasures.push_back(measureCode);
-        }
+  if (!args.count("measures")) {
+    return measuresToReturn;
+  }
+
+  auto inputMeasures = args["measures"].as<std::vector<std::string>>();
+  for (auto &measure : inputMeasures) {
+    std::transform(measure.begin(), measure.end(), measure.begin(), [](unsigned char c) {return std::tolower(c);});
+    if (measure == "all") {
+      return {};
     }
+  }
 
-    // envi unique measures
-    for (auto determinent : enviJSON["value"]) {
-      auto element = find(allMeasures.begin() ,allMeasures.end(), determinent["Pollutant_ItemName_ENG"]);
-        // If element isn't in list
-        if (element == allMeasures.end()) {
-          std::string measureCode = determinent["Pollutant_ItemName_ENG"];
-          allMeasures.push_back(measureCode);
-        }
+  for (const auto &measure : inputMeasures) {
+    if (!index.hasMeasure(measure)) {
+      throw std::invalid_argument("Invalid input for measures argument");
     }
+    measuresToReturn.insert(measure);
+  }
 
-    // Add hard coded unique measure for tran
-    std::string tranMeasureCode = "rail";
-    allMeasures.push_back(tranMeasureCode);
-
-    // Convert allMeasures vector to lower case
-    std::transform(allMeasures.begin(), allMeasures.end(), allMeasures.begin(),
-                   [](std::string s) {
-                       std::transform(s.begin(), s.end(), s.begin(),
-                                      [](unsigned char c) {
-                                          return std::tolower(c);
-                                      });
-                       return s;
-                   });
-
-    // Observe value passed this tag
-    if (args.count("measures")) {
-
-      // Obtain the command-line arguments pertaining to this tag
-      auto inputMeasures = args["measures"].as<std::vector<std::string>>();
-
-      // Convert command-line arguments to lower case
-      std::transform(inputMeasures.begin(), inputMeasures.end(), inputMeasures.begin(),
-                   [](std::string s) {
-                       std::transform(s.begin(), s.end(), s.begin(),
-                                      [](unsigned char c) {
-                                          return std::tolower(c);
-                                      });
-                       return s;
-                   });
-
-      // Iterate through each command-line argument
-      for (unsigned int i = 0; i < inputMeasures.size(); i++) {
-        if (inputMeasures[i] == "all") {
-          measuresToReturn.clear();
-          for (unsigned int i = 0; i < allMeasures.size(); i++) {
-            measuresToReturn.insert(allMeasures[i]);
-          }
-          return measuresToReturn;
-        } else {
-          auto element = find(allMeasures.begin() ,allMeasures.end(), inputMeasures[i]);
-          // If element exists
-          if (element != allMeasures.end()) {
-            int index = element - allMeasures.begin();
-            measuresToReturn.insert(allMeasures[index]);
-          } else { // If element does not exist
-            // throw std::invalid_argument("Invalid input for measures argument");
-            throw std::invalid_argument("Invalid input for measures argument");
-          }
-        }
-      }
+  return measuresToReturn;
+}
 
-    } else { // If not passed, return all measures
-      for (unsigned int i = 0; i < allMeasures.size(); i++) {
-        measuresToReturn.insert(allMeasures[i]);
-      }
-      return measuresToReturn;
-    }
+/*
+  Parses the measures command line argument, validating it against the
+  datasets in the directory given by the dir argument.
 
+  @param args
+    Parsed program arguments
 
-    return measuresToReturn;
+  @return 
+    An std::unordered_set of std::strings corresponding to specific measures
+    to import, or an empty set if all measures should be imported.
+
+  @throws
+    std::invalid_argument if the argument contains an invalid measures value
+    with the message: Invalid input for measures argument
+*/
+std::unordered_set<std::string> BethYw::parseMeasuresArg(
+  cxxopts::ParseResult& args) {
+  MetadataIndex index;
+  return parseMeasuresArg(args, index, args["dir"].as<std::string>() + DIR_SEP);
 }
 
 
@@ -484,106 +804,483 @@ std::unordered_set<std::string> BethYw::parseMeasuresArg(
     the message: Invalid input for years argument
 */
 std::tuple<unsigned int, unsigned int> BethYw::parseYearsArg(cxxopts::ParseResult& args) {
-  // Initialize the start and end years to 0
-  unsigned int startYear = 0;
-  unsigned int endYear = 0;
-
   // Check if the "years" argument is provided
   if (args.count("years")) {
-    std::string yearsInput = args["years"].as<std::string>();
-    std::regex yearPattern("(\\d{4})(?:-(\\d{4}))?");
-
-    std::smatch match;
-    if (std::regex_match(yearsInput, match, yearPattern)) {
-      startYear = std::stoi(match[1]);
-      if (match[2].length() > 0) {
-        endYear = std::stoi(match[2]);
-      } else {
-        endYear = startYear;
-      }
-    } else {
-      // throw std::invalid_argument("Invalid input for years argument");
-      try {
-        throw std::invalid_argument("Invalid input for years argument");
-      } catch (const std::invalid_argument &e) {
-        std::cerr << e.what();
-        std::cerr.flush();
-        abort();
-      }
+    try {
+      return parseYearsArg(args["years"].as<std::string>());
+    } catch (const std::invalid_argument &e) {
+      std::cerr << e.what();
+      std::cerr.flush();
+      abort();
     }
   }
 
-  return std::make_tuple(startYear, endYear);
+  return std::make_tuple(0, 0);
 }
 
 /*
-  Loads the areas.csv file from the directory `dir`.
-
-  @param areas
-    An Areas instance that should be modified (i.e. the populate() function
-    in the instance should be called)
-
-  @param dir
-    Directory where the areas.csv file is
+  Parses a years value, as given to the years argument: a four digit year
+  value, or two four digit year values separated by a hyphen.
 
-  @param areasFilter
-    An unordered set of areas to filter, or empty to import all areas
+  @param years
+    The years value (YYYY or YYYY-ZZZZ)
 
   @return
-    void
+    A std::tuple of the start and end year (inclusive)
 
-  @example
-    Areas areas();
+  @throws
+    std::invalid_argument if the value is invalid, with the message:
+    Invalid input for years argument
 
-    BethYw::loadAreas(areas, "data", BethYw::parseAreasArg(args));
+  @example
+    auto yearsFilter = BethYw::parseYearsArg("2010-2015");
 */
-void BethYw::loadAreas(
-    Areas &areas,
-    const std::string &dir,
-    const std::unordered_set<std::string> &areasFilter) {
+std::tuple<unsigned int, unsigned int> BethYw::parseYearsArg(const std::string& years) {
+  std::regex yearPattern("(\\d{4})(?:-(\\d{4}))?");
 
-  // Access the SourceColumnMapping instance from the InputFiles::AREAS.COLS
-  const SourceColumnMapping &cols = InputFiles::AREAS.COLS;
-
-  // Load the file and call the populateFromAuthorityCodeCSV function
-  InputFile inputFile("datasets/areas.csv");
-  std::istream &fileStream = inputFile.open();
-  
-  // Convert the unordered_set to a StringFilterSet (if required)
-  StringFilterSet areasFilterSet(areasFilter.begin(), areasFilter.end());
+  std::smatch match;
+  if (!std::regex_match(years, match, yearPattern)) {
+    throw std::invalid_argument("Invalid input for years argument");
+  }
 
-  areas.populateFromAuthorityCodeCSV(fileStream, cols, &areasFilterSet);
+  unsigned int startYear = std::stoi(match[1]);
+  unsigned int endYear = startYear;
+  if (match[2].length() > 0) {
+    endYear = std::stoi(match[2]);
+  }
+  return std::make_tuple(startYear, endYear);
 }
 
-
 /*
-  Imports datasets from `datasetsToImport` as files in `dir` into areas, and
-  filtering them with the `areasFilter`, `measuresFilter`, and `yearsFilter`.
+  Parses the shard argument, if it is given.
 
-  The actual filtering will be done by the Areas::populate() function, thus 
-  this function serves to merely pass pointers on to these flters.
+  @param args
+    Parsed program arguments
 
-  @param areas
-    An Areas instance that should be modified (i.e. datasets loaded into it)
+  @return
+    The Shard of the areas to import, or the default Shard (of every area)
+    if the argument is not given
 
-  @param dir
-    The directory where the datasets are
+  @throws
+    std::invalid_argument if the argument is invalid, with the message:
+    Invalid input for shard argument
 
-  @param datasetsToImport
-    A vector of InputFileSource objects
+  @example
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, argv);
 
-  @param areasFilter
-    An unordered set of areas (as authority codes encoded in std::strings)
-    to filter, or empty to import all areas
+    Shard shard = BethYw::parseShardArg(args);
+*/
+Shard BethYw::parseShardArg(cxxopts::ParseResult& args) {
+  if (!args.count("shard")) {
+    return Shard();
+  }
+  return parseShardArg(args["shard"].as<std::string>());
+}
 
-  @param measuresFilter
-    An unordered set of measures (as measure codes encoded in std::strings)
-    to filter, or empty to import all measures
+/*
+  Parses a shard value, as given to the shard argument: the number of the
+  shard and the number of shards, separated by a slash, where the shards
+  are numbered from 1.
+
+  @param shard
+    The shard value (i/N)
+
+  @return
+    The Shard
+
+  @throws
+    std::invalid_argument if the value is invalid, with the message:
+    Invalid input for shard argument
+
+  @example
+    Shard shard = BethYw::parseShardArg("2/4");
+*/
+Shard BethYw::parseShardArg(const std::string& shard) {
+  std::regex shardPattern("(\\d{1,9})/(\\d{1,9})");
+
+  std::smatch match;
+  if (!std::regex_match(shard, match, shardPattern)) {
+    throw std::invalid_argument("Invalid input for shard argument");
+  }
+
+  Shard parsed;
+  parsed.number = std::stoul(match[1]);
+  parsed.count = std::stoul(match[2]);
+  if (parsed.number == 0 || parsed.number > parsed.count) {
+    throw std::invalid_argument("Invalid input for shard argument");
+  }
+  return parsed;
+}
+
+/*
+  Parses the aggregate, group-by and range arguments into a Query.
+
+  The aggregate argument is the name of a reduction (see
+  Query::parseReduction()). The group-by argument is a comma-separated list
+  of "measure" and/or "year" (case-insensitive), or "none" to reduce every
+  value to one group. The range argument is two numbers separated by a
+  colon, either of which may be left out to leave that end of the range
+  open (e.g. "0:" for every value that is not negative).
+
+  @param args
+    Parsed program arguments
+
+  @return
+    A Query for the arguments
+
+  @throws
+    std::invalid_argument if the aggregate argument is not a reduction, with
+    the message: No reduction matches key: <input name>
+    std::invalid_argument if the group-by argument is invalid, with the
+    message: Invalid input for group-by argument
+    std::invalid_argument if the range argument is invalid, with the
+    message: Invalid input for range argument
+
+  @example
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, argv);
+
+    Query query = BethYw::parseQueryArgs(args);
+*/
+Query BethYw::parseQueryArgs(cxxopts::ParseResult& args) {
+  Query query;
+
+  if (args.count("aggregate")) {
+    query.setReduction(Query::parseReduction(args["aggregate"].as<std::string>()));
+  }
+
+  bool byMeasure = false;
+  bool byYear = false;
+  for (auto group : args["group-by"].as<std::vector<std::string>>()) {
+    std::transform(group.begin(), group.end(), group.begin(), [](unsigned char c) {return std::tolower(c);});
+    if (group == "measure") {
+      byMeasure = true;
+    } else if (group == "year") {
+      byYear = true;
+    } else if (group != "none") {
+      throw std::invalid_argument("Invalid input for group-by argument");
+    }
+  }
+  query.setGroupBy(byMeasure, byYear);
+
+  if (args.count("range")) {
+    const std::string range = args["range"].as<std::string>();
+    const std::size_t colon = range.find(':');
+    if (colon == std::string::npos) {
+      throw std::invalid_argument("Invalid input for range argument");
+    }
+
+    // An empty bound leaves that end of the range open
+    auto parseBound = [](const std::string &text, double open) {
+      if (text.empty()) {
+        return open;
+      }
+      std::size_t used = 0;
+      double bound = 0;
+      try {
+        bound = std::stod(text, &used);
+      } catch (const std::exception &e) {
+        throw std::invalid_argument("Invalid input for range argument");
+      }
+      if (used != text.size() || std::isnan(bound)) {
+        throw std::invalid_argument("Invalid input for range argument");
+      }
+      return bound;
+    };
+
+    const double min = parseBound(range.substr(0, colon),
+                                  -std::numeric_limits<double>::infinity());
+    const double max = parseBound(range.substr(colon + 1),
+                                  std::numeric_limits<double>::infinity());
+    if (min > max) {
+      throw std::invalid_argument("Invalid input for range argument");
+    }
+    query.setRange(min, max);
+  }
+
+  return query;
+}
+
+/*
+  Parses the profile argument, which is either "table" (the value when it is
+  given without one, i.e. --profile) or "json" (--profile=json). Profiling
+  (see profile.h) is turned on if the argument is given at all.
+
+  @param args
+    Parsed program arguments
+
+  @return
+    true if the profile should be printed as JSON, false for a table or if
+    there is no profile argument
+
+  @throws
+    std::invalid_argument if the argument is neither table nor json, with the
+    message: Invalid input for profile argument
+
+  @example
+    auto cxxopts = BethYw::cxxoptsSetup();
+    auto args = cxxopts.parse(argc, argv);
+
+    const bool profileJSON = BethYw::parseProfileArg(args);
+*/
+bool BethYw::parseProfileArg(cxxopts::ParseResult& args) {
+  if (!args.count("profile")) {
+    return false;
+  }
+
+  std::string format = args["profile"].as<std::string>();
+  std::transform(format.begin(), format.end(), format.begin(), [](unsigned char c) {return std::tolower(c);});
+  if (format != "table" && format != "json") {
+    throw std::invalid_argument("Invalid input for profile argument");
+  }
+
+  Profile::enable();
+  return format == "json";
+}
+
+// Whether datasets are read ahead on a thread, rather than memory mapped
+static std::atomic<bool> readAheadInput{false};
+
+/*
+  Sets how the datasets are read by loadAreas() and importDataset(): in
+  large blocks read ahead of the parser by a thread of their own (see
+  InputFile::READ_AHEAD), or (by default) by memory mapping them. Compressed
+  datasets are always decompressed on a thread of their own.
+
+  @param enabled
+    true to read the datasets ahead, false to memory map them
+
+  @example
+    BethYw::setReadAhead(args.count("read-ahead") > 0);
+*/
+void BethYw::setReadAhead(bool enabled) {
+  readAheadInput.store(enabled, std::memory_order_relaxed);
+}
+
+/*
+  Map a file, reporting its size as BYTES_READ and the time taken as the
+  "read" phase when profiling. The pages of a mapping are read as they are
+  first touched, so with a memory-mapped file much of the reading is
+  profiled as part of parsing it.
+*/
+static std::string_view readMapped(InputMappedFile &inputFile) {
+  Profile::Timer timer("read");
+  std::string_view contents = inputFile.open();
+  Profile::count(Profile::BYTES_READ, contents.size());
+  return contents;
+}
+
+/*
+  Loads the areas.csv file from the directory `dir`.
+
+  @param areas
+    An Areas instance that should be modified (i.e. the populate() function
+    in the instance should be called)
+
+  @param dir
+    Directory where the areas.csv file is
+
+  @param areasFilter
+    An unordered set of areas to filter, or empty to import all areas
+
+  @return
+    void
+
+  @example
+    Areas areas();
+
+    BethYw::loadAreas(areas, "data", BethYw::parseAreasArg(args));
+*/
+void BethYw::loadAreas(
+    Areas &areas,
+    const std::string &dir,
+    const std::unordered_set<std::string> &areasFilter) {
+
+  // Access the SourceColumnMapping instance from the InputFiles::AREAS.COLS
+  const SourceColumnMapping &cols = InputFiles::AREAS.COLS;
+
+  Profile::Dataset profiled(InputFiles::AREAS.CODE);
+  Profile::Timer timer("loadAreas");
+
+  // Convert the unordered_set to a StringFilterSet (if required)
+  StringFilterSet areasFilterSet(areasFilter.begin(), areasFilter.end());
+
+  // A compressed file is parsed as it is decompressed
+  const std::string path = findInputFile(dir + InputFiles::AREAS.FILE);
+  if (detectCompression(path) != Compression::NONE) {
+    InputCompressedFile inputFile(path);
+    areas.populateFromAuthorityCodeCSV(inputFile.open(), cols, &areasFilterSet);
+    Profile::count(Profile::BYTES_READ, inputFile.bytesRead());
+    return;
+  }
+
+  if (readAheadInput.load(std::memory_order_relaxed)) {
+    InputFile inputFile(path, InputFile::READ_AHEAD);
+    areas.populateFromAuthorityCodeCSV(inputFile.open(), cols, &areasFilterSet);
+    Profile::count(Profile::BYTES_READ, inputFile.bytesRead());
+    return;
+  }
+
+  // Map the file and call the populateFromAuthorityCodeCSV function
+  InputMappedFile inputFile(path);
+  std::string_view contents = readMapped(inputFile);
+
+  areas.populateFromAuthorityCodeCSV(contents, cols, &areasFilterSet);
+}
+
+
+/*
+  Imports a single dataset, given as an InputFileSource, from its file in
+  `dir` into areas, filtering it with the `areasFilter`, `measuresFilter`,
+  and `yearsFilter`.
+
+  @param areas
+    An Areas instance that should be modified (i.e. the dataset loaded into
+    it)
+
+  @param dir
+    The directory where the datasets are
+
+  @param dataset
+    The InputFileSource of the dataset to import
+
+  @param areasFilter
+    A set of areas to filter, or empty to import all areas
+
+  @param measuresFilter
+    A set of measures to filter, or empty to import all measures
+
+  @param yearsFilter
+    An two-pair tuple of unsigned ints corresponding to the range of years 
+    to import, which should both be 0 to import all years.
+
+  @return
+    void
+
+  @throws
+    std::runtime_error if the file cannot be opened, or any exception thrown
+    by Areas::populate()
+
+  @example
+    Areas areas();
+
+    BethYw::importDataset(
+      areas,
+      "datasets/",
+      InputFiles::POPDEN,
+      areasFilter,
+      measuresFilter,
+      yearsFilter);
+*/
+void BethYw::importDataset(
+    Areas &areas,
+    const std::string &dir,
+    const BethYw::InputFileSource &dataset,
+    const StringFilterSet &areasFilter,
+    const StringFilterSet &measuresFilter,
+    const YearFilterTuple &yearsFilter) {
+  importDataset(areas, dir, dataset,
+                Filter(&areasFilter, &measuresFilter, &yearsFilter));
+}
+
+/*
+  As above, but filtering the dataset with a compiled Filter.
+
+  @param areas
+    An Areas instance that should be modified (i.e. the dataset loaded into
+    it)
+
+  @param dir
+    The directory where the datasets are
+
+  @param dataset
+    The InputFileSource of the dataset to import
+
+  @param filter
+    The areas, measures and years to import
+
+  @throws
+    std::runtime_error if the file cannot be opened, or any exception thrown
+    by Areas::populate()
+
+  @example
+    Filter filter(&areasFilter, &measuresFilter, &yearsFilter);
+
+    Areas areas();
+    BethYw::importDataset(areas, "datasets/", InputFiles::POPDEN, filter);
+*/
+void BethYw::importDataset(
+    Areas &areas,
+    const std::string &dir,
+    const BethYw::InputFileSource &dataset,
+    const Filter &filter) {
+  Profile::Dataset profiled(dataset.CODE);
+
+  // A compressed file is parsed as it is decompressed
+  const std::string path = findInputFile(dir + dataset.FILE);
+  if (detectCompression(path) != Compression::NONE) {
+    InputCompressedFile inputFile(path);
+    areas.populate(inputFile.open(), dataset.PARSER, dataset.COLS, filter);
+    Profile::count(Profile::BYTES_READ, inputFile.bytesRead());
+    return;
+  }
+
+  if (readAheadInput.load(std::memory_order_relaxed)) {
+    InputFile inputFile(path, InputFile::READ_AHEAD);
+    areas.populate(inputFile.open(), dataset.PARSER, dataset.COLS, filter);
+    Profile::count(Profile::BYTES_READ, inputFile.bytesRead());
+    return;
+  }
+
+  InputMappedFile inputFile(path);
+  std::string_view contents = readMapped(inputFile);
+
+  areas.populate(
+    contents,
+    dataset.PARSER,
+    dataset.COLS,
+    filter);
+}
+
+
+/*
+  Imports datasets from `datasetsToImport` as files in `dir` into areas, and
+  filtering them with the `areasFilter`, `measuresFilter`, and `yearsFilter`.
+
+  The actual filtering will be done by the Areas::populate() function, thus 
+  this function serves to merely pass pointers on to these flters.
+
+  If more than one thread is requested, the datasets are imported in
+  parallel, each into its own Areas instance, and then merged into `areas`
+  in the order they appear in `datasetsToImport` using Areas::merge(). The
+  result is the same as importing them one after another.
+
+  @param areas
+    An Areas instance that should be modified (i.e. datasets loaded into it)
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @param areasFilter
+    An unordered set of areas (as authority codes encoded in std::strings)
+    to filter, or empty to import all areas
+
+  @param measuresFilter
+    An unordered set of measures (as measure codes encoded in std::strings)
+    to filter, or empty to import all measures
 
   @param yearsFilter
     An two-pair tuple of unsigned ints corresponding to the range of years 
     to import, which should both be 0 to import all years.
 
+  @param threads
+    The maximum number of datasets to import at the same time, or 0 for one
+    per hardware thread
+
   @return
     void
 
@@ -604,26 +1301,51 @@ void BethYw::loadDatasets(
     const std::vector<BethYw::InputFileSource> &datasetsToImport,
     const std::unordered_set<std::string> &areasFilter,
     const std::unordered_set<std::string> &measuresFilter,
-    const std::tuple<unsigned int, unsigned int> &yearsFilter) {
+    const std::tuple<unsigned int, unsigned int> &yearsFilter,
+    unsigned int threads) {
+  loadDatasets(areas, dir, datasetsToImport,
+               Filter(&areasFilter, &measuresFilter, &yearsFilter), threads);
+}
 
-  StringFilterSet areasFilterSet(areasFilter.begin(), areasFilter.end());
-  StringFilterSet measuresFilterSet(measuresFilter.begin(), measuresFilter.end());
+/*
+  As above, but filtering the datasets with a compiled Filter, which is
+  shared by every dataset (and thread) rather than built for each one.
 
-  for (const auto &dataset : datasetsToImport) {
-    std::string inputFilePath = dir + dataset.FILE;
-    InputFile inputFile(inputFilePath);
+  @param areas
+    An Areas instance that should be modified (i.e. datasets loaded into it)
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @param filter
+    The areas, measures and years to import
+
+  @param threads
+    The maximum number of datasets to import at the same time, or 0 for one
+    per hardware thread
+
+  @example
+    Filter filter(&areasFilter, &measuresFilter, &yearsFilter);
+
+    Areas areas();
+    BethYw::loadDatasets(areas, "datasets/",
+                         BethYw::parseDatasetsArg(args), filter);
+*/
+void BethYw::loadDatasets(
+    Areas &areas,
+    const std::string &dir,
+    const std::vector<BethYw::InputFileSource> &datasetsToImport,
+    const Filter &filter,
+    unsigned int threads) {
+  Profile::Timer timer("loadDatasets");
+
+  // Import a dataset into `target`, reporting any error to std::cerr
+  auto importAndReport = [&](Areas &target, const InputFileSource &dataset) {
     try {
-      std::istream &fileStream = inputFile.open();
-      const SourceColumnMapping &cols = dataset.COLS;
-      const SourceDataType &type = dataset.PARSER;
-
-      areas.populate(
-        fileStream,
-        type,
-        cols,
-        &areasFilterSet,
-        &measuresFilterSet,
-        &yearsFilter);
+      importDataset(target, dir, dataset, filter);
     } catch (const std::out_of_range &e) {
       std::cerr << "Key not found in map: " << std::endl;
       std::cerr << e.what() << std::endl;
@@ -631,5 +1353,385 @@ void BethYw::loadDatasets(
       std::cerr << "Error importing dataset: " << std::endl;
       std::cerr << e.what() << std::endl;
     }
+  };
+
+  threads = resolveThreads(threads);
+  if (threads == 1 || datasetsToImport.size() <= 1) {
+    // A single dataset can still use every thread for a large file
+    areas.setThreads(threads);
+    for (const auto &dataset : datasetsToImport) {
+      importAndReport(areas, dataset);
+    }
+    return;
+  }
+
+  // Import every dataset into its own copy of the Areas loaded so far (i.e.
+  // from areas.csv), so that each import sees the same Area objects it would
+  // in a sequential import
+  std::vector<Areas> results(datasetsToImport.size(), areas);
+  std::vector<char> failed(datasetsToImport.size(), false);
+  for (auto &result : results) {
+    result.setThreads(threads / datasetsToImport.size());
+  }
+
+  parallelFor(datasetsToImport.size(), threads, [&](std::size_t i) {
+    try {
+      importDataset(results[i], dir, datasetsToImport[i], filter);
+    } catch (const std::exception &) {
+      failed[i] = true;
+    }
+  });
+
+  // Merge in the order the datasets were given, so that the result (and any
+  // error output) is identical to a sequential import. A dataset that failed
+  // (e.g. a partial import before a malformed row, or a row for an area that
+  // only an earlier dataset creates) is instead imported again directly into
+  // the merged result, exactly as the sequential import would have done.
+  for (std::size_t i = 0; i < datasetsToImport.size(); i++) {
+    if (failed[i]) {
+      importAndReport(areas, datasetsToImport[i]);
+    } else {
+      Profile::Dataset profiled(datasetsToImport[i].CODE);
+      Profile::Timer mergeTimer("merge");
+      areas.merge(std::move(results[i]));
+    }
+  }
+}
+
+/*
+  Plan which of the datasets to import are needed for a query: those that
+  the metadata index says may hold any of the measures asked for (see
+  MetadataIndex::mayContain()). The others cannot add anything to the
+  output, so their files need not be opened at all, e.g. only popu1009 is
+  read for --measures pop,dens.
+
+  @param datasetsToImport
+    The datasets selected by the datasets argument
+
+  @param measuresFilter
+    The measures to import, or an empty set for every measure
+
+  @param index
+    The metadata index, with the measures of the datasets indexed if
+    measuresFilter is not empty (as parseMeasuresArg() does)
+
+  @return
+    The datasets in datasetsToImport that are needed, in the same order
+
+  @example
+    auto measuresFilter = BethYw::parseMeasuresArg(args, index, dir);
+    auto needed = BethYw::planDatasets(BethYw::parseDatasetsArg(args),
+                                       measuresFilter, index);
+*/
+std::vector<BethYw::InputFileSource> BethYw::planDatasets(
+    const std::vector<BethYw::InputFileSource> &datasetsToImport,
+    const std::unordered_set<std::string> &measuresFilter,
+    const MetadataIndex &index) {
+  std::vector<InputFileSource> needed;
+  for (const auto &dataset : datasetsToImport) {
+    if (index.mayContain(dataset.CODE, measuresFilter)) {
+      needed.push_back(dataset);
+    }
+  }
+  return needed;
+}
+/*
+  The line that ends the query of a shard's snapshot (see cacheQuery()),
+  before the shard argument
+*/
+static const std::string SHARD_QUERY_KEY = "shard=";
+
+/*
+  Builds a string identifying a query, i.e. the data directory, the
+  datasets, and the areas, measures, years and (if given) shard arguments
+  exactly as they were given. A snapshot saved for one query can only be
+  used for the same query.
+
+  @param args
+    Parsed program arguments
+
+  @return
+    A string that is equal for equal queries
+
+  @example
+    auto query = BethYw::cacheQuery(args);
+*/
+std::string BethYw::cacheQuery(cxxopts::ParseResult& args) {
+  std::string query = "dir=" + args["dir"].as<std::string>();
+
+  for (const std::string arg : {"datasets", "areas", "measures"}) {
+    query += "\n" + arg + "=";
+    if (args.count(arg)) {
+      for (const auto &value : args[arg].as<std::vector<std::string>>()) {
+        query += value + ",";
+      }
+    }
+  }
+
+  query += "\nyears=" + args["years"].as<std::string>();
+
+  // Only a sharded query says so, which the merge subcommand relies on
+  if (args.count("shard")) {
+    query += "\n" + SHARD_QUERY_KEY + args["shard"].as<std::string>();
+  }
+  return query;
+}
+
+/*
+  Takes the fingerprint of every file a query imports: the areas.csv file
+  and the file of each dataset.
+
+  @param dir
+    The directory where the datasets are
+
+  @param datasetsToImport
+    A vector of InputFileSource objects
+
+  @return
+    A fingerprint of each file
+
+  @throws
+    std::runtime_error if a file cannot be read
+*/
+std::vector<SourceFingerprint> BethYw::cacheSources(
+    const std::string &dir,
+    const std::vector<BethYw::InputFileSource> &datasetsToImport) {
+  std::vector<SourceFingerprint> sources;
+  sources.push_back(SourceFingerprint::of(findInputFile(dir + InputFiles::AREAS.FILE)));
+  for (const auto &dataset : datasetsToImport) {
+    sources.push_back(SourceFingerprint::of(findInputFile(dir + dataset.FILE)));
+  }
+  return sources;
+}
+
+/*
+  Loads a snapshot into areas, if the snapshot was saved for this query and
+  none of its source files have changed since. An invalid snapshot file is
+  reported to std::cerr and otherwise ignored.
+
+  The measure codes in the snapshot's MetadataIndex whose datasets are still
+  unchanged are added to `index` whether or not the snapshot is used.
+
+  @param areas
+    An Areas instance to load the snapshot into
+
+  @param index
+    A MetadataIndex to add the snapshot's measure codes to
+
+  @param path
+    The path of the snapshot file
+
+  @param query
+    The query, from BethYw::cacheQuery()
+
+  @return
+    true if the snapshot was loaded, false if the datasets need importing
+
+  @example
+    Areas areas();
+    MetadataIndex index;
+    if (!BethYw::loadCache(areas, index, "bethyw.cache",
+                           BethYw::cacheQuery(args))) {
+      ...
+    }
+*/
+bool BethYw::loadCache(Areas &areas,
+                       MetadataIndex &index,
+                       const std::string &path,
+                       const std::string &query) {
+  Profile::Timer timer("loadCache");
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
   }
+
+  try {
+    Snapshot snapshot = Snapshot::read(file);
+    for (const auto &datasetPair : snapshot.index.getDatasetMeasures()) {
+      if (datasetPair.second.source.matchesFile()) {
+        index.addMeasures(datasetPair.first, datasetPair.second);
+      }
+    }
+
+    if (snapshot.query != query || !snapshot.isFresh()) {
+      return false;
+    }
+    areas = std::move(snapshot.areas);
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "Ignoring cache " << path << ": " << e.what() << std::endl;
+    return false;
+  }
+}
+
+/*
+  Saves areas as a snapshot for this query. An error saving the snapshot is
+  reported to std::cerr, but is not fatal.
+
+  @param areas
+    The Areas instance to save
+
+  @param index
+    The MetadataIndex used to validate the query, whose measure codes are
+    saved too
+
+  @param path
+    The path of the snapshot file
+
+  @param query
+    The query, from BethYw::cacheQuery()
+
+  @param sources
+    The fingerprints of the files imported, from BethYw::cacheSources()
+
+  @example
+    BethYw::saveCache(areas, index, "bethyw.cache", query, sources);
+*/
+void BethYw::saveCache(Areas &areas,
+                       const MetadataIndex &index,
+                       const std::string &path,
+                       const std::string &query,
+                       const std::vector<SourceFingerprint> &sources) {
+  Profile::Timer timer("saveCache");
+
+  // Move the data into the snapshot (and back) rather than copying it
+  Snapshot snapshot;
+  snapshot.query = query;
+  snapshot.sources = sources;
+  snapshot.areas = std::move(areas);
+  snapshot.index = index;
+
+  try {
+    snapshot.save(path);
+  } catch (const std::exception &e) {
+    std::cerr << "Error saving cache: " << std::endl;
+    std::cerr << e.what() << std::endl;
+  }
+
+  areas = std::move(snapshot.areas);
+}
+
+/*
+  Split the query of a shard's snapshot into the query it is a shard of
+  (i.e. the query without the shard argument) and its Shard.
+*/
+static Shard splitShardQuery(const std::string &query, std::string &unsharded) {
+  const std::size_t line = query.rfind("\n" + SHARD_QUERY_KEY);
+  if (line == std::string::npos) {
+    throw std::invalid_argument("The snapshot is not of a shard (see --shard)");
+  }
+
+  unsharded = query.substr(0, line);
+  return BethYw::parseShardArg(query.substr(line + 1 + SHARD_QUERY_KEY.size()));
+}
+
+/*
+  Run the merge subcommand, which combines the snapshots saved by each
+  shard of a query (with --shard and --save-cache) into the data of the
+  whole query, as if it had been imported in one run. The snapshots are
+  given as positional arguments, along with any of the output arguments of
+  a run (e.g. --json, --stats-only, --aggregate or --output), and
+  --save-cache to save the merged data as a snapshot of the query without
+  --shard (which a run of it can then load with --load-cache).
+
+  The areas of the shards are combined with Areas::merge() (and so
+  Measure::combine()), in the order the snapshots are given. Every shard
+  of the query must be given, once.
+
+  @param argc
+    Number of arguments, after "merge"
+
+  @param argv
+    Arguments, starting with "merge"
+
+  @return
+    Exit code: 0, or 1 if the snapshots could not be merged or the output
+    could not be written
+
+  @example
+    bethyw --shard 1/2 --save-cache shard1.snap
+    bethyw --shard 2/2 --save-cache shard2.snap
+    bethyw merge shard1.snap shard2.snap --json
+*/
+int BethYw::mergeShards(int argc, char *argv[]) {
+  auto cxxopts = BethYw::cxxoptsSetup();
+  cxxopts.add_options()(
+      "snapshots",
+      "The snapshots of the shards to merge",
+      cxxopts::value<std::vector<std::string>>());
+  cxxopts.parse_positional({"snapshots"});
+  cxxopts.positional_help("SNAPSHOT...");
+  auto args = cxxopts.parse(argc, argv);
+
+  if (args.count("help")) {
+    std::cerr << cxxopts.help() << std::endl;
+    return 0;
+  }
+
+  const bool profileJSON = BethYw::parseProfileArg(args);
+  Profile::Timer total("merge");
+
+  Snapshot merged;
+  try {
+    if (!args.count("snapshots")) {
+      throw std::invalid_argument("No snapshots to merge");
+    }
+    const auto paths = args["snapshots"].as<std::vector<std::string>>();
+
+    std::vector<bool> seen;
+    for (std::size_t i = 0; i < paths.size(); i++) {
+      Snapshot snapshot = Snapshot::load(paths[i]);
+      std::string query;
+      const Shard shard = splitShardQuery(snapshot.query, query);
+      const std::string shardName =
+          std::to_string(shard.number) + "/" + std::to_string(shard.count);
+
+      if (i == 0) {
+        merged.query = query;
+        merged.index = snapshot.index;
+        seen.assign(shard.count, false);
+      } else if (query != merged.query || shard.count != seen.size()) {
+        throw std::invalid_argument(paths[i] + " (shard " + shardName +
+                                    ") is a shard of a different query to " +
+                                    paths[0]);
+      }
+      if (seen[shard.number - 1]) {
+        throw std::invalid_argument("Shard " + shardName + " is given twice");
+      }
+      seen[shard.number - 1] = true;
+
+      for (const auto &source : snapshot.sources) {
+        const bool known = std::any_of(
+            merged.sources.begin(), merged.sources.end(),
+            [&](const SourceFingerprint &other) { return other.path == source.path; });
+        if (!known) {
+          merged.sources.push_back(source);
+        }
+      }
+
+      Profile::Timer mergeTimer("mergeShard");
+      merged.areas.merge(std::move(snapshot.areas));
+    }
+
+    for (std::size_t i = 0; i < seen.size(); i++) {
+      if (!seen[i]) {
+        throw std::invalid_argument("Shard " + std::to_string(i + 1) + "/" +
+                                    std::to_string(seen.size()) + " is missing");
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error merging shards: " << std::endl;
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  if (args.count("save-cache")) {
+    BethYw::saveCache(merged.areas, merged.index,
+                      args["save-cache"].as<std::string>(),
+                      merged.query, merged.sources);
+  }
+
+  const int status = BethYw::writeOutput(merged.areas, args);
+  reportProfile(total, profileJSON);
+  return status;
 }
@@ -12,6 +12,7 @@
   running Beth Yw?
  */
 
+#include <ostream>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -20,6 +21,10 @@
 
 #include "areas.h"
 #include "datasets.h"
+#include "filter.h"
+#include "metadata.h"
+#include "query.h"
+#include "snapshot.h"
 
 const char DIR_SEP =
 #ifdef _WIN32
@@ -37,6 +42,11 @@ const std::string STUDENT_NUMBER = "2009594";
 */
 int run(int argc, char *argv[]);
 
+/*
+  Run the merge subcommand, combining the snapshots of a query's shards.
+*/
+int mergeShards(int argc, char *argv[]);
+
 /*
   Create a cxxopts instance.
 */
@@ -54,30 +64,137 @@ std::vector<BethYw::InputFileSource> parseDatasetsArg(
   areas to import, or an empty set if all areas should be imported.
 */
 std::unordered_set<std::string> parseAreasArg(cxxopts::ParseResult& args);
+std::unordered_set<std::string> parseAreasArg(cxxopts::ParseResult& args,
+                                              const MetadataIndex& index);
 
 /*
   Parses the measures argument and return an std::unordered_set of all the
   measures to import, or an empty set if all measures should be imported.
 */
 std::unordered_set<std::string> parseMeasuresArg(cxxopts::ParseResult& args);
+std::unordered_set<std::string> parseMeasuresArg(cxxopts::ParseResult& args,
+                                                 MetadataIndex& index,
+                                                 const std::string& dir);
+std::unordered_set<std::string> parseMeasuresArg(cxxopts::ParseResult& args,
+                                                 const MetadataIndex& index);
 
 /*
   Parses the years argument and return an std::unordered_set of all of the
   years to import, or an empty set if all years should be imported.
 */
 std::tuple<unsigned int, unsigned int> parseYearsArg(cxxopts::ParseResult& args);
+std::tuple<unsigned int, unsigned int> parseYearsArg(const std::string& years);
+
+/*
+  Parses the shard argument and returns the Shard of the areas to import, or
+  the default Shard (of every area) if it is not given.
+*/
+Shard parseShardArg(cxxopts::ParseResult& args);
+Shard parseShardArg(const std::string& shard);
+
+/*
+  Parses the aggregate, group-by and range arguments into a Query.
+*/
+Query parseQueryArgs(cxxopts::ParseResult& args);
+
+/*
+  Parses the profile argument, turning profiling on if it is given, and
+  returns whether the profile should be printed as JSON.
+*/
+bool parseProfileArg(cxxopts::ParseResult& args);
+
+/*
+  Imports the datasets and answers queries for them over HTTP.
+*/
+int serve(cxxopts::ParseResult& args,
+          const std::string& dir,
+          const std::vector<BethYw::InputFileSource>& datasetsToImport,
+          const Filter& filter,
+          Areas base,
+          MetadataIndex index);
+
+/*
+  Writes the imported data in the form the output arguments ask for.
+*/
+void writeOutput(std::ostream& os, const Areas& data, cxxopts::ParseResult& args);
+int writeOutput(const Areas& data, cxxopts::ParseResult& args);
+
+/*
+  Sets whether datasets are read ahead on a thread, rather than memory mapped.
+*/
+void setReadAhead(bool enabled);
 
 void loadAreas(
     Areas &areas,
     const std::string &dir,
     const std::unordered_set<std::string> &areasFilter);
 
+/*
+  Imports a single dataset into an Areas instance, throwing on any error.
+*/
+void importDataset(Areas &areas,
+                   const std::string &dir,
+                   const BethYw::InputFileSource &dataset,
+                   const StringFilterSet &areasFilter,
+                   const StringFilterSet &measuresFilter,
+                   const YearFilterTuple &yearsFilter);
+void importDataset(Areas &areas,
+                   const std::string &dir,
+                   const BethYw::InputFileSource &dataset,
+                   const Filter &filter);
+
+/*
+  Imports each dataset in datasetsToImport, optionally on several threads.
+*/
 void loadDatasets(Areas &areas,
                           const std::string &dir,
                           const std::vector<BethYw::InputFileSource> &datasetsToImport,
                           const std::unordered_set<std::string> &areasFilter,
                           const std::unordered_set<std::string> &measuresFilter,
-                          const std::tuple<unsigned int, unsigned int> &yearsFilter);
+                          const std::tuple<unsigned int, unsigned int> &yearsFilter,
+                          unsigned int threads = 1);
+void loadDatasets(Areas &areas,
+                  const std::string &dir,
+                  const std::vector<BethYw::InputFileSource> &datasetsToImport,
+                  const Filter &filter,
+                  unsigned int threads = 1);
+
+/*
+  Selects the datasets to import that may hold any of the measures asked for.
+*/
+std::vector<BethYw::InputFileSource> planDatasets(
+    const std::vector<BethYw::InputFileSource> &datasetsToImport,
+    const std::unordered_set<std::string> &measuresFilter,
+    const MetadataIndex &index);
+
+/*
+  Builds the string identifying a query, for matching it with a snapshot.
+*/
+std::string cacheQuery(cxxopts::ParseResult& args);
+
+/*
+  Takes the fingerprints of the files a query imports.
+*/
+std::vector<SourceFingerprint> cacheSources(
+    const std::string &dir,
+    const std::vector<BethYw::InputFileSource> &datasetsToImport);
+
+/*
+  Loads a snapshot, if it is still valid for the query.
+*/
+bool loadCache(Areas &areas,
+               MetadataIndex &index,
+               const std::string &path,
+               const std::string &query);
+
+/*
+  Saves a snapshot of the imported data for the query.
+*/
+void saveCache(Areas &areas,
+               const MetadataIndex &index,
+               const std::string &path,
+               const std::string &query,
+               const std::vector<SourceFingerprint> &sources);
 
 } // namespace BethYw
 
@@ -2,14 +2,23 @@
 
 SET bin_dir=bin
 SET tests_dir=tests
-SET source_files=bethyw.cpp input.cpp areas.cpp area.cpp measure.cpp
+SET source_files=bethyw.cpp input.cpp csv.cpp output.cpp columnar.cpp profile.cpp query.cpp live.cpp server.cpp kernels.cpp symbol.cpp filter.cpp parallel.cpp snapshot.cpp metadata.cpp areas.cpp area.cpp measure.cpp
 SET main_file=main.cpp
 SET executable=%bin_dir%\bethyw.exe
+SET flags=
 
 COPY bin\bethyw2.exe bin\bethyw.exe
 
 IF "%1"=="" GOTO compile
 
+IF "%1"=="bench" (
+  SET source_files=%source_files% synthetic.cpp
+  SET main_file=bench.cpp
+  SET executable=%bin_dir%\bethyw-bench.exe
+  SET flags=-O2
+  GOTO compile
+)
+
 SET testStr=%1%
 SET testStr=%testStr:~0,4%
 IF %testStr%==test (
@@ -23,8 +32,11 @@ IF %testStr%==test (
 )
 
 :compile
+REM Compressed datasets need zlib (gzip) and/or libzstd (zstd): add
+REM -DBETHYW_ZLIB to flags and -lz to libs, and/or -DBETHYW_ZSTD and -lzstd
+SET libs=
 IF NOT EXIST %bin_dir% MKDIR %bin_dir%
 IF EXIST %executable% DEL %executable%
-g++ --std=c++14 -Wall %source_files% %main_file% -o %executable%
+g++ --std=c++17 -Wall -pthread %flags% %source_files% %main_file% -o %executable% %libs%
 
 :end
@@ -2,15 +2,16 @@
 
 BIN_DIR="bin"
 TESTS_DIR="tests"
-SOURCE_FILES="bethyw.cpp input.cpp areas.cpp area.cpp measure.cpp"
+SOURCE_FILES="bethyw.cpp input.cpp csv.cpp output.cpp columnar.cpp profile.cpp query.cpp live.cpp server.cpp kernels.cpp symbol.cpp filter.cpp parallel.cpp snapshot.cpp metadata.cpp areas.cpp area.cpp measure.cpp"
 MAIN_FILE="main.cpp"
 EXECUTABLE="./${BIN_DIR}/bethyw"
+FLAGS=""
 
 set -x
 cd "${0%/*}"
 
 if [ $# -gt 1 ]; then
-  echo "Unknown arguments!" "Only one argument accepted, and must begin with test"
+  echo "Unknown arguments!" "Only one argument accepted, and must be bench or begin with test"
   exit
 elif [ $# -eq 1 ]; then
   if [[ $1 == test* ]]; then
@@ -18,13 +19,34 @@ elif [ $# -eq 1 ]; then
     MAIN_FILE="./${BIN_DIR}/catch.o"
     EXECUTABLE="./${BIN_DIR}/bethyw-test"
 
-    # Do we need to compile Catch2?
+    # Do we need to compile Catch2? Its POSIX signal handler does not
+    # compile against glibc 2.34 and later, where MINSIGSTKSZ is no longer
+    # a constant, so it is left out
     if [ ! -f ./${BIN_DIR}/catch.o ]; then
-      g++ --std=c++11 -c ./lib_catch_main.cpp -o ./${BIN_DIR}/catch.o
+      mkdir -p ${BIN_DIR}
+      g++ --std=c++11 -DCATCH_CONFIG_NO_POSIX_SIGNALS -c ./lib_catch_main.cpp -o ./${BIN_DIR}/catch.o
     fi
+  elif [[ $1 == bench ]]; then
+    # Benchmarks are only meaningful with optimisations on
+    SOURCE_FILES="${SOURCE_FILES} synthetic.cpp"
+    MAIN_FILE="bench.cpp"
+    EXECUTABLE="./${BIN_DIR}/bethyw-bench"
+    FLAGS="-O2"
   fi
 fi
 
+# Compressed datasets can be read wherever zlib (gzip) and libzstd (zstd)
+# are installed
+LIBS=""
+if echo "#include <zlib.h>" | g++ -E -x c++ - > /dev/null 2>&1; then
+  FLAGS="${FLAGS} -DBETHYW_ZLIB"
+  LIBS="${LIBS} -lz"
+fi
+if echo "#include <zstd.h>" | g++ -E -x c++ - > /dev/null 2>&1; then
+  FLAGS="${FLAGS} -DBETHYW_ZSTD"
+  LIBS="${LIBS} -lzstd"
+fi
+
 mkdir -p ${BIN_DIR}
 rm ${EXECUTABLE} 2> /dev/null
-g++ --std=c++14 -pedantic -Wall ${SOURCE_FILES} ${MAIN_FILE} -o ${EXECUTABLE}
\ No newline at end of file
+g++ --std=c++17 -pedantic -Wall -pthread ${FLAGS} ${SOURCE_FILES} ${MAIN_FILE} -o ${EXECUTABLE} ${LIBS}
\ No newline at end of file
@@ -0,0 +1,647 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the ColumnarFile class, which
+  writes the Arrow IPC file format (see
+  https://arrow.apache.org/docs/format/Columnar.html). A file is laid out
+  as follows, with all integers little-endian and every message padded to
+  a multiple of 8 bytes:
+
+    "ARROW1\0\0"                 magic
+    message                      the schema
+    5 * message                  a dictionary batch for each string column
+    n * message                  record batches of up to BATCH_ROWS rows
+    0xFFFFFFFF, 0x00000000       end of stream
+    footer                       the schema again, and the offset and size
+                                 of every dictionary and record batch
+    i32                          size of the footer
+    "ARROW1"                     magic
+
+  where each message is 0xFFFFFFFF, the i32 size of its metadata, the
+  metadata (a Message flatbuffer), then its body (the buffers of its
+  columns). The flatbuffers are built by a small builder of their own,
+  which supports just the tables, vectors and strings the metadata needs.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "columnar.h"
+#include "output.h"
+#include "profile.h"
+
+static const Symbol LANG_ENG("eng");
+static const Symbol LANG_CYM("cym");
+
+/*
+  The values of the Arrow flatbuffer enums and unions used in the metadata
+  (from Schema.fbs, Message.fbs and File.fbs in the Arrow format).
+*/
+static const std::int16_t METADATA_V5 = 4;
+static const std::uint8_t TYPE_INT = 2;
+static const std::uint8_t TYPE_FLOATING_POINT = 3;
+static const std::uint8_t TYPE_UTF8 = 5;
+static const std::int16_t PRECISION_DOUBLE = 2;
+static const std::uint8_t HEADER_SCHEMA = 1;
+static const std::uint8_t HEADER_DICTIONARY_BATCH = 2;
+static const std::uint8_t HEADER_RECORD_BATCH = 3;
+
+/*
+  One column of the file
+*/
+struct ColumnSpec {
+  const char* name;
+  std::uint8_t type;
+  bool dictionary;
+  bool nullable;
+};
+
+// The string columns come first, so a column's index is its dictionary id
+static const std::size_t NUM_DICTIONARIES = 5;
+static const std::size_t NUM_COLUMNS = 7;
+static const ColumnSpec COLUMNS[NUM_COLUMNS] = {
+  {"area_code", TYPE_UTF8, true, false},
+  {"name_eng", TYPE_UTF8, true, true},
+  {"name_cym", TYPE_UTF8, true, true},
+  {"measure_code", TYPE_UTF8, true, false},
+  {"measure_label", TYPE_UTF8, true, false},
+  {"year", TYPE_INT, false, false},
+  {"value", TYPE_FLOATING_POINT, false, false},
+};
+
+/*
+  Append an integer to a string of bytes, little-endian.
+*/
+static void appendLittleEndian(std::string& bytes, std::uint64_t value, std::size_t size) {
+  for (std::size_t i = 0; i < size; i++) {
+    bytes.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+static void appendDouble(std::string& bytes, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  appendLittleEndian(bytes, bits, sizeof(bits));
+}
+
+/*
+  Append zeros to a string of bytes, up to a multiple of 8 bytes.
+*/
+static void padTo8(std::string& bytes) {
+  bytes.append((8 - bytes.size() % 8) % 8, '\0');
+}
+
+/*
+  Builds a flatbuffer back to front, as the official builders do, so that
+  every object is placed before the objects it refers to are (which the
+  format's unsigned offsets require). Offsets to the objects built are
+  counted from the end of the buffer until it is finished.
+
+  Tables cannot be nested: their strings, vectors and tables must be built
+  before starting them.
+*/
+class FlatBufferBuilder {
+public:
+  using Offset = std::uint32_t;
+
+  void startTable() {
+    fields.clear();
+    tableStart = bytes.size();
+  }
+
+  template <typename T>
+  void addScalar(int slot, T value) {
+    align(sizeof(T), sizeof(T));
+    std::string scalar;
+    appendLittleEndian(scalar, static_cast<std::uint64_t>(value), sizeof(T));
+    prepend(scalar);
+    fields.push_back({slot, size()});
+  }
+
+  void addOffset(int slot, Offset target) {
+    prependOffset(target);
+    fields.push_back({slot, size()});
+  }
+
+  Offset endTable() {
+    // The table starts with the offset to its vtable, filled in below
+    align(4, 4);
+    prepend(std::string(4, '\0'));
+    const Offset table = size();
+
+    int slots = 0;
+    for (const auto& field : fields) {
+      slots = std::max(slots, field.first + 1);
+    }
+    std::vector<std::uint16_t> vtable(2 + slots, 0);
+    vtable[0] = static_cast<std::uint16_t>(vtable.size() * 2);
+    vtable[1] = static_cast<std::uint16_t>(table - tableStart);
+    for (const auto& field : fields) {
+      vtable[2 + field.first] = static_cast<std::uint16_t>(table - field.second);
+    }
+
+    std::string entries;
+    for (auto entry : vtable) {
+      appendLittleEndian(entries, entry, 2);
+    }
+    prepend(entries);
+
+    // The vtable is before the table, at a positive signed offset back
+    std::string vtableOffset;
+    appendLittleEndian(vtableOffset, size() - table, 4);
+    bytes.replace(bytes.size() - table, 4, vtableOffset);
+    return table;
+  }
+
+  Offset createString(const std::string& str) {
+    align(str.size() + 1, 4);
+    prepend(str + '\0');
+    prependLength(str.size());
+    return size();
+  }
+
+  Offset createOffsetVector(const std::vector<Offset>& targets) {
+    align(4 * targets.size(), 4);
+    for (auto it = targets.rbegin(); it != targets.rend(); ++it) {
+      prependOffset(*it);
+    }
+    prependLength(targets.size());
+    return size();
+  }
+
+  /*
+    A vector of structs, given as their bytes, whose fields are at most 8
+    bytes wide
+  */
+  Offset createStructVector(const std::string& structs, std::size_t count) {
+    align(structs.size(), 8);
+    prepend(structs);
+    prependLength(count);
+    return size();
+  }
+
+  std::string finish(Offset root) {
+    align(4, 8);
+    prependOffset(root);
+    return bytes;
+  }
+
+private:
+  Offset size() const { return static_cast<Offset>(bytes.size()); }
+
+  void prepend(const std::string& data) { bytes.insert(0, data); }
+
+  /*
+    Pad the front of the buffer so that `length` more bytes end it on a
+    multiple of `alignment` (the buffer is padded to 8 bytes when it is
+    finished, so this aligns the data once it is read from the front).
+  */
+  void align(std::size_t length, std::size_t alignment) {
+    const std::size_t padding = (alignment - (bytes.size() + length) % alignment) % alignment;
+    prepend(std::string(padding, '\0'));
+  }
+
+  void prependOffset(Offset target) {
+    align(4, 4);
+    std::string offset;
+    appendLittleEndian(offset, size() + 4 - target, 4);
+    prepend(offset);
+  }
+
+  void prependLength(std::size_t length) {
+    std::string count;
+    appendLittleEndian(count, length, 4);
+    prepend(count);
+  }
+
+  std::string bytes;
+  std::vector<std::pair<int, Offset>> fields;
+  std::size_t tableStart = 0;
+};
+
+/*
+  Build an Int type table, for an integer column or dictionary indexes.
+*/
+static FlatBufferBuilder::Offset addIntType(FlatBufferBuilder& fb) {
+  fb.startTable();
+  fb.addScalar<std::int32_t>(0, 32);
+  fb.addScalar<std::uint8_t>(1, 1);
+  return fb.endTable();
+}
+
+/*
+  Build the Schema table describing the columns.
+*/
+static FlatBufferBuilder::Offset addSchema(FlatBufferBuilder& fb) {
+  std::vector<FlatBufferBuilder::Offset> fields;
+  for (std::size_t i = 0; i < NUM_COLUMNS; i++) {
+    const ColumnSpec& column = COLUMNS[i];
+    const auto name = fb.createString(column.name);
+
+    FlatBufferBuilder::Offset type;
+    if (column.type == TYPE_INT) {
+      type = addIntType(fb);
+    } else if (column.type == TYPE_FLOATING_POINT) {
+      fb.startTable();
+      fb.addScalar<std::int16_t>(0, PRECISION_DOUBLE);
+      type = fb.endTable();
+    } else {
+      fb.startTable();
+      type = fb.endTable();
+    }
+
+    FlatBufferBuilder::Offset dictionary = 0;
+    if (column.dictionary) {
+      const auto indexType = addIntType(fb);
+      fb.startTable();
+      fb.addScalar<std::int64_t>(0, i);
+      fb.addOffset(1, indexType);
+      dictionary = fb.endTable();
+    }
+
+    const auto children = fb.createOffsetVector({});
+
+    fb.startTable();
+    fb.addOffset(0, name);
+    fb.addScalar<std::uint8_t>(1, column.nullable);
+    fb.addScalar<std::uint8_t>(2, column.type);
+    fb.addOffset(3, type);
+    if (column.dictionary) {
+      fb.addOffset(4, dictionary);
+    }
+    fb.addOffset(5, children);
+    fields.push_back(fb.endTable());
+  }
+
+  const auto fieldVector = fb.createOffsetVector(fields);
+  fb.startTable();
+  fb.addOffset(1, fieldVector);
+  return fb.endTable();
+}
+
+/*
+  The body of a message: the buffers of its columns, each padded to 8
+  bytes, and where each one is.
+*/
+class MessageBody {
+public:
+  void addBuffer(const std::string& buffer) {
+    appendLittleEndian(layout, bytes.size(), 8);
+    appendLittleEndian(layout, buffer.size(), 8);
+    bytes += buffer;
+    padTo8(bytes);
+    numBuffers++;
+  }
+
+  void addNode(std::size_t length, std::size_t nulls) {
+    appendLittleEndian(nodes, length, 8);
+    appendLittleEndian(nodes, nulls, 8);
+    numNodes++;
+  }
+
+  /*
+    Build the RecordBatch table describing the body.
+  */
+  FlatBufferBuilder::Offset addRecordBatch(FlatBufferBuilder& fb, std::size_t rows) const {
+    const auto nodeVector = fb.createStructVector(nodes, numNodes);
+    const auto bufferVector = fb.createStructVector(layout, numBuffers);
+    fb.startTable();
+    fb.addScalar<std::int64_t>(0, rows);
+    fb.addOffset(1, nodeVector);
+    fb.addOffset(2, bufferVector);
+    return fb.endTable();
+  }
+
+  const std::string& data() const { return bytes; }
+
+private:
+  std::string bytes;
+  std::string layout;
+  std::string nodes;
+  std::size_t numBuffers = 0;
+  std::size_t numNodes = 0;
+};
+
+/*
+  Writes the messages of the file to a stream, keeping track of where each
+  one starts for the footer.
+*/
+class ArrowWriter {
+public:
+  explicit ArrowWriter(std::ostream& os) : os(os) {}
+
+  void write(const std::string& data) {
+    os.write(data.data(), data.size());
+    written += data.size();
+  }
+
+  /*
+    Write a message, given its header table in `fb`, and record its Block
+    (offset, metadata size and body size) in `blocks`.
+  */
+  void writeMessage(FlatBufferBuilder& fb,
+                    std::uint8_t headerType,
+                    FlatBufferBuilder::Offset header,
+                    const std::string& body,
+                    std::string* blocks,
+                    std::size_t* numBlocks) {
+    fb.startTable();
+    fb.addScalar<std::int16_t>(0, METADATA_V5);
+    fb.addScalar<std::uint8_t>(1, headerType);
+    fb.addOffset(2, header);
+    fb.addScalar<std::int64_t>(3, body.size());
+    std::string metadata = fb.finish(fb.endTable());
+    padTo8(metadata);
+
+    if (blocks != nullptr) {
+      appendLittleEndian(*blocks, written, 8);
+      appendLittleEndian(*blocks, 8 + metadata.size(), 4);
+      appendLittleEndian(*blocks, 0, 4);
+      appendLittleEndian(*blocks, body.size(), 8);
+      (*numBlocks)++;
+    }
+
+    std::string prefix;
+    appendLittleEndian(prefix, 0xFFFFFFFF, 4);
+    appendLittleEndian(prefix, metadata.size(), 4);
+    write(prefix);
+    write(metadata);
+    write(body);
+  }
+
+private:
+  std::ostream& os;
+  std::uint64_t written = 0;
+};
+
+/*
+  The distinct strings of a dictionary-encoded column, in the order they
+  were first added, and the index of each.
+*/
+class ColumnDictionary {
+public:
+  void add(Symbol value) {
+    if (indexes.try_emplace(value, static_cast<std::int32_t>(values.size())).second) {
+      values.push_back(value);
+    }
+  }
+
+  std::int32_t at(Symbol value) const { return indexes.at(value); }
+
+  /*
+    The Utf8 column holding the strings, as the body of a dictionary batch
+  */
+  MessageBody body() const {
+    std::string offsets;
+    std::string data;
+    appendLittleEndian(offsets, 0, 4);
+    for (const auto& value : values) {
+      data += value.str();
+      appendLittleEndian(offsets, data.size(), 4);
+    }
+
+    MessageBody body;
+    body.addNode(values.size(), 0);
+    body.addBuffer("");
+    body.addBuffer(offsets);
+    body.addBuffer(data);
+    return body;
+  }
+
+  std::size_t size() const { return values.size(); }
+
+private:
+  std::unordered_map<Symbol, std::int32_t> indexes;
+  std::vector<Symbol> values;
+};
+
+/*
+  The columns of up to BATCH_ROWS rows, with -1 for a null string
+*/
+struct RowBatch {
+  std::vector<std::int32_t> indexes[NUM_DICTIONARIES];
+  std::vector<std::int32_t> years;
+  std::vector<double> values;
+
+  std::size_t size() const { return years.size(); }
+
+  void clear() {
+    for (auto& column : indexes) {
+      column.clear();
+    }
+    years.clear();
+    values.clear();
+  }
+
+  /*
+    The body of the record batch holding the rows
+  */
+  MessageBody body() const {
+    const std::size_t rows = size();
+    MessageBody body;
+
+    for (const auto& column : indexes) {
+      std::string validity((rows + 7) / 8, '\0');
+      std::string data;
+      data.reserve(rows * 4);
+      std::size_t nulls = 0;
+      for (std::size_t row = 0; row < rows; row++) {
+        if (column[row] < 0) {
+          nulls++;
+          appendLittleEndian(data, 0, 4);
+        } else {
+          validity[row / 8] |= static_cast<char>(1 << (row % 8));
+          appendLittleEndian(data, column[row], 4);
+        }
+      }
+      body.addNode(rows, nulls);
+      body.addBuffer(nulls > 0 ? validity : "");
+      body.addBuffer(data);
+    }
+
+    std::string yearData;
+    yearData.reserve(rows * 4);
+    for (auto year : years) {
+      appendLittleEndian(yearData, static_cast<std::uint32_t>(year), 4);
+    }
+    body.addNode(rows, 0);
+    body.addBuffer("");
+    body.addBuffer(yearData);
+
+    std::string valueData;
+    valueData.reserve(rows * 8);
+    for (auto value : values) {
+      appendDouble(valueData, value);
+    }
+    body.addNode(rows, 0);
+    body.addBuffer("");
+    body.addBuffer(valueData);
+    return body;
+  }
+};
+
+/*
+  Write the data of an Areas object to an output stream as an Arrow IPC
+  file.
+
+  @param os
+    The output stream to write to, which should be opened in binary mode
+
+  @param areas
+    The data to write
+
+  @throws
+    std::runtime_error if the stream could not be written to
+
+  @example
+    std::ofstream file("bethyw.arrow", std::ios::binary);
+    ColumnarFile::write(file, areas);
+*/
+void ColumnarFile::write(std::ostream& os, const Areas& areas) {
+  Profile::Timer timer("writeColumnar");
+
+  // Find every distinct string first, so the dictionaries can be written
+  // before the rows that refer to them
+  ColumnDictionary dictionaries[NUM_DICTIONARIES];
+  for (const auto& areaPair : areas.getAreas()) {
+    const Area& area = areaPair.second;
+    dictionaries[0].add(areaPair.first);
+    for (const auto& namePair : area.getNames()) {
+      if (namePair.first == LANG_ENG) {
+        dictionaries[1].add(namePair.second);
+      } else if (namePair.first == LANG_CYM) {
+        dictionaries[2].add(namePair.second);
+      }
+    }
+    for (const auto& measurePair : area.getMeasures()) {
+      dictionaries[3].add(measurePair.first);
+      dictionaries[4].add(measurePair.second.getLabelSymbol());
+    }
+  }
+
+  ArrowWriter writer(os);
+  writer.write(std::string("ARROW1\0\0", 8));
+
+  {
+    FlatBufferBuilder fb;
+    const auto schema = addSchema(fb);
+    writer.writeMessage(fb, HEADER_SCHEMA, schema, "", nullptr, nullptr);
+  }
+
+  std::string dictionaryBlocks;
+  std::size_t numDictionaryBlocks = 0;
+  for (std::size_t id = 0; id < NUM_DICTIONARIES; id++) {
+    const MessageBody body = dictionaries[id].body();
+    FlatBufferBuilder fb;
+    const auto data = body.addRecordBatch(fb, dictionaries[id].size());
+    fb.startTable();
+    fb.addScalar<std::int64_t>(0, id);
+    fb.addOffset(1, data);
+    const auto batch = fb.endTable();
+    writer.writeMessage(fb, HEADER_DICTIONARY_BATCH, batch, body.data(),
+                        &dictionaryBlocks, &numDictionaryBlocks);
+  }
+
+  std::string recordBlocks;
+  std::size_t numRecordBlocks = 0;
+  RowBatch rows;
+  auto flush = [&]() {
+    const MessageBody body = rows.body();
+    FlatBufferBuilder fb;
+    const auto batch = body.addRecordBatch(fb, rows.size());
+    writer.writeMessage(fb, HEADER_RECORD_BATCH, batch, body.data(),
+                        &recordBlocks, &numRecordBlocks);
+    rows.clear();
+  };
+
+  for (const auto& areaPair : areas.getAreas()) {
+    const Area& area = areaPair.second;
+    const auto& names = area.getNames();
+    const auto eng = names.find(LANG_ENG);
+    const auto cym = names.find(LANG_CYM);
+
+    std::int32_t row[NUM_DICTIONARIES];
+    row[0] = dictionaries[0].at(areaPair.first);
+    row[1] = eng != nullptr ? dictionaries[1].at(eng->second) : -1;
+    row[2] = cym != nullptr ? dictionaries[2].at(cym->second) : -1;
+
+    for (const auto& measurePair : area.getMeasures()) {
+      const Measure& measure = measurePair.second;
+      row[3] = dictionaries[3].at(measurePair.first);
+      row[4] = dictionaries[4].at(measure.getLabelSymbol());
+
+      for (const auto& yearValue : measure.getYears()) {
+        for (std::size_t i = 0; i < NUM_DICTIONARIES; i++) {
+          rows.indexes[i].push_back(row[i]);
+        }
+        rows.years.push_back(yearValue.first);
+        rows.values.push_back(yearValue.second);
+        if (rows.size() == BATCH_ROWS) {
+          flush();
+        }
+      }
+    }
+  }
+  if (rows.size() > 0) {
+    flush();
+  }
+
+  // The end of the stream of messages, for readers of the stream format
+  std::string end;
+  appendLittleEndian(end, 0xFFFFFFFF, 4);
+  appendLittleEndian(end, 0, 4);
+  writer.write(end);
+
+  FlatBufferBuilder fb;
+  const auto schema = addSchema(fb);
+  const auto dictionaryVector = fb.createStructVector(dictionaryBlocks, numDictionaryBlocks);
+  const auto recordVector = fb.createStructVector(recordBlocks, numRecordBlocks);
+  fb.startTable();
+  fb.addScalar<std::int16_t>(0, METADATA_V5);
+  fb.addOffset(1, schema);
+  fb.addOffset(2, dictionaryVector);
+  fb.addOffset(3, recordVector);
+  const std::string footer = fb.finish(fb.endTable());
+
+  std::string footerSize;
+  appendLittleEndian(footerSize, footer.size(), 4);
+  writer.write(footer);
+  writer.write(footerSize);
+  writer.write("ARROW1");
+
+  if (!os) {
+    throw std::runtime_error("ColumnarFile::write: Failed to write the file");
+  }
+}
+
+/*
+  Write the data of an Areas object to a file as an Arrow IPC file. The
+  file is written under a temporary name and then renamed (see
+  saveAtomically()), so a reader never sees a partly written file.
+
+  @param path
+    The path of the file to write, e.g. ending .arrow or .feather
+
+  @param areas
+    The data to write
+
+  @throws
+    std::runtime_error if the file cannot be written
+
+  @example
+    ColumnarFile::save("bethyw.arrow", areas);
+*/
+void ColumnarFile::save(const std::string& path, const Areas& areas) {
+  saveAtomically(path, [&](std::ostream& os) {
+    write(os, areas);
+  });
+}
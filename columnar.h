@@ -0,0 +1,60 @@
+#ifndef COLUMNAR_H_
+#define COLUMNAR_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the ColumnarFile class, which writes
+  a populated Areas object as a columnar file for analytics tools to read.
+ */
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "areas.h"
+
+/*
+  ColumnarFile writes the data of an Areas object as an Apache Arrow IPC
+  file (also known as Feather version 2), which pandas (read_feather()),
+  DuckDB, Polars and anything else built on Arrow can read directly,
+  without parsing any text.
+
+  The file holds one row for every value of every Measure of every Area,
+  with the columns:
+
+    area_code      string (dictionary-encoded)
+    name_eng       string (dictionary-encoded), null if the area has none
+    name_cym       string (dictionary-encoded), null if the area has none
+    measure_code   string (dictionary-encoded)
+    measure_label  string (dictionary-encoded)
+    year           int32
+    value          float64
+
+  in the same order as the other output formats: by area code, then by
+  measure code, then by year. Each string is stored once, in its column's
+  dictionary, and the rows refer to it by index, so the year and value
+  columns (and the indexes) are plain contiguous arrays.
+
+  The rows are written straight from the Areas object, BATCH_ROWS at a
+  time, so memory use does not grow with the size of the data.
+
+  @example
+    ColumnarFile::save("popden.arrow", areas);
+*/
+class ColumnarFile {
+public:
+  /*
+    The most rows in each record batch of the file
+  */
+  static constexpr std::size_t BATCH_ROWS = 64 * 1024;
+
+  static void write(std::ostream& os, const Areas& areas);
+  static void save(const std::string& path, const Areas& areas);
+};
+
+#endif // COLUMNAR_H_
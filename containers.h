@@ -0,0 +1,456 @@
+#ifndef CONTAINERS_H_
+#define CONTAINERS_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the map containers that Areas and Area store their
+  data in: FlatHashMap, for the (many) areas of an Areas object, and
+  SortedVectorMap, for the (few) names and measures of each Area.
+
+  Both have the same interface, which is a subset of std::map's, except
+  that find() and try_emplace() give a pointer to the entry (null if there
+  is none) rather than an iterator. Iterating either visits the entries in
+  order of their keys, as std::map does, so a container can be swapped for
+  the other (see AreasContainer in areas.h) without changing any output.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+  An iterator over the entries of a FlatHashMap, in order of their keys,
+  through the container's sorted vector of pointers to its entries.
+*/
+template <typename Entry>
+class OrderedEntryIterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::remove_const_t<Entry>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = Entry*;
+  using reference = Entry&;
+
+  explicit OrderedEntryIterator(value_type* const* position) : position(position) {}
+
+  reference operator*() const { return **position; }
+  pointer operator->() const { return *position; }
+
+  OrderedEntryIterator& operator++() {
+    ++position;
+    return *this;
+  }
+  OrderedEntryIterator operator++(int) {
+    OrderedEntryIterator previous = *this;
+    ++position;
+    return previous;
+  }
+
+  difference_type operator-(const OrderedEntryIterator& other) const {
+    return position - other.position;
+  }
+
+  bool operator==(const OrderedEntryIterator& other) const {
+    return position == other.position;
+  }
+  bool operator!=(const OrderedEntryIterator& other) const {
+    return position != other.position;
+  }
+
+private:
+  value_type* const* position;
+};
+
+/*
+  FlatHashMap is an open-addressing hash map for keys that are cheap to hash
+  and compare (e.g. Symbols). Looking up or inserting a key is a probe of a
+  flat table of entry numbers, rather than the O(log n) pointer chasing of
+  a std::map, which makes the lookups of every row during an import O(1).
+
+  The entries themselves are kept in a std::pmr::deque, so they never move
+  once inserted: pointers and references to them stay valid, as they do
+  for a std::map, until the container is cleared or destroyed.
+
+  Iterating visits the entries in order of their keys, through a frozen
+  vector of pointers to them, sorted once when it is first needed after
+  keys have been inserted out of order (inserting keys in order, as most
+  datasets do, keeps it sorted without any extra work). Sorting it is
+  guarded by a mutex, so (as with a std::map) any number of threads may
+  read the container at once, as long as none is modifying it.
+
+  The container is allocator-aware: its entries (and the vector and table
+  indexing them) allocate from the given memory resource, e.g. the arena of
+  an Areas object, and a Value that is allocator-aware allocates from it
+  too.
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap {
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<const Key, Value>;
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+  using iterator = OrderedEntryIterator<value_type>;
+  using const_iterator = OrderedEntryIterator<const value_type>;
+
+  explicit FlatHashMap(const allocator_type& alloc = {})
+      : entries(alloc), slots(alloc), order(alloc) {}
+
+  /*
+    Copy the entries of another FlatHashMap, allocating from `alloc`.
+  */
+  FlatHashMap(const FlatHashMap& other, const allocator_type& alloc = {})
+      : FlatHashMap(alloc) {
+    insertAll(other);
+  }
+
+  /*
+    Replace the entries with copies of another FlatHashMap's, keeping this
+    container's allocator.
+  */
+  FlatHashMap& operator=(const FlatHashMap& other) {
+    if (this != &other) {
+      clear();
+      insertAll(other);
+    }
+    return *this;
+  }
+
+  iterator begin() {
+    freeze();
+    return iterator(order.data());
+  }
+  iterator end() {
+    return iterator(order.data() + order.size());
+  }
+  const_iterator begin() const {
+    freeze();
+    return const_iterator(order.data());
+  }
+  const_iterator end() const {
+    return const_iterator(order.data() + order.size());
+  }
+
+  std::size_t size() const { return entries.size(); }
+  bool empty() const { return entries.empty(); }
+
+  /*
+    The entry with a key, or null if there is none.
+  */
+  value_type* find(const Key& key) {
+    return const_cast<value_type*>(static_cast<const FlatHashMap&>(*this).find(key));
+  }
+
+  const value_type* find(const Key& key) const {
+    if (slots.empty()) {
+      return nullptr;
+    }
+    for (std::size_t i = home(key);; i = (i + 1) & (slots.size() - 1)) {
+      const std::uint32_t slot = slots[i];
+      if (slot == EMPTY) {
+        return nullptr;
+      }
+      const value_type& entry = entries[slot - 1];
+      if (entry.first == key) {
+        return &entry;
+      }
+    }
+  }
+
+  /*
+    The value of a key, throwing std::out_of_range (with the same message as
+    std::map::at()) if there is none.
+  */
+  Value& at(const Key& key) {
+    return const_cast<Value&>(static_cast<const FlatHashMap&>(*this).at(key));
+  }
+
+  const Value& at(const Key& key) const {
+    const value_type* entry = find(key);
+    if (entry == nullptr) {
+      throw std::out_of_range("map::at");
+    }
+    return entry->second;
+  }
+
+  /*
+    Insert an entry for a key, with a value constructed in place from
+    `args`, unless there is one already (in which case `args` are not
+    used).
+
+    @return
+      The entry for the key, and whether it was inserted
+  */
+  template <typename... Args>
+  std::pair<value_type*, bool> try_emplace(const Key& key, Args&&... args) {
+    if ((entries.size() + 1) * 2 > slots.size()) {
+      grow();
+    }
+
+    std::size_t i = home(key);
+    for (;; i = (i + 1) & (slots.size() - 1)) {
+      const std::uint32_t slot = slots[i];
+      if (slot == EMPTY) {
+        break;
+      }
+      value_type& entry = entries[slot - 1];
+      if (entry.first == key) {
+        return {&entry, false};
+      }
+    }
+
+    entries.emplace_back(std::piecewise_construct,
+                         std::forward_as_tuple(key),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+    value_type& entry = entries.back();
+    slots[i] = static_cast<std::uint32_t>(entries.size());
+
+    if (!order.empty() && !(order.back()->first < key)) {
+      ordered.store(false, std::memory_order_relaxed);
+    }
+    order.push_back(&entry);
+    return {&entry, true};
+  }
+
+  /*
+    The value of a key, inserting a default-constructed one if there is none
+  */
+  Value& operator[](const Key& key) {
+    return try_emplace(key).first->second;
+  }
+
+  void clear() {
+    entries.clear();
+    std::fill(slots.begin(), slots.end(), EMPTY);
+    order.clear();
+    ordered.store(true, std::memory_order_relaxed);
+  }
+
+  allocator_type get_allocator() const { return entries.get_allocator(); }
+
+  friend bool operator==(const FlatHashMap& lhs, const FlatHashMap& rhs) {
+    return lhs.size() == rhs.size() &&
+           std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  }
+  friend bool operator!=(const FlatHashMap& lhs, const FlatHashMap& rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  static constexpr std::uint32_t EMPTY = 0;
+  static constexpr std::size_t MIN_SLOTS = 16;
+
+  /*
+    The first slot to probe for a key. Fibonacci hashing spreads keys whose
+    hashes differ only in their high bits (e.g. pointers) over the table.
+  */
+  std::size_t home(const Key& key) const {
+    const std::uint64_t hash = static_cast<std::uint64_t>(Hash()(key));
+    return static_cast<std::size_t>((hash * 0x9E3779B97F4A7C15ull) >> shift);
+  }
+
+  /*
+    Double the table (keeping it at most half full) and insert every entry
+    into it again.
+  */
+  void grow() {
+    const std::size_t size = std::max(MIN_SLOTS, slots.size() * 2);
+    slots.assign(size, EMPTY);
+    shift = 64;
+    for (std::size_t n = size; n > 1; n >>= 1) {
+      shift--;
+    }
+
+    for (std::size_t e = 0; e < entries.size(); e++) {
+      std::size_t i = home(entries[e].first);
+      while (slots[i] != EMPTY) {
+        i = (i + 1) & (size - 1);
+      }
+      slots[i] = static_cast<std::uint32_t>(e + 1);
+    }
+  }
+
+  /*
+    Sort the pointers to the entries by key, if keys have been inserted out
+    of order since they were last sorted.
+  */
+  void freeze() const {
+    if (ordered.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(orderMutex);
+    if (!ordered.load(std::memory_order_relaxed)) {
+      std::sort(order.begin(), order.end(),
+                [](const value_type* lhs, const value_type* rhs) {
+                  return lhs->first < rhs->first;
+                });
+      ordered.store(true, std::memory_order_release);
+    }
+  }
+
+  /*
+    Insert copies of the entries of another container, in order of their
+    keys, so that this container's order starts out sorted.
+  */
+  void insertAll(const FlatHashMap& other) {
+    for (const auto& entry : other) {
+      try_emplace(entry.first, entry.second);
+    }
+  }
+
+  std::pmr::deque<value_type> entries;
+  std::pmr::vector<std::uint32_t> slots;
+  unsigned int shift = 64;
+
+  mutable std::pmr::vector<value_type*> order;
+  mutable std::atomic<bool> ordered{true};
+  mutable std::mutex orderMutex;
+};
+
+/*
+  SortedVectorMap keeps its entries in a single vector, sorted by key, so
+  finding a key is a binary search of contiguous memory and iterating is a
+  walk along it. That suits small maps that are mostly read, such as the
+  names and measures of an Area, better than a node-based std::map.
+
+  Inserting a key is linear in the number of entries after it, and moves
+  them, so unlike a std::map, pointers and references to the entries are
+  only valid until the next insertion.
+
+  The container is allocator-aware, and a Value that is allocator-aware
+  allocates from the same memory resource.
+*/
+template <typename Key, typename Value>
+class SortedVectorMap {
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<Key, Value>;
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+  using iterator = value_type*;
+  using const_iterator = const value_type*;
+
+  SortedVectorMap() = default;
+  explicit SortedVectorMap(const allocator_type& alloc) : entries(alloc) {}
+  SortedVectorMap(const SortedVectorMap& other) = default;
+  SortedVectorMap(SortedVectorMap&& other) = default;
+  SortedVectorMap(const SortedVectorMap& other, const allocator_type& alloc)
+      : entries(other.entries, alloc) {}
+  SortedVectorMap(SortedVectorMap&& other, const allocator_type& alloc)
+      : entries(std::move(other.entries), alloc) {}
+  SortedVectorMap& operator=(const SortedVectorMap& other) = default;
+  SortedVectorMap& operator=(SortedVectorMap&& other) = default;
+
+  iterator begin() { return entries.data(); }
+  iterator end() { return entries.data() + entries.size(); }
+  const_iterator begin() const { return entries.data(); }
+  const_iterator end() const { return entries.data() + entries.size(); }
+
+  std::size_t size() const { return entries.size(); }
+  bool empty() const { return entries.empty(); }
+
+  /*
+    The entry with a key, or null if there is none.
+  */
+  value_type* find(const Key& key) {
+    return const_cast<value_type*>(static_cast<const SortedVectorMap&>(*this).find(key));
+  }
+
+  const value_type* find(const Key& key) const {
+    auto it = lowerBound(key);
+    if (it == entries.end() || it->first != key) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  /*
+    The value of a key, throwing std::out_of_range (with the same message as
+    std::map::at()) if there is none.
+  */
+  Value& at(const Key& key) {
+    return const_cast<Value&>(static_cast<const SortedVectorMap&>(*this).at(key));
+  }
+
+  const Value& at(const Key& key) const {
+    const value_type* entry = find(key);
+    if (entry == nullptr) {
+      throw std::out_of_range("map::at");
+    }
+    return entry->second;
+  }
+
+  /*
+    Insert an entry for a key, with a value constructed in place from
+    `args`, unless there is one already (in which case `args` are not
+    used).
+
+    @return
+      The entry for the key, and whether it was inserted
+  */
+  template <typename... Args>
+  std::pair<value_type*, bool> try_emplace(const Key& key, Args&&... args) {
+    auto it = lowerBound(key);
+    if (it != entries.end() && it->first == key) {
+      return {&*it, false};
+    }
+    it = entries.emplace(it,
+                         std::piecewise_construct,
+                         std::forward_as_tuple(key),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+    return {&*it, true};
+  }
+
+  /*
+    The value of a key, inserting a default-constructed one if there is none
+  */
+  Value& operator[](const Key& key) {
+    return try_emplace(key).first->second;
+  }
+
+  void clear() { entries.clear(); }
+
+  allocator_type get_allocator() const { return entries.get_allocator(); }
+
+  friend bool operator==(const SortedVectorMap& lhs, const SortedVectorMap& rhs) {
+    return lhs.entries == rhs.entries;
+  }
+  friend bool operator!=(const SortedVectorMap& lhs, const SortedVectorMap& rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  typename std::pmr::vector<value_type>::const_iterator lowerBound(const Key& key) const {
+    return std::lower_bound(entries.begin(), entries.end(), key,
+                            [](const value_type& entry, const Key& k) {
+                              return entry.first < k;
+                            });
+  }
+
+  typename std::pmr::vector<value_type>::iterator lowerBound(const Key& key) {
+    return std::lower_bound(entries.begin(), entries.end(), key,
+                            [](const value_type& entry, const Key& k) {
+                              return entry.first < k;
+                            });
+  }
+
+  std::pmr::vector<value_type> entries;
+};
+
+#endif // CONTAINERS_H_
@@ -0,0 +1,401 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the CSVReader class, which splits
+  lines of CSV data into fields without copying them.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "csv.h"
+
+/*
+  Construct a CSVReader over an input stream. Nothing is read until next()
+  is called.
+
+  @param is
+    The input stream to read CSV data from
+
+  @example
+    InputFile input("datasets/areas.csv");
+    CSVReader reader(input.open());
+*/
+CSVReader::CSVReader(std::istream& is) : is(&is) {}
+
+/*
+  Construct a CSVReader over an in-memory buffer, such as a memory-mapped
+  file. The buffer must outlive the reader.
+
+  @param buffer
+    The CSV data to read
+
+  @example
+    InputMappedFile input("datasets/areas.csv");
+    CSVReader reader(input.open());
+*/
+CSVReader::CSVReader(std::string_view buffer) : is(nullptr), buffer(buffer) {}
+
+/*
+  Read the next row from the stream or buffer, replacing the previous row.
+  The row is split into fields as they are needed.
+
+  @return
+    true if a row was read, false if the end of the input was reached
+
+  @example
+    CSVReader reader(is);
+    while (reader.next()) {
+      auto code = reader.field(0);
+    }
+*/
+bool CSVReader::next() {
+  row.clear();
+  splitPosition = 0;
+  isSplit = false;
+  hasQuotes = false;
+
+  std::string_view text;
+  while (nextLine(text)) {
+    if (!text.empty() && text.back() == '\r') {
+      text.remove_suffix(1);
+    }
+
+    if (text.empty()) {
+      continue;
+    }
+
+    current = text;
+    return true;
+  }
+
+  return false;
+}
+
+/*
+  Find the next line of input. A quoted field may contain line breaks, so a
+  line only ends at a newline outside of quotes. Whether the line contains
+  any quotes is noted in `hasQuotes` on the way.
+
+  @param text
+    Set to the text of the line, without the newline
+
+  @return
+    true if a line was found, false at the end of the input
+*/
+bool CSVReader::nextLine(std::string_view& text) {
+  if (is == nullptr) {
+    if (position >= buffer.size()) {
+      return false;
+    }
+
+    std::size_t end = position;
+    bool quoted = false;
+    while (end < buffer.size()) {
+      const char* found = static_cast<const char*>(
+          std::memchr(buffer.data() + end, quoted ? '"' : '\n',
+                      buffer.size() - end));
+      if (found == nullptr) {
+        end = buffer.size();
+        break;
+      }
+
+      // A quote before the newline means the newline may be inside a field
+      std::size_t at = found - buffer.data();
+      if (!quoted) {
+        const char* quote = static_cast<const char*>(
+            std::memchr(buffer.data() + end, '"', at - end));
+        if (quote != nullptr) {
+          quoted = true;
+          hasQuotes = true;
+          end = quote - buffer.data() + 1;
+          continue;
+        }
+        end = at;
+        break;
+      }
+      quoted = false;
+      end = at + 1;
+    }
+
+    text = buffer.substr(position, end - position);
+    position = end + 1;
+    return true;
+  }
+
+  if (!std::getline(*is, line)) {
+    return false;
+  }
+  hasQuotes = line.find('"') != std::string::npos;
+  while (std::count(line.begin(), line.end(), '"') % 2 != 0) {
+    std::string continuation;
+    if (!std::getline(*is, continuation)) {
+      break;
+    }
+    line += '\n';
+    line += continuation;
+  }
+  text = line;
+  return true;
+}
+
+/*
+  Split the current row into fields, at least as far as the field at
+  `index`. Lines without quotes are split in place, a field at a time, so
+  every field is a view into the line and the fields after `index` are not
+  looked at.
+
+  @param index
+    The zero-indexed column of the last field needed
+*/
+void CSVReader::split(std::size_t index) const {
+  if (isSplit || index < row.size()) {
+    return;
+  }
+
+  if (hasQuotes) {
+    splitQuoted();
+    isSplit = true;
+    return;
+  }
+
+  while (row.size() <= index) {
+    std::size_t comma = current.find(',', splitPosition);
+    if (comma == std::string_view::npos) {
+      row.emplace_back(current.substr(splitPosition));
+      isSplit = true;
+      return;
+    }
+    row.emplace_back(current.substr(splitPosition, comma - splitPosition));
+    splitPosition = comma + 1;
+  }
+}
+
+/*
+  Split the whole of the current row, which contains quotes, into fields.
+  Quoted fields are unescaped in the internal line buffer (the unescaped
+  text is never longer than the original).
+*/
+void CSVReader::splitQuoted() const {
+  std::string_view text = current;
+  if (text.data() != line.data()) {
+    line.assign(text.data(), text.size());
+  } else {
+    // Drop anything trimmed from the end of the line, e.g. a carriage return
+    line.resize(text.size());
+  }
+
+  const char* read = line.data();
+  const char* const end = read + line.size();
+
+  while (true) {
+    char* fieldStart = const_cast<char*>(read);
+
+    if (read != end && *read == '"') {
+      // Quoted field: copy characters down over the opening quote and any
+      // escaped quotes
+      char* write = fieldStart;
+      read++;
+      while (read != end) {
+        if (*read == '"') {
+          if (read + 1 != end && *(read + 1) == '"') {
+            *write++ = '"';
+            read += 2;
+            continue;
+          }
+          read++;
+          break;
+        }
+        *write++ = *read++;
+      }
+
+      std::size_t length = write - fieldStart;
+
+      // Allow (and ignore) anything between the closing quote and the comma
+      while (read != end && *read != ',') {
+        read++;
+      }
+      row.emplace_back(fieldStart, length);
+    } else {
+      while (read != end && *read != ',') {
+        read++;
+      }
+      row.emplace_back(fieldStart, read - fieldStart);
+    }
+
+    if (read == end) {
+      break;
+    }
+    read++; // Skip the comma
+  }
+}
+
+/*
+  Retrieve how far into the buffer the reader has got, i.e. where the row
+  after the current one starts. Only meaningful when reading a buffer.
+
+  @return
+    The offset into the buffer of the next row
+*/
+std::size_t CSVReader::offset() const {
+  return position;
+}
+
+/*
+  Retrieve the number of fields in the current row.
+
+  @return
+    The number of fields
+*/
+std::size_t CSVReader::size() const {
+  if (!isSplit && !hasQuotes) {
+    // Counting the commas is cheaper than splitting the rest of the row
+    return row.size() + 1 +
+           std::count(current.begin() + std::min(splitPosition, current.size()),
+                      current.end(), ',');
+  }
+  split(SIZE_MAX);
+  return row.size();
+}
+
+/*
+  Retrieve the first field in the current row. Unless the row contains
+  quotes, this does not split the row.
+
+  @return
+    A view of the field's text
+
+  @example
+    CSVReader reader(is);
+    while (reader.next()) {
+      if (reader.firstField() == "W06000011") {
+        auto name = reader.field(1);
+      }
+    }
+*/
+std::string_view CSVReader::firstField() const {
+  if (row.empty() && !hasQuotes) {
+    return current.substr(0, current.find(','));
+  }
+  return field(0);
+}
+
+/*
+  Retrieve a field in the current row.
+
+  @param index
+    The zero-indexed column of the field
+
+  @return
+    A view of the field's text
+
+  @throws
+    std::out_of_range if the row does not have that many fields
+*/
+std::string_view CSVReader::field(std::size_t index) const {
+  split(index);
+  return row.at(index);
+}
+
+/*
+  Retrieve all the fields in the current row.
+
+  @return
+    A reference to the fields of the current row
+*/
+const std::vector<std::string_view>& CSVReader::fields() const {
+  split(SIZE_MAX);
+  return row;
+}
+
+/*
+  Trim leading and trailing spaces and tabs from a field.
+*/
+static std::string_view trim(std::string_view field) {
+  while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) {
+    field.remove_prefix(1);
+  }
+  while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) {
+    field.remove_suffix(1);
+  }
+  return field;
+}
+
+/*
+  Convert a field to a double without going through a std::string or the
+  locale, as std::stod would.
+
+  @param field
+    The field to convert
+
+  @return
+    The parsed value
+
+  @throws
+    std::runtime_error if the field is not a valid number, with the message:
+    CSVReader::toDouble: Invalid number <field>
+
+  @example
+    double value = CSVReader::toDouble(reader.field(1));
+*/
+double CSVReader::toDouble(std::string_view field) {
+  std::string_view trimmed = trim(field);
+  if (!trimmed.empty() && trimmed.front() == '+') {
+    trimmed.remove_prefix(1);
+  }
+
+  double value = 0;
+  auto result = std::from_chars(trimmed.data(),
+                                trimmed.data() + trimmed.size(),
+                                value);
+  if (trimmed.empty() ||
+      result.ec != std::errc() ||
+      result.ptr != trimmed.data() + trimmed.size()) {
+    throw std::runtime_error("CSVReader::toDouble: Invalid number " +
+                             std::string(field));
+  }
+  return value;
+}
+
+/*
+  Convert a field to an int without going through a std::string or the
+  locale, as std::stoi would.
+
+  @param field
+    The field to convert
+
+  @return
+    The parsed value
+
+  @throws
+    std::runtime_error if the field is not a valid integer, with the message:
+    CSVReader::toInt: Invalid integer <field>
+
+  @example
+    int year = CSVReader::toInt(reader.field(1));
+*/
+int CSVReader::toInt(std::string_view field) {
+  std::string_view trimmed = trim(field);
+  if (!trimmed.empty() && trimmed.front() == '+') {
+    trimmed.remove_prefix(1);
+  }
+
+  int value = 0;
+  auto result = std::from_chars(trimmed.data(),
+                                trimmed.data() + trimmed.size(),
+                                value);
+  if (trimmed.empty() ||
+      result.ec != std::errc() ||
+      result.ptr != trimmed.data() + trimmed.size()) {
+    throw std::runtime_error("CSVReader::toInt: Invalid integer " +
+                             std::string(field));
+  }
+  return value;
+}
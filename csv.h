@@ -0,0 +1,77 @@
+#ifndef CSV_H_
+#define CSV_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the CSVReader class, a small
+  tokenizer shared by the CSV parsers in areas.cpp.
+ */
+
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+  CSVReader splits a CSV input stream into rows of fields. Each row is read
+  into a single buffer that is reused for the whole file, and the fields are
+  returned as std::string_view instances pointing into that buffer, so no
+  memory is allocated per field or per row once the buffer has grown to the
+  length of the longest line.
+
+  Quoted fields (e.g. "Newport, City of") are supported, including escaped
+  quotes ("") and line breaks inside quotes. Trailing carriage returns are
+  stripped and blank lines are skipped.
+
+  A CSVReader can also scan an in-memory buffer (e.g. from InputMappedFile),
+  in which case unquoted fields are views straight into that buffer and only
+  rows containing quotes are copied into the internal buffer to be unescaped.
+
+  A row is only split into fields as far as the fields that are asked for,
+  so that a parser can skip a row (e.g. one for an area that is filtered
+  out) having only looked at the start of it, or skip the fields at the end
+  of a row it does not need. Rows containing quotes are split in full the
+  first time any field is needed.
+
+  The views returned by field(), firstField() and fields() are only valid
+  until the next call to next() (and, for a buffer, for as long as the
+  buffer is alive).
+*/
+class CSVReader {
+public:
+  CSVReader(std::istream& is);
+  CSVReader(std::string_view buffer);
+
+  bool next();
+
+  std::size_t offset() const;
+  std::size_t size() const;
+  std::string_view firstField() const;
+  std::string_view field(std::size_t index) const;
+  const std::vector<std::string_view>& fields() const;
+
+  static double toDouble(std::string_view field);
+  static int toInt(std::string_view field);
+
+private:
+  bool nextLine(std::string_view& text);
+  void split(std::size_t index) const;
+  void splitQuoted() const;
+
+  std::istream* is;
+  std::string_view buffer;
+  std::size_t position = 0;
+  std::string_view current;
+  bool hasQuotes = false;
+  mutable std::string line;
+  mutable std::vector<std::string_view> row;
+  mutable std::size_t splitPosition = 0;
+  mutable bool isSplit = false;
+};
+
+#endif // CSV_H_
@@ -0,0 +1,150 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the Filter class.
+ */
+
+#include <algorithm>
+
+#include "filter.h"
+#include "hash.h"
+
+/*
+  Check whether an area code is in the Shard.
+
+  @param code
+    The local authority code
+
+  @return
+    true if the code hashes to this shard (always, if there is only one)
+
+  @example
+    Shard shard{2, 4};
+    if (shard.contains("W06000011")) {
+      ...
+    }
+*/
+bool Shard::contains(std::string_view code) const {
+  if (all()) {
+    return true;
+  }
+
+  return fnv1a(code) % count == number - 1;
+}
+
+/*
+  Construct a Set that contains every value.
+*/
+Filter::Set::Set() : matchesAll(true) {}
+
+/*
+  Construct a Set of the given values, interning them. A null or empty set
+  of values contains every value, as with the filters passed to
+  Areas::populate().
+
+  @param values
+    The values, or null for every value
+
+  @param shard
+    The shard the values must also be in, e.g. for area codes
+
+  @example
+    StringFilterSet areas = {"W06000011", "W06000010"};
+    Filter::Set areaSet(&areas);
+*/
+Filter::Set::Set(const StringFilterSet* values, Shard shard)
+    : matchesAll(values == nullptr || values->empty()), shard(shard) {
+  if (!matchesAll) {
+    ids.reserve(values->size());
+    for (const auto &value : *values) {
+      ids.push_back(Symbol(value).id());
+    }
+    std::sort(ids.begin(), ids.end());
+  }
+}
+
+/*
+  Check whether the Set contains an interned value.
+
+  @param value
+    The value
+
+  @return
+    true if the Set contains every value or this one
+*/
+bool Filter::Set::contains(Symbol value) const {
+  return (matchesAll || std::binary_search(ids.begin(), ids.end(), value.id())) &&
+         shard.contains(value.str());
+}
+
+/*
+  Check whether the Set contains a value given as text, without interning
+  the text unless it passes.
+
+  @param value
+    The value
+
+  @return
+    The interned value if the Set contains it, or no value otherwise
+
+  @example
+    auto code = filter.areas().find(reader.firstField());
+    if (!code) {
+      continue;
+    }
+*/
+std::optional<Symbol> Filter::Set::find(std::string_view value) const {
+  if (!shard.contains(value)) {
+    return std::nullopt;
+  }
+  if (matchesAll) {
+    return Symbol(value);
+  }
+  auto symbol = Symbol::find(value);
+  if (symbol && contains(*symbol)) {
+    return symbol;
+  }
+  return std::nullopt;
+}
+
+/*
+  Construct a Filter that lets everything through.
+*/
+Filter::Filter() : firstYear(0), lastYear(0) {}
+
+/*
+  Compile the areas, measures and years filters into a Filter.
+
+  @param areas
+    The areas to import, or null or an empty set for all areas
+
+  @param measures
+    The measures to import (in lowercase), or null or an empty set for all
+    measures
+
+  @param years
+    The inclusive range of years to import, or null or a range with a 0 in
+    it for all years
+
+  @param shard
+    The shard of the areas to import, or the default Shard for all of them
+
+  @example
+    auto areasFilter = BethYw::parseAreasArg(args, index);
+    auto measuresFilter = BethYw::parseMeasuresArg(args, index, dir);
+    auto yearsFilter = BethYw::parseYearsArg(args);
+
+    Filter filter(&areasFilter, &measuresFilter, &yearsFilter);
+*/
+Filter::Filter(const StringFilterSet* areas,
+               const StringFilterSet* measures,
+               const YearFilterTuple* years,
+               Shard shard)
+    : areaSet(areas, shard),
+      measureSet(measures),
+      firstYear(years == nullptr ? 0 : std::get<0>(*years)),
+      lastYear(years == nullptr ? 0 : std::get<1>(*years)) {}
@@ -0,0 +1,108 @@
+#ifndef FILTER_H_
+#define FILTER_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the Filter class, which decides
+  which areas, measures and years are imported from the datasets.
+ */
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "symbol.h"
+
+/*
+  An alias for filters based on strings such as categorisations e.g. area,
+  and measures.
+*/
+using StringFilterSet = std::unordered_set<std::string>;
+
+/*
+  An alias for a year filter.
+*/
+using YearFilterTuple = std::tuple<unsigned int, unsigned int>;
+
+/*
+  One of a number of shards that the areas are split between, so that
+  separate imports (e.g. on different machines, with --shard) each import
+  only their own areas. Shards are numbered from 1 to `count`, and an area
+  is in the shard its code hashes to (with 64-bit FNV-1a, which gives the
+  same shard on every platform), so each area is in exactly one of them.
+*/
+struct Shard {
+  unsigned int number = 1;
+  unsigned int count = 1;
+
+  bool all() const { return count <= 1; }
+  bool contains(std::string_view code) const;
+};
+
+/*
+  A Filter is the compiled form of the areas, measures and years filters,
+  built once (e.g. by BethYw::run()) and shared by every parser, including
+  parsers running on different threads.
+
+  The areas and measures are interned and kept as a sorted vector of Symbol
+  ids, so checking a row's (interned) code is a binary search over
+  integers. A code that has never been interned cannot be in the filter,
+  which lets parsers reject a row from its raw text without interning it.
+
+  The year range is inclusive. As documented by BethYw::parseYearsArg(), if
+  either end of the range is 0 every year is imported.
+
+  The areas can also be limited to one Shard, in which case an area must be
+  both in the areas filter and in the shard.
+*/
+class Filter {
+public:
+  /*
+    The set of values (area or measure codes) a Filter lets through.
+  */
+  class Set {
+  public:
+    Set();
+    explicit Set(const StringFilterSet* values, Shard shard = Shard());
+
+    bool all() const { return matchesAll && shard.all(); }
+    bool contains(Symbol value) const;
+    std::optional<Symbol> find(std::string_view value) const;
+
+  private:
+    bool matchesAll;
+    std::vector<std::uintptr_t> ids;
+    Shard shard;
+  };
+
+  Filter();
+  Filter(const StringFilterSet* areas,
+         const StringFilterSet* measures,
+         const YearFilterTuple* years,
+         Shard shard = Shard());
+
+  const Set& areas() const { return areaSet; }
+  const Set& measures() const { return measureSet; }
+
+  bool allYears() const { return firstYear == 0 || lastYear == 0; }
+  bool matchesYear(unsigned int year) const {
+    return allYears() || (year >= firstYear && year <= lastYear);
+  }
+
+private:
+  Set areaSet;
+  Set measureSet;
+  unsigned int firstYear;
+  unsigned int lastYear;
+};
+
+#endif // FILTER_H_
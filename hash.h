@@ -0,0 +1,41 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the FNV-1a hash, which the files' fingerprints, the
+  snapshot checksum and the shards of --shard are all computed with.
+ */
+
+#include <cstdint>
+#include <string_view>
+
+/*
+  Calculate the 64-bit FNV-1a hash of a string of bytes. It is the same on
+  every platform and in every run, unlike std::hash, so it can be stored in
+  files and agreed on by several machines.
+
+  @param data
+    The bytes to hash
+
+  @return
+    The hash
+
+  @example
+    std::uint64_t hash = fnv1a("W06000011");
+*/
+inline std::uint64_t fnv1a(std::string_view data) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+#endif // HASH_H_
@@ -6,14 +6,39 @@
   AUTHOR: <Sacad Muhumed>
 
   This file contains the code responsible for opening and closing file
-  streams. The actual handling of the data from that stream is handled
+  streams, decompressing compressed files, and for fingerprinting files. The actual handling of the data from that stream is handled
   by the functions in areas.cpp.
  */
 
+#include "hash.h"
 #include "input.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
 #include <istream>
 #include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#ifdef BETHYW_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef BETHYW_ZSTD
+#include <zstd.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 /*
   Constructor for an InputSource.
@@ -34,17 +59,259 @@ const std::string& InputSource::getSource() const {
 }
 
 
+/*
+  A stream buffer over the contents of a file, which a thread of its own
+  produces a block at a time (by reading the file, or decompressing it)
+  into a bounded queue, ahead of whatever reads the stream. The reading
+  thread takes a block at a time from the front of the queue, and hands the
+  blocks it has finished with back to be refilled, so once the queue is
+  full no more memory is allocated.
+
+  An error while producing the blocks is thrown to the reader once it has
+  read every block produced before it.
+*/
+class ReadAheadBuffer : public std::streambuf {
+public:
+  /*
+    Fills the buffer, by passing blocks from emptyBlock() to push() until
+    the file ends or push() returns false
+  */
+  using Producer = void (*)(ReadAheadBuffer& buffer);
+
+  ReadAheadBuffer(const std::string& path,
+                  const char* source,
+                  std::size_t blockSize,
+                  std::size_t maxBlocks,
+                  Producer produce);
+  ~ReadAheadBuffer();
+
+  const std::string& getPath() const { return path; }
+  std::size_t readFile(char* data, std::size_t size);
+  std::string emptyBlock();
+  bool push(std::string& block, std::size_t size);
+
+  std::uint64_t bytesRead() const {
+    return fileBytes.load(std::memory_order_relaxed);
+  }
+
+protected:
+  int_type underflow() override;
+
+private:
+  void run(Producer produce);
+
+  const std::string path;
+  const std::size_t blockSize;
+  const std::size_t maxBlocks;
+  std::ifstream fileStream;
+  std::atomic<std::uint64_t> fileBytes{0};
+
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::deque<std::string> blocks;
+  std::vector<std::string> spare;
+  bool finished = false;
+  bool cancelled = false;
+  std::exception_ptr error;
+
+  std::string current;
+  std::thread worker;
+};
+
+/*
+  Open a file and start producing its blocks.
+
+  @param path
+    The path of the file
+
+  @param source
+    The class opening the file, for the message if it cannot be opened
+
+  @param blockSize
+    The size of each block
+
+  @param maxBlocks
+    The most blocks produced ahead of the reader
+
+  @param produce
+    The function producing the blocks, which is run on the new thread
+
+  @throws
+    std::runtime_error if the file cannot be opened, with the message:
+    <source>::open: Failed to open file <file name>
+*/
+ReadAheadBuffer::ReadAheadBuffer(const std::string& path,
+                                 const char* source,
+                                 std::size_t blockSize,
+                                 std::size_t maxBlocks,
+                                 Producer produce)
+    : path(path),
+      blockSize(blockSize),
+      maxBlocks(maxBlocks),
+      fileStream(path, std::ios::binary) {
+  if (!fileStream.is_open()) {
+    throw std::runtime_error(std::string(source) + "::open: Failed to open file " + path);
+  }
+  worker = std::thread(&ReadAheadBuffer::run, this, produce);
+}
+
+/*
+  Stop producing blocks (if the reader stopped before the end of the file)
+  and wait for the thread to finish.
+*/
+ReadAheadBuffer::~ReadAheadBuffer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+  }
+  notFull.notify_all();
+  worker.join();
+}
+
+/*
+  Make the next block the readable area, waiting for it to be produced if
+  need be.
+*/
+ReadAheadBuffer::int_type ReadAheadBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!current.empty()) {
+    spare.push_back(std::move(current));
+    current = std::string();
+  }
+  notEmpty.wait(lock, [this] { return !blocks.empty() || finished; });
+  if (blocks.empty()) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return traits_type::eof();
+  }
+
+  current = std::move(blocks.front());
+  blocks.pop_front();
+  lock.unlock();
+  notFull.notify_one();
+
+  char* data = current.data();
+  setg(data, data, data + current.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+/*
+  The body of the producing thread.
+*/
+void ReadAheadBuffer::run(Producer produce) {
+  try {
+    produce(*this);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex);
+    error = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  notEmpty.notify_all();
+}
+
+/*
+  Read the next part of the file, counting its size.
+
+  @return
+    The number of bytes read, which is less than `size` only at the end of
+    the file
+*/
+std::size_t ReadAheadBuffer::readFile(char* data, std::size_t size) {
+  fileStream.read(data, size);
+  const std::size_t length = fileStream.gcount();
+  if (length < size && fileStream.bad()) {
+    throw std::runtime_error("Failed to read file " + path);
+  }
+  fileBytes.fetch_add(length, std::memory_order_relaxed);
+  return length;
+}
+
+/*
+  A block to fill, of the buffer's block size, reusing one the reader has
+  finished with where there is one.
+*/
+std::string ReadAheadBuffer::emptyBlock() {
+  std::string block;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!spare.empty()) {
+      block = std::move(spare.back());
+      spare.pop_back();
+    }
+  }
+  block.resize(blockSize);
+  return block;
+}
+
+/*
+  Queue the first `size` bytes of a block for the reader, waiting while the
+  queue is full.
+
+  @return
+    false if the reader has gone, and producing blocks should stop
+*/
+bool ReadAheadBuffer::push(std::string& block, std::size_t size) {
+  block.resize(size);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this] { return blocks.size() < maxBlocks || cancelled; });
+    if (cancelled) {
+      return false;
+    }
+    blocks.push_back(std::move(block));
+  }
+  notEmpty.notify_one();
+  return true;
+}
+
+/*
+  Produce the blocks of an uncompressed file by reading it, a whole block
+  per read.
+*/
+static void readAhead(ReadAheadBuffer& buffer) {
+  while (true) {
+    std::string block = buffer.emptyBlock();
+    const std::size_t size = block.size();
+    const std::size_t length = buffer.readFile(&block[0], size);
+    if (length == 0 || !buffer.push(block, length) || length < size) {
+      return;
+    }
+  }
+}
+
 /*
   Constructor for a file-based source.
 
   @param path
     The complete path for a file to import.
+
+  @param mode
+    How to read the file: through an std::ifstream (BUFFERED), or in large
+    blocks read ahead by a thread of its own (READ_AHEAD)
+*/
+InputFile::InputFile(const std::string& filePath, Mode mode)
+    : InputSource(filePath), mode(mode) {}
+
+/*
+  Stops reading the file ahead, if it is still being read.
 */
-InputFile::InputFile(const std::string& filePath) : InputSource(filePath) {}
+InputFile::~InputFile() = default;
 
 /*
   Opens a file stream to the file path retrievable from getSource()
-  and returns a reference to the stream.
+  and returns a reference to the stream. In READ_AHEAD mode, this starts the
+  thread reading the file, and an error reading it is thrown as
+  std::runtime_error from reading the stream.
 
   @return
     A standard input stream reference
@@ -58,9 +325,481 @@ InputFile::InputFile(const std::string& filePath) : InputSource(filePath) {}
     input.open();
 */
 std::istream& InputFile::open() {
+  if (mode == READ_AHEAD) {
+    readAheadStream.exceptions(std::ios::goodbit);
+    readAheadStream.rdbuf(nullptr);
+    buffer.reset();
+    buffer = std::make_unique<ReadAheadBuffer>(getSource(), "InputFile",
+                                               READ_AHEAD_BLOCK_SIZE,
+                                               READ_AHEAD_BLOCKS, readAhead);
+
+    // Errors reading the file are thrown, rather than ending the stream early
+    readAheadStream.rdbuf(buffer.get());
+    readAheadStream.exceptions(std::ios::badbit);
+    return readAheadStream;
+  }
+
   fileStream.open(getSource());
   if (!fileStream.is_open()) {
     throw std::runtime_error("InputFile::open: Failed to open file " + getSource());
   }
   return fileStream;
-}
\ No newline at end of file
+}
+
+/*
+  The number of bytes of the file read ahead so far.
+
+  @return
+    The number of bytes read by the read-ahead thread, or 0 if the file is
+    not being read ahead
+*/
+std::uint64_t InputFile::bytesRead() const {
+  return buffer ? buffer->bytesRead() : 0;
+}
+
+
+/*
+  Constructor for a memory-mapped file source. The file is not opened until
+  open() is called.
+
+  @param path
+    The complete path for a file to import.
+*/
+InputMappedFile::InputMappedFile(const std::string& filePath)
+    : InputSource(filePath) {}
+
+/*
+  Unmaps the file, if it was mapped.
+*/
+InputMappedFile::~InputMappedFile() {
+  close();
+}
+
+/*
+  Maps the file at the path retrievable from getSource() into memory and
+  returns a view of its contents. If the file cannot be mapped, it is read
+  into memory with an std::ifstream instead. The view remains valid for the
+  lifetime of this object, or until open() is called again.
+
+  @return
+    A read-only view over the whole file
+
+  @throws
+    std::runtime_error if there is an issue opening the file, with the message:
+    InputMappedFile::open: Failed to open file <file name>
+
+  @example
+    InputMappedFile input("data/areas.csv");
+    std::string_view contents = input.open();
+*/
+std::string_view InputMappedFile::open() {
+  close();
+
+#ifndef _WIN32
+  int fd = ::open(getSource().c_str(), O_RDONLY);
+  if (fd != -1) {
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+      void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        madvise(addr, info.st_size, MADV_SEQUENTIAL);
+        mappedData = static_cast<const char*>(addr);
+        mappedSize = info.st_size;
+      }
+    }
+    ::close(fd);
+    if (mappedData != nullptr) {
+      return std::string_view(mappedData, mappedSize);
+    }
+  }
+#endif
+
+  // Fall back to reading the whole file through a stream
+  std::ifstream fileStream(getSource(), std::ios::binary);
+  if (!fileStream.is_open()) {
+    throw std::runtime_error("InputMappedFile::open: Failed to open file " + getSource());
+  }
+  fileContents.assign(std::istreambuf_iterator<char>(fileStream),
+                      std::istreambuf_iterator<char>());
+  return std::string_view(fileContents);
+}
+
+/*
+  Whether the file is currently memory mapped, rather than having been read
+  into memory through the fallback path.
+
+  @return
+    true if the contents returned by open() are memory mapped
+*/
+bool InputMappedFile::isMapped() const {
+  return mappedData != nullptr;
+}
+
+/*
+  Releases the mapping or buffer from a previous call to open().
+*/
+void InputMappedFile::close() {
+#ifndef _WIN32
+  if (mappedData != nullptr) {
+    munmap(const_cast<char*>(mappedData), mappedSize);
+  }
+#endif
+  mappedData = nullptr;
+  mappedSize = 0;
+  fileContents.clear();
+}
+
+
+/*
+  Find the compression of a file from its first bytes (the magic numbers of
+  the gzip and zstd formats). A file too short to tell, or that cannot be
+  read, is taken to be compressed if its extension is .gz or .zst.
+
+  @param path
+    The path of the file
+
+  @return
+    The compression of the file, or Compression::NONE
+
+  @example
+    if (detectCompression(path) != Compression::NONE) {
+      InputCompressedFile input(path);
+      ...
+    }
+*/
+Compression detectCompression(const std::string& path) {
+  unsigned char magic[4] = {0, 0, 0, 0};
+  std::ifstream fileStream(path, std::ios::binary);
+  fileStream.read(reinterpret_cast<char*>(magic), sizeof(magic));
+  const std::streamsize length = fileStream.gcount();
+
+  if (length >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return Compression::GZIP;
+  }
+  if (length == 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+      magic[2] == 0x2f && magic[3] == 0xfd) {
+    return Compression::ZSTD;
+  }
+  if (length < 4) {
+    const std::string extension = std::filesystem::path(path).extension().string();
+    if (extension == ".gz") {
+      return Compression::GZIP;
+    }
+    if (extension == ".zst") {
+      return Compression::ZSTD;
+    }
+  }
+  return Compression::NONE;
+}
+
+/*
+  Find the file to read for a source file: the file itself if it exists,
+  otherwise a compressed copy of it with the extension .gz or .zst (e.g.
+  datasets/popu1009.json.gz for datasets/popu1009.json).
+
+  @param path
+    The path of the uncompressed file
+
+  @return
+    The path of the file to read, which is `path` if neither it nor a
+    compressed copy exists (so that opening it reports the expected file)
+
+  @example
+    InputMappedFile input(findInputFile("datasets/popu1009.json"));
+*/
+std::string findInputFile(const std::string& path) {
+  std::error_code error;
+  if (std::filesystem::exists(path, error)) {
+    return path;
+  }
+  for (const char* extension : {".gz", ".zst"}) {
+    std::string compressed = path + extension;
+    if (std::filesystem::exists(compressed, error)) {
+      return compressed;
+    }
+  }
+  return path;
+}
+
+// The size of each read from a compressed file
+static constexpr std::size_t COMPRESSED_READ_SIZE = 64 * 1024;
+
+#ifdef BETHYW_ZLIB
+/*
+  Produce the blocks of a gzip file by decompressing it. The file may have
+  several members one after another (as written by e.g. pigz, or by
+  concatenating .gz files).
+*/
+static void inflateGzip(ReadAheadBuffer& buffer) {
+  z_stream inflater{};
+  if (inflateInit2(&inflater, 15 + 16) != Z_OK) {
+    throw std::runtime_error("InputCompressedFile: Failed to start decompressing " + buffer.getPath());
+  }
+  struct End {
+    z_stream& inflater;
+    ~End() { inflateEnd(&inflater); }
+  } end{inflater};
+
+  std::vector<char> input(COMPRESSED_READ_SIZE);
+  std::string block = buffer.emptyBlock();
+  const std::size_t blockSize = block.size();
+  std::size_t filled = 0;
+  bool memberEnded = false;
+
+  while (true) {
+    if (inflater.avail_in == 0) {
+      const std::size_t length = buffer.readFile(input.data(), input.size());
+      if (length == 0) {
+        break;
+      }
+      inflater.next_in = reinterpret_cast<Bytef*>(input.data());
+      inflater.avail_in = static_cast<uInt>(length);
+    }
+
+    inflater.next_out = reinterpret_cast<Bytef*>(&block[filled]);
+    inflater.avail_out = static_cast<uInt>(blockSize - filled);
+    const int status = inflate(&inflater, Z_NO_FLUSH);
+    filled = blockSize - inflater.avail_out;
+
+    if (status == Z_STREAM_END) {
+      memberEnded = true;
+      inflateReset(&inflater);
+    } else if (status == Z_OK) {
+      memberEnded = false;
+    } else if (status != Z_BUF_ERROR) {
+      throw std::runtime_error("InputCompressedFile: Invalid gzip data in " + buffer.getPath() +
+                               (inflater.msg ? std::string(": ") + inflater.msg : ""));
+    }
+
+    if (filled == blockSize) {
+      if (!buffer.push(block, filled)) {
+        return;
+      }
+      block = buffer.emptyBlock();
+      filled = 0;
+    }
+  }
+
+  if (!memberEnded) {
+    throw std::runtime_error("InputCompressedFile: Unexpected end of gzip data in " + buffer.getPath());
+  }
+  if (filled > 0) {
+    buffer.push(block, filled);
+  }
+}
+#endif
+
+#ifdef BETHYW_ZSTD
+/*
+  Produce the blocks of a zstd file by decompressing it. The file may have
+  several frames one after another.
+*/
+static void decompressZstd(ReadAheadBuffer& buffer) {
+  ZSTD_DStream* decompressor = ZSTD_createDStream();
+  if (decompressor == nullptr || ZSTD_isError(ZSTD_initDStream(decompressor))) {
+    ZSTD_freeDStream(decompressor);
+    throw std::runtime_error("InputCompressedFile: Failed to start decompressing " + buffer.getPath());
+  }
+  struct End {
+    ZSTD_DStream* decompressor;
+    ~End() { ZSTD_freeDStream(decompressor); }
+  } end{decompressor};
+
+  std::vector<char> input(COMPRESSED_READ_SIZE);
+  std::string block = buffer.emptyBlock();
+  const std::size_t blockSize = block.size();
+  std::size_t filled = 0;
+  std::size_t frameRemaining = 0;
+  bool anyInput = false;
+
+  while (true) {
+    const std::size_t length = buffer.readFile(input.data(), input.size());
+    if (length == 0) {
+      break;
+    }
+    ZSTD_inBuffer in{input.data(), length, 0};
+
+    // Keep going while the block fills up, to flush what zstd has buffered
+    bool full = false;
+    do {
+      ZSTD_outBuffer out{&block[0], blockSize, filled};
+      const std::size_t status = ZSTD_decompressStream(decompressor, &out, &in);
+      if (ZSTD_isError(status)) {
+        throw std::runtime_error("InputCompressedFile: Invalid zstd data in " + buffer.getPath() +
+                                 ": " + ZSTD_getErrorName(status));
+      }
+      frameRemaining = status;
+      filled = out.pos;
+
+      full = filled == blockSize;
+      if (full) {
+        if (!buffer.push(block, filled)) {
+          return;
+        }
+        block = buffer.emptyBlock();
+        filled = 0;
+      }
+    } while (in.pos < in.size || full);
+    anyInput = true;
+  }
+
+  if (!anyInput || frameRemaining != 0) {
+    throw std::runtime_error("InputCompressedFile: Unexpected end of zstd data in " + buffer.getPath());
+  }
+  if (filled > 0) {
+    buffer.push(block, filled);
+  }
+}
+#endif
+
+/*
+  Constructor for a compressed file source. The file is not opened until
+  open() is called.
+
+  @param path
+    The complete path for a file to import.
+*/
+InputCompressedFile::InputCompressedFile(const std::string& filePath)
+    : InputSource(filePath) {}
+
+/*
+  Stops decompressing the file, if it is still being decompressed.
+*/
+InputCompressedFile::~InputCompressedFile() = default;
+
+/*
+  Opens the compressed file at the path retrievable from getSource(), starts
+  decompressing it on a thread of its own, and returns a stream of its
+  decompressed contents. An error in the compressed data (or a format this
+  build does not support) is thrown as std::runtime_error from reading the
+  stream.
+
+  @return
+    A standard input stream reference
+
+  @throws
+    std::runtime_error if there is an issue opening the file, with the message:
+    InputCompressedFile::open: Failed to open file <file name>
+    or if this build cannot decompress the file's format
+
+  @example
+    InputCompressedFile input("data/popu1009.json.gz");
+    input.open();
+*/
+std::istream& InputCompressedFile::open() {
+  stream.exceptions(std::ios::goodbit);
+  stream.rdbuf(nullptr);
+  buffer.reset();
+
+  Compression compression = detectCompression(getSource());
+  if (compression == Compression::NONE) {
+    compression = Compression::GZIP;
+  }
+  ReadAheadBuffer::Producer produce = nullptr;
+#ifdef BETHYW_ZLIB
+  if (compression == Compression::GZIP) {
+    produce = inflateGzip;
+  }
+#endif
+#ifdef BETHYW_ZSTD
+  if (compression == Compression::ZSTD) {
+    produce = decompressZstd;
+  }
+#endif
+  if (produce == nullptr) {
+    throw std::runtime_error("InputCompressedFile::open: " + getSource() + " is " +
+                             (compression == Compression::GZIP ? "gzip" : "zstd") +
+                             " compressed, which this build cannot read");
+  }
+  buffer = std::make_unique<ReadAheadBuffer>(getSource(), "InputCompressedFile",
+                                             BLOCK_SIZE, MAX_BLOCKS, produce);
+
+  // Errors reading the stream are thrown, rather than ending it early
+  stream.rdbuf(buffer.get());
+  stream.exceptions(std::ios::badbit);
+  return stream;
+}
+
+/*
+  The number of bytes of the compressed file read so far.
+
+  @return
+    The number of compressed bytes read, or 0 if the file is not open
+*/
+std::uint64_t InputCompressedFile::bytesRead() const {
+  return buffer ? buffer->bytesRead() : 0;
+}
+
+
+/*
+  Calculate the 64-bit FNV-1a hash of a file's contents.
+*/
+static std::uint64_t hashFile(const std::string& path) {
+  InputMappedFile input(path);
+  return fnv1a(input.open());
+}
+
+/*
+  Retrieve the modification time of a file as a plain integer.
+*/
+static std::int64_t modifiedTime(const std::string& path) {
+  return std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+/*
+  Take the fingerprint of a file as it is now.
+
+  @param path
+    The path of the file
+
+  @return
+    The file's size, modification time and hash
+
+  @throws
+    std::runtime_error if the file cannot be read
+
+  @example
+    auto fingerprint = SourceFingerprint::of("datasets/popu1009.json");
+*/
+SourceFingerprint SourceFingerprint::of(const std::string& path) {
+  SourceFingerprint fingerprint;
+  fingerprint.path = path;
+
+  std::error_code error;
+  fingerprint.size = std::filesystem::file_size(path, error);
+  if (error) {
+    throw std::runtime_error("SourceFingerprint::of: Failed to open file " + path);
+  }
+  fingerprint.modified = modifiedTime(path);
+  fingerprint.hash = hashFile(path);
+  return fingerprint;
+}
+
+/*
+  Check whether the file still has the contents it had when the fingerprint
+  was taken. A different size always means the file has changed. If the
+  size and modification time are both the same, the file is assumed not to
+  have changed; otherwise (e.g. the file was touched or copied) the decision
+  is made by hashing the file again.
+
+  @return
+    true if the file is unchanged, false if it has changed or is missing
+*/
+bool SourceFingerprint::matchesFile() const {
+  std::error_code error;
+  auto currentSize = std::filesystem::file_size(path, error);
+  if (error || currentSize != size) {
+    return false;
+  }
+
+  auto currentModified = std::filesystem::last_write_time(path, error);
+  if (!error && currentModified.time_since_epoch().count() == modified) {
+    return true;
+  }
+
+  try {
+    return hashFile(path) == hash;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
@@ -9,12 +9,21 @@
   AUTHOR: <Sacad Muhumed>
 
   This file contains declarations for the input source handlers. There are
-  two classes: InputSource and InputFile. InputSource is abstract (i.e. it
-  contains a pure virtual function). InputFile is a concrete derivation of
-  InputSource, for input from files.
+  four classes: InputSource, InputFile, InputMappedFile and
+  InputCompressedFile. InputSource is abstract (i.e. it contains a pure
+  virtual function). InputFile and InputMappedFile are concrete derivations
+  of InputSource, for input from files as a stream or as a single buffer
+  respectively, and InputCompressedFile is one for input from gzip or zstd
+  compressed files as a stream. SourceFingerprint records the state of an
+  input file, to tell whether it has changed.
  */
 
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <fstream>
 
 /*
@@ -32,19 +41,129 @@ protected:
   std::string source;
 };
 
+class ReadAheadBuffer;
+
 /*
   Source data that is contained within a file. For now, our application will
   only work with files.
+
+  By default the file is read through an std::ifstream, which refills its
+  buffer (and waits for the storage) whenever the reader reaches the end of
+  it. In READ_AHEAD mode a thread of its own instead reads the file in large
+  blocks, keeping a few blocks ahead of the reader, so the latency of the
+  storage (e.g. a network filesystem) is hidden behind the work of parsing
+  the blocks already read.
 */
 class InputFile : public InputSource {
 public:
-  InputFile(const std::string& filePath);
+  /*
+    The ways of reading the file
+  */
+  enum Mode { BUFFERED, READ_AHEAD };
+
+  // The size of each block read ahead
+  static constexpr std::size_t READ_AHEAD_BLOCK_SIZE = 1024 * 1024;
+
+  // The most blocks read ahead of the reader, besides the one it is reading
+  static constexpr std::size_t READ_AHEAD_BLOCKS = 2;
+
+  InputFile(const std::string& filePath, Mode mode = BUFFERED);
+  ~InputFile();
+
+  InputFile(const InputFile&) = delete;
+  InputFile& operator=(const InputFile&) = delete;
 
   std::istream& open();
+  std::uint64_t bytesRead() const;
 
 private:
+  Mode mode;
   std::ifstream fileStream;
+  std::unique_ptr<ReadAheadBuffer> buffer;
+  std::istream readAheadStream{nullptr};
+};
+
+/*
+  Source data that is contained within a file, exposed as one contiguous
+  read-only buffer instead of a stream. Where possible the file is memory
+  mapped, so the parsers scan the page cache directly; otherwise (e.g. on
+  Windows, or for empty files) the file is read into memory through an
+  std::ifstream.
+*/
+class InputMappedFile : public InputSource {
+public:
+  InputMappedFile(const std::string& filePath);
+  ~InputMappedFile();
+
+  InputMappedFile(const InputMappedFile&) = delete;
+  InputMappedFile& operator=(const InputMappedFile&) = delete;
+
+  std::string_view open();
+  bool isMapped() const;
+
+private:
+  void close();
+
+  const char* mappedData = nullptr;
+  std::size_t mappedSize = 0;
+  std::string fileContents;
+};
+
+/*
+  The ways a source file can be compressed
+*/
+enum class Compression { NONE, GZIP, ZSTD };
+
+Compression detectCompression(const std::string& path);
+std::string findInputFile(const std::string& path);
+
+/*
+  Source data that is contained within a gzip (.gz) or zstd (.zst)
+  compressed file, exposed as a stream of its decompressed contents.
+
+  The file is decompressed a block at a time on a thread of its own, a few
+  blocks ahead of whatever reads the stream, so decompressing the file
+  overlaps with parsing it and the whole file is never held in memory.
+
+  Each format is only supported if the program was built with its library
+  (zlib for gzip, libzstd for zstd), which build.sh does wherever they are
+  installed. Reading a file in any other format throws std::runtime_error.
+*/
+class InputCompressedFile : public InputSource {
+public:
+  // The size of each block of decompressed data
+  static constexpr std::size_t BLOCK_SIZE = 256 * 1024;
+
+  // The most blocks decompressed ahead of the reader
+  static constexpr std::size_t MAX_BLOCKS = 4;
+
+  InputCompressedFile(const std::string& filePath);
+  ~InputCompressedFile();
+
+  InputCompressedFile(const InputCompressedFile&) = delete;
+  InputCompressedFile& operator=(const InputCompressedFile&) = delete;
+
+  std::istream& open();
+  std::uint64_t bytesRead() const;
+
+private:
+  std::unique_ptr<ReadAheadBuffer> buffer;
+  std::istream stream{nullptr};
 };
 
+/*
+  Identifies the contents of a source file at a point in time (e.g. when a
+  Snapshot was taken), so that anything derived from the file can be
+  discarded once the file changes.
+*/
+struct SourceFingerprint {
+  std::string path;
+  std::uint64_t size = 0;
+  std::int64_t modified = 0;
+  std::uint64_t hash = 0;
+
+  static SourceFingerprint of(const std::string& path);
+  bool matchesFile() const;
+};
 
 #endif // INPUT_H_
\ No newline at end of file
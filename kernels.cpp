@@ -0,0 +1,254 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the batch kernels declared in
+  kernels.h. On x86 processors the values are summarised two (SSE2) or four
+  (AVX) at a time, with NaN entries masked out of every lane; elsewhere, and
+  for the few values left over at the end, a scalar loop is used. The AVX
+  kernel is compiled for AVX on its own and is only used if the processor
+  supports it, so the program still runs on older processors.
+ */
+
+#include <cmath>
+#include <limits>
+
+#include "kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BETHYW_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(BETHYW_HAVE_SSE2) && defined(__GNUC__)
+#define BETHYW_HAVE_AVX 1
+#include <immintrin.h>
+#endif
+
+/*
+  The partial results of a kernel, before they are combined into a
+  SeriesStats.
+*/
+struct Accumulator {
+  std::size_t count = 0;
+  double sum = 0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+};
+
+/*
+  Add values[start] to values[length - 1] to an accumulator one at a time,
+  skipping NaN values.
+*/
+static void accumulateScalar(Accumulator &acc,
+                             const double* values,
+                             std::size_t start,
+                             std::size_t length) {
+  for (std::size_t i = start; i < length; i++) {
+    const double value = values[i];
+    if (std::isnan(value)) {
+      continue;
+    }
+    acc.count++;
+    acc.sum += value;
+    if (value < acc.min) {
+      acc.min = value;
+    }
+    if (value > acc.max) {
+      acc.max = value;
+    }
+  }
+}
+
+/*
+  Turn the partial results of a kernel into a SeriesStats. The difference is
+  between the first and last values that are not NaN, and the percentage
+  difference is 0 if the first value is 0, as with Measure.
+*/
+static BethYw::SeriesStats finish(const Accumulator &acc,
+                                  const double* values,
+                                  std::size_t length) {
+  BethYw::SeriesStats stats;
+  stats.count = acc.count;
+  if (acc.count == 0) {
+    return stats;
+  }
+
+  stats.sum = acc.sum;
+  stats.mean = acc.sum / acc.count;
+  stats.min = acc.min;
+  stats.max = acc.max;
+
+  std::size_t first = 0;
+  while (std::isnan(values[first])) {
+    first++;
+  }
+  std::size_t last = length - 1;
+  while (std::isnan(values[last])) {
+    last--;
+  }
+
+  if (acc.count > 1) {
+    stats.difference = values[last] - values[first];
+  }
+  if (values[first] != 0) {
+    stats.differencePercentage =
+        (values[last] - values[first]) / values[first] * 100;
+  }
+  return stats;
+}
+
+/*
+  Count the set bits of a lane mask from _mm_movemask_pd/_mm256_movemask_pd.
+*/
+static unsigned int countLanes(int mask) {
+  unsigned int lanes = 0;
+  for (; mask != 0; mask &= mask - 1) {
+    lanes++;
+  }
+  return lanes;
+}
+
+#ifdef BETHYW_HAVE_SSE2
+/*
+  Summarise values two at a time with SSE2. Each lane keeps its own sum,
+  minimum and maximum, with NaN values replaced by 0, +infinity and
+  -infinity respectively, and the lanes are combined at the end.
+*/
+static Accumulator accumulateSSE2(const double* values, std::size_t length) {
+  const __m128d positiveInfinity = _mm_set1_pd(std::numeric_limits<double>::infinity());
+  const __m128d negativeInfinity = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+  __m128d sum = _mm_setzero_pd();
+  __m128d min = positiveInfinity;
+  __m128d max = negativeInfinity;
+
+  Accumulator acc;
+  std::size_t i = 0;
+  for (; i + 2 <= length; i += 2) {
+    const __m128d value = _mm_loadu_pd(values + i);
+    const __m128d ordered = _mm_cmpord_pd(value, value);
+    const __m128d kept = _mm_and_pd(ordered, value);
+
+    sum = _mm_add_pd(sum, kept);
+    min = _mm_min_pd(min, _mm_or_pd(kept, _mm_andnot_pd(ordered, positiveInfinity)));
+    max = _mm_max_pd(max, _mm_or_pd(kept, _mm_andnot_pd(ordered, negativeInfinity)));
+    acc.count += countLanes(_mm_movemask_pd(ordered));
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, sum);
+  acc.sum = lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, min);
+  acc.min = std::fmin(lanes[0], lanes[1]);
+  _mm_storeu_pd(lanes, max);
+  acc.max = std::fmax(lanes[0], lanes[1]);
+
+  accumulateScalar(acc, values, i, length);
+  return acc;
+}
+#endif
+
+#ifdef BETHYW_HAVE_AVX
+/*
+  Summarise values four at a time with AVX, as accumulateSSE2() does.
+*/
+__attribute__((target("avx")))
+static Accumulator accumulateAVX(const double* values, std::size_t length) {
+  const __m256d positiveInfinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+  const __m256d negativeInfinity = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+  __m256d sum = _mm256_setzero_pd();
+  __m256d min = positiveInfinity;
+  __m256d max = negativeInfinity;
+
+  Accumulator acc;
+  std::size_t i = 0;
+  for (; i + 4 <= length; i += 4) {
+    const __m256d value = _mm256_loadu_pd(values + i);
+    const __m256d ordered = _mm256_cmp_pd(value, value, _CMP_ORD_Q);
+    const __m256d kept = _mm256_and_pd(ordered, value);
+
+    sum = _mm256_add_pd(sum, kept);
+    min = _mm256_min_pd(min, _mm256_blendv_pd(positiveInfinity, value, ordered));
+    max = _mm256_max_pd(max, _mm256_blendv_pd(negativeInfinity, value, ordered));
+    acc.count += countLanes(_mm256_movemask_pd(ordered));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, sum);
+  acc.sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  _mm256_storeu_pd(lanes, min);
+  acc.min = std::fmin(std::fmin(lanes[0], lanes[1]), std::fmin(lanes[2], lanes[3]));
+  _mm256_storeu_pd(lanes, max);
+  acc.max = std::fmax(std::fmax(lanes[0], lanes[1]), std::fmax(lanes[2], lanes[3]));
+
+  accumulateScalar(acc, values, i, length);
+  return acc;
+}
+
+/*
+  Check (once) whether the processor supports AVX.
+*/
+static bool hasAVX() {
+  static const bool supported = __builtin_cpu_supports("avx");
+  return supported;
+}
+#endif
+
+/*
+  Summarise a series of values, skipping any that are NaN (e.g. the years in
+  a Measure's contiguous values that have no value), using the widest SIMD
+  instructions the processor supports.
+
+  As the values are added up in several lanes at once, the sum (and mean)
+  may differ from adding them up in order in the last few bits.
+
+  @param values
+    The values
+
+  @param length
+    The number of values
+
+  @return
+    The count, sum, mean, minimum and maximum of the values that are not
+    NaN, and the difference and percentage difference between the first and
+    last of them (all 0 if there are none)
+
+  @example
+    const double values[] = {1.0, NAN, 3.0};
+    auto stats = BethYw::summariseSeries(values, 3); // stats.mean is 2.0
+*/
+BethYw::SeriesStats BethYw::summariseSeries(const double* values,
+                                            std::size_t length) {
+#ifdef BETHYW_HAVE_AVX
+  if (hasAVX()) {
+    return finish(accumulateAVX(values, length), values, length);
+  }
+#endif
+#ifdef BETHYW_HAVE_SSE2
+  return finish(accumulateSSE2(values, length), values, length);
+#else
+  return summariseSeriesScalar(values, length);
+#endif
+}
+
+/*
+  As summariseSeries(), but adding the values up one at a time, in order.
+
+  @param values
+    The values
+
+  @param length
+    The number of values
+
+  @return
+    The statistics of the values that are not NaN
+*/
+BethYw::SeriesStats BethYw::summariseSeriesScalar(const double* values,
+                                                  std::size_t length) {
+  Accumulator acc;
+  accumulateScalar(acc, values, 0, length);
+  return finish(acc, values, length);
+}
@@ -0,0 +1,46 @@
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the batch kernels that summarise
+  the contiguous values of a Measure, using SIMD instructions where the
+  processor has them.
+ */
+
+#include <cstddef>
+
+namespace BethYw {
+
+/*
+  Summary statistics of a series of values, as computed by summariseSeries().
+*/
+struct SeriesStats {
+  std::size_t count = 0;
+  double sum = 0;
+  double mean = 0;
+  double min = 0;
+  double max = 0;
+  double difference = 0;
+  double differencePercentage = 0;
+};
+
+/*
+  Summarises a series of values in which missing entries (e.g. years
+  without a value) are NaN and are skipped.
+*/
+SeriesStats summariseSeries(const double* values, std::size_t length);
+
+/*
+  As summariseSeries(), but without SIMD instructions.
+*/
+SeriesStats summariseSeriesScalar(const double* values, std::size_t length);
+
+} // namespace BethYw
+
+#endif // KERNELS_H_
@@ -0,0 +1,413 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the LiveAreas class.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include "bethyw.h"
+#include "live.h"
+#include "parallel.h"
+
+/*
+  Index the measures of the datasets and publish the base areas as the
+  first Version. The datasets themselves are only imported when require()
+  first needs them.
+
+  @param dir
+    The directory the datasets are in
+
+  @param datasets
+    The datasets to import, in the order they would be imported by
+    BethYw::loadDatasets()
+
+  @param filter
+    The areas, measures and years to import
+
+  @param base
+    The areas to import the datasets into (e.g. from areas.csv), which are
+    not reloaded
+
+  @param index
+    The metadata index holding the area codes, to which the measures of the
+    datasets are added
+
+  @param threads
+    The number of threads to import the datasets on, or 0 for one per
+    hardware thread
+
+  @example
+    LiveAreas live(dir, datasets, filter, std::move(base), std::move(index));
+    live.watch(std::chrono::seconds(60));
+    auto version = live.require({"pop"});
+*/
+LiveAreas::LiveAreas(const std::string &dir,
+                     const std::vector<BethYw::InputFileSource> &datasets,
+                     const Filter &filter,
+                     Areas base,
+                     MetadataIndex index,
+                     unsigned int threads)
+    : dir(dir),
+      datasets(datasets),
+      filter(filter),
+      base(std::move(base)),
+      threads(BethYw::resolveThreads(threads)) {
+  parts.resize(datasets.size());
+  index.indexMeasures(dir);
+  publish(std::move(index), 1);
+}
+
+/*
+  Stop watching the datasets, if watch() was called.
+*/
+LiveAreas::~LiveAreas() {
+  stopWatching();
+}
+
+/*
+  Take the current Version of the data. It stays valid, and unchanged, for
+  as long as the caller holds on to it, even if a newer Version is
+  published in the meantime. This may be called from any thread.
+
+  @return
+    The current Version
+
+  @example
+    auto version = live.current();
+    version->data.writeJSON(std::cout);
+*/
+std::shared_ptr<const LiveAreas::Version> LiveAreas::current() const {
+  return std::atomic_load(&published);
+}
+
+/*
+  Take a Version of the data that holds every dataset that may have any of
+  the given measures, importing those that have not been imported yet (on up
+  to the LiveAreas object's threads) and publishing a new Version with them.
+  Once a dataset has been imported it is kept, and only imported again by
+  reload() if its file changes. This may be called from any thread; the
+  datasets are imported by one caller at a time, while the others wait.
+
+  Errors are reported to std::cerr as BethYw::loadDatasets() reports them,
+  and the datasets they occur in keep whatever was imported before the
+  error, until their file changes.
+
+  @param measures
+    The measure codes (in lowercase) a query asks for, or an empty set for
+    every measure
+
+  @return
+    The current Version, once it holds the datasets needed
+
+  @example
+    auto version = live.require(measuresFilter);
+    version->data.select(filter).writeJSON(std::cout);
+*/
+std::shared_ptr<const LiveAreas::Version> LiveAreas::require(
+    const std::unordered_set<std::string> &measures) {
+  auto version = current();
+  if (unloaded(*version, measures).empty()) {
+    return version;
+  }
+
+  std::lock_guard<std::mutex> lock(reloadMutex);
+
+  // Another caller may have imported them while this one waited
+  version = current();
+  const auto needed = unloaded(*version, measures);
+  if (needed.empty()) {
+    return version;
+  }
+
+  const unsigned int partThreads = std::max<std::size_t>(1, threads / needed.size());
+  importParts(needed, partThreads, false);
+
+  publish(version->index, version->generation + 1);
+  return current();
+}
+
+/*
+  The datasets that may have any of the given measures, according to a
+  Version's metadata index, but that the Version does not hold.
+*/
+std::vector<std::size_t> LiveAreas::unloaded(
+    const Version &version,
+    const std::unordered_set<std::string> &measures) const {
+  std::vector<std::size_t> missing;
+  for (std::size_t i = 0; i < datasets.size(); i++) {
+    if (!version.loaded[i] && version.index.mayContain(datasets[i].CODE, measures)) {
+      missing.push_back(i);
+    }
+  }
+  return missing;
+}
+
+/*
+  Whether the file of a dataset has changed since it was imported (or, if
+  it could not be read then, whether it exists now).
+*/
+bool LiveAreas::changed(std::size_t i) const {
+  const auto &source = parts[i].source;
+  if (source) {
+    return !source->matchesFile();
+  }
+  return std::filesystem::exists(findInputFile(dir + datasets[i].FILE));
+}
+
+/*
+  Import one dataset into a copy of some areas, fingerprinting its file
+  first so that a change made during the import is noticed by the next
+  reload().
+
+  @param i
+    The index of the dataset
+
+  @param onto
+    The areas to import the dataset into a copy of
+
+  @param partThreads
+    The number of threads the import may use for a large file
+
+  @param error
+    Set to the message to report if the import fails
+
+  @return
+    The imported data, which is partial if the import failed
+*/
+LiveAreas::Part LiveAreas::importPart(std::size_t i,
+                                      const Areas &onto,
+                                      unsigned int partThreads,
+                                      std::string &error) const {
+  Part part;
+  try {
+    part.source = SourceFingerprint::of(findInputFile(dir + datasets[i].FILE));
+  } catch (const std::exception &) {
+    // The import below fails, and reports why
+  }
+
+  auto data = std::make_shared<Areas>(onto);
+  data->setThreads(partThreads);
+  try {
+    BethYw::importDataset(*data, dir, datasets[i], filter);
+  } catch (const std::out_of_range &e) {
+    error = std::string("Key not found in map: \n") + e.what() + "\n";
+  } catch (const std::exception &e) {
+    error = std::string("Error importing dataset: \n") + e.what() + "\n";
+  }
+
+  part.data = std::move(data);
+  return part;
+}
+
+/*
+  Import datasets into their parts, each into a copy of the base areas on
+  threads of its own. As in BethYw::loadDatasets(), a dataset that fails to
+  import on its own (e.g. a row for an area that only an earlier dataset
+  creates) is then imported again, in order, on top of the merge of the
+  datasets before it, exactly as a sequential import would have done. Such
+  a layered part depends on the parts before it, so it is imported again
+  too whenever any of them is.
+
+  Errors are reported to std::cerr as BethYw::loadDatasets() reports them,
+  i.e. only those of the layered import.
+
+  @param indexes
+    The indexes of the datasets to import, in ascending order
+
+  @param partThreads
+    The number of threads each dataset's import may use for a large file
+
+  @param keepOnError
+    Whether one of the given datasets that fails to import keeps its
+    previous part, rather than the partial result of the import
+
+  @return
+    true if any part was replaced
+*/
+bool LiveAreas::importParts(const std::vector<std::size_t> &indexes,
+                            unsigned int partThreads,
+                            bool keepOnError) {
+  if (indexes.empty()) {
+    return false;
+  }
+
+  std::vector<std::size_t> toImport = indexes;
+  for (std::size_t i = indexes.front() + 1; i < parts.size(); i++) {
+    if (parts[i].layered &&
+        !std::binary_search(indexes.begin(), indexes.end(), i)) {
+      toImport.push_back(i);
+    }
+  }
+  std::sort(toImport.begin(), toImport.end());
+
+  std::vector<Part> fresh(toImport.size());
+  std::vector<std::string> errors(toImport.size());
+  BethYw::parallelFor(toImport.size(), threads, [&](std::size_t k) {
+    fresh[k] = importPart(toImport[k], base, partThreads, errors[k]);
+  });
+
+  bool replaced = false;
+  for (std::size_t k = 0; k < toImport.size(); k++) {
+    const std::size_t i = toImport[k];
+    if (!errors[k].empty()) {
+      errors[k].clear();
+      fresh[k] = importPart(i, mergeParts(i), threads, errors[k]);
+      fresh[k].layered = true;
+    }
+
+    std::cerr << errors[k];
+    if (!errors[k].empty() && keepOnError &&
+        std::binary_search(indexes.begin(), indexes.end(), i)) {
+      parts[i].source = fresh[k].source;
+    } else {
+      parts[i] = std::move(fresh[k]);
+      replaced = true;
+    }
+  }
+  return replaced;
+}
+
+/*
+  Merge the base areas and the data of the first datasets, in order.
+
+  @param end
+    The number of datasets to merge
+
+  @return
+    The merged areas
+*/
+Areas LiveAreas::mergeParts(std::size_t end) const {
+  Areas merged = base;
+  merged.setThreads(threads);
+  for (std::size_t i = 0; i < end; i++) {
+    if (parts[i].data) {
+      merged.merge(*parts[i].data);
+    }
+  }
+  return merged;
+}
+
+/*
+  Merge the datasets' data, in order, into a new Version and make it the
+  current one. A layered part holds the parts before it too, which merging
+  again leaves unchanged.
+
+  @param index
+    The metadata index for the new Version
+
+  @param generation
+    The number of the new Version
+*/
+void LiveAreas::publish(MetadataIndex index, std::uint64_t generation) {
+  auto version = std::make_shared<Version>();
+  version->data = mergeParts(parts.size());
+  for (const auto &part : parts) {
+    version->loaded.push_back(part.data != nullptr);
+  }
+  version->index = std::move(index);
+  version->generation = generation;
+
+  std::atomic_store(&published, std::shared_ptr<const Version>(std::move(version)));
+}
+
+/*
+  Import again the datasets whose files have changed, and publish a new
+  Version if there were any. The other datasets are not parsed again, and
+  those not yet imported by require() are left until they are needed.
+
+  Readers are not blocked while this runs: they keep getting the previous
+  Version from current() until the new one is published. If a changed
+  dataset fails to import, the error is reported to std::cerr and the
+  dataset keeps its previous data until its file changes again.
+
+  @return
+    true if a new Version was published, i.e. at least one dataset had
+    changed and was imported again
+
+  @example
+    if (live.reload()) {
+      std::cerr << "Now at version " << live.current()->generation << std::endl;
+    }
+*/
+bool LiveAreas::reload() {
+  std::lock_guard<std::mutex> lock(reloadMutex);
+
+  std::vector<std::size_t> stale;
+  for (std::size_t i = 0; i < datasets.size(); i++) {
+    if (parts[i].data && changed(i)) {
+      stale.push_back(i);
+    }
+  }
+  if (stale.empty()) {
+    return false;
+  }
+
+  if (!importParts(stale, 1, true)) {
+    return false;
+  }
+
+  const auto previous = current();
+  MetadataIndex index = previous->index;
+  index.indexMeasures(dir);
+  publish(std::move(index), previous->generation + 1);
+  return true;
+}
+
+/*
+  Start calling reload() on a background thread, once every interval,
+  until stopWatching() is called or the LiveAreas object is destroyed. Any
+  thread already watching is stopped first.
+
+  @param interval
+    How long to wait between checks
+
+  @example
+    live.watch(std::chrono::seconds(30));
+*/
+void LiveAreas::watch(std::chrono::milliseconds interval) {
+  stopWatching();
+
+  watcher = std::thread([this, interval] {
+    std::unique_lock<std::mutex> lock(watchMutex);
+    while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+      lock.unlock();
+      try {
+        if (reload()) {
+          std::cerr << "Reloaded datasets (version "
+                    << current()->generation << ")" << std::endl;
+        }
+      } catch (const std::exception &e) {
+        std::cerr << "Error reloading datasets: " << std::endl;
+        std::cerr << e.what() << std::endl;
+      }
+      lock.lock();
+    }
+  });
+}
+
+/*
+  Stop the thread started by watch(), waiting for any reload() it is in the
+  middle of to finish.
+*/
+void LiveAreas::stopWatching() {
+  if (!watcher.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(watchMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  watcher.join();
+  stopping = false;
+}
@@ -0,0 +1,130 @@
+#ifndef LIVE_H_
+#define LIVE_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the LiveAreas class, which keeps an
+  imported Areas object up to date with its dataset files without blocking
+  the threads reading it.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "areas.h"
+#include "datasets.h"
+#include "filter.h"
+#include "input.h"
+#include "metadata.h"
+
+/*
+  LiveAreas publishes the imported data as a series of immutable Versions,
+  read-copy-update style. Readers take the current Version with current()
+  and keep it for as long as they need it (e.g. for one request), however
+  many newer Versions are published in the meantime; a Version is freed
+  when its last reader lets go of it.
+
+  Each dataset is imported into an Areas object of its own (starting from
+  the same areas as `base`), so that reload() only needs to parse the
+  datasets whose files have changed. The datasets are then merged, in the
+  order they were given, into a new Version (see Areas::merge(), which
+  combines the Measures with Measure::combine()), which replaces the
+  current one in a single atomic step.
+
+  No dataset is imported until it is first needed: require() imports the
+  datasets that may hold the measures a query asks for (according to the
+  metadata index) and have not been imported yet, and they are then kept
+  for every later query.
+
+  watch() calls reload() periodically on a background thread, which is
+  stopped when the LiveAreas object is destroyed.
+*/
+class LiveAreas {
+public:
+  /*
+    One published version of the data, along with the metadata index to
+    validate queries for it against and which of the datasets it holds
+  */
+  struct Version {
+    Areas data;
+    MetadataIndex index;
+    std::uint64_t generation;
+    std::vector<bool> loaded;
+  };
+
+  LiveAreas(const std::string& dir,
+            const std::vector<BethYw::InputFileSource>& datasets,
+            const Filter& filter,
+            Areas base,
+            MetadataIndex index,
+            unsigned int threads = 1);
+  ~LiveAreas();
+
+  LiveAreas(const LiveAreas& other) = delete;
+  LiveAreas& operator=(const LiveAreas& other) = delete;
+
+  std::shared_ptr<const Version> current() const;
+  std::shared_ptr<const Version> require(const std::unordered_set<std::string>& measures);
+  bool reload();
+  void watch(std::chrono::milliseconds interval);
+  void stopWatching();
+
+private:
+  /*
+    One dataset's imported data (or none if it has not been imported yet),
+    the fingerprint of its file when it was read (or none if it could not
+    be read), and whether it was imported on top of the datasets before it
+    rather than on its own (see importParts())
+  */
+  struct Part {
+    std::optional<SourceFingerprint> source;
+    std::shared_ptr<const Areas> data;
+    bool layered = false;
+  };
+
+  const std::string dir;
+  const std::vector<BethYw::InputFileSource> datasets;
+  const Filter filter;
+  const Areas base;
+  const unsigned int threads;
+
+  // Only touched while reloadMutex is held
+  std::vector<Part> parts;
+  std::mutex reloadMutex;
+
+  // Only read and written with std::atomic_load() and std::atomic_store()
+  std::shared_ptr<const Version> published;
+
+  std::thread watcher;
+  std::mutex watchMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+
+  bool changed(std::size_t i) const;
+  std::vector<std::size_t> unloaded(const Version& version,
+                                    const std::unordered_set<std::string>& measures) const;
+  Part importPart(std::size_t i,
+                  const Areas& onto,
+                  unsigned int partThreads,
+                  std::string& error) const;
+  bool importParts(const std::vector<std::size_t>& indexes,
+                   unsigned int partThreads,
+                   bool keepOnError);
+  Areas mergeParts(std::size_t end) const;
+  void publish(MetadataIndex index, std::uint64_t generation);
+};
+
+#endif // LIVE_H_
@@ -16,9 +16,15 @@
 #include <stdexcept>
 #include <string>
 #include <algorithm>
+#include <limits>
 
 #include "measure.h"
 
+/*
+  The value stored in the slots of years without a value.
+*/
+static const double MISSING = std::numeric_limits<double>::quiet_NaN();
+
 /*
   Constructs a single Measure, that has values across many years.
 
@@ -33,12 +39,35 @@
     std::string label = "Population";
     Measure measure(codename, label);
 */
-Measure::Measure(std::string codename, const std::string &label) {
+Measure::Measure(std::string codename, const std::string &label)
+    : firstYear(0), count(0) {
   std::transform(codename.begin(), codename.end(), codename.begin(), ::tolower);
-  this->codename = codename;
-  this->label = label;
+  this->codename = Symbol(codename);
+  this->label = Symbol(label);
 }
 
+/*
+  Constructs a single Measure from an already interned codename and label,
+  e.g. when the same measure is created for many rows of a dataset.
+
+  @param codename
+    The codename for the measure, which must already be in lowercase
+
+  @param label
+    Human-readable label for the measure
+
+  @param alloc
+    The allocator for the readings, e.g. of the Area the Measure is created in
+
+  @example
+    Symbol codename("pop");
+    Symbol label("Population");
+    Measure measure(codename, label);
+*/
+Measure::Measure(Symbol codename, Symbol label, const allocator_type& alloc)
+    : codename(codename), label(label), firstYear(0), values(alloc),
+      present(alloc), slotYears(alloc), count(0) {}
+
 
 /*
   Retrieves the code for the Measure. This function should be callable from a 
@@ -57,7 +86,7 @@ Measure::Measure(std::string codename, const std::string &label) {
     ...
     auto codename2 = measure.getCodename();
 */
-std::string Measure::getCodename() const {
+const std::string& Measure::getCodename() const {
   return codename;
 }
 
@@ -79,7 +108,7 @@ std::string Measure::getCodename() const {
     ...
     auto label = measure.getLabel();
 */
-std::string Measure::getLabel() const {
+const std::string& Measure::getLabel() const {
   return label;
 }
 
@@ -97,7 +126,7 @@ std::string Measure::getLabel() const {
     measure.setLabel("New Population");
 */
 void Measure::setLabel(std::string newlabel) {
-  this->label = newlabel;
+  this->label = Symbol(newlabel);
 }
 
 
@@ -127,11 +156,21 @@ void Measure::setLabel(std::string newlabel) {
     auto value = measure.getValue(1999); // returns 12345678.9
 */
 double Measure::getValue(int year) const {
-  auto it = values.find(year);
-  if (it == values.end()) {
+  if (!slotYears.empty()) {
+    auto found = std::lower_bound(slotYears.begin(), slotYears.end(), year);
+    if (found == slotYears.end() || *found != year) {
+      throw std::out_of_range("No value found for year " + std::to_string(year));
+    }
+    return values[found - slotYears.begin()];
+  }
+
+  // Compare as unsigned so that years before firstYear are out of range too
+  std::size_t index = static_cast<std::size_t>(
+      static_cast<long long>(year) - firstYear);
+  if (count == 0 || index >= values.size() || !present[index]) {
     throw std::out_of_range("No value found for year " + std::to_string(year));
   }
-  return it->second;
+  return values[index];
 }
 
 
@@ -158,7 +197,161 @@ double Measure::getValue(int year) const {
     measure.setValue(1999, 12345678.9);
 */
 void Measure::setValue(int year, double value) {
-  values[year] = value;
+  if (place(year, value)) {
+    accumulate(value);
+  } else {
+    recalculate();
+  }
+}
+
+/*
+  Store a value for a year, without updating the summary statistics.
+
+  @param year
+    The year to store a value for
+
+  @param value
+    The value for the given year
+
+  @return
+    true if the value was added after every other value (so the statistics
+    can be updated with accumulate()), false if the statistics need to be
+    recalculated
+*/
+bool Measure::place(int year, double value) {
+  if (count == 0) {
+    firstYear = year;
+    values.assign(1, value);
+    present.assign(1, true);
+    slotYears.clear();
+    count = 1;
+    return true;
+  }
+
+  if (!slotYears.empty()) {
+    return placeSparse(year, value);
+  }
+
+  // Stop storing densely rather than add more slots than the readings
+  // warrant
+  const long long first = std::min<long long>(firstYear, year);
+  const long long last = std::max<long long>(getLastYear(), year);
+  if (static_cast<unsigned long long>(last - first) >=
+      MIN_DENSE_SPAN + DENSE_SPAN_PER_VALUE * (count + 1)) {
+    makeSparse();
+    return placeSparse(year, value);
+  }
+
+  // Grow the storage to cover the year, with gaps for any years in between
+  bool appended = false;
+  if (year < firstYear) {
+    std::size_t gap = static_cast<std::size_t>(
+        static_cast<long long>(firstYear) - year);
+    values.insert(values.begin(), gap, MISSING);
+    present.insert(present.begin(), gap, false);
+    firstYear = year;
+  } else {
+    std::size_t index = static_cast<std::size_t>(
+        static_cast<long long>(year) - firstYear);
+    if (index >= values.size()) {
+      values.resize(index + 1, MISSING);
+      present.resize(index + 1, false);
+      appended = true;
+    }
+  }
+
+  std::size_t index = static_cast<std::size_t>(
+      static_cast<long long>(year) - firstYear);
+  if (!present[index]) {
+    present[index] = true;
+    count++;
+  }
+  values[index] = value;
+  return appended;
+}
+
+/*
+  Store a value for a year once the Measure is sparse (see place()).
+*/
+bool Measure::placeSparse(int year, double value) {
+  auto found = std::lower_bound(slotYears.begin(), slotYears.end(), year);
+  const std::size_t index = found - slotYears.begin();
+  if (found != slotYears.end() && *found == year) {
+    values[index] = value;
+    return false;
+  }
+
+  const bool appended = found == slotYears.end();
+  slotYears.insert(found, year);
+  values.insert(values.begin() + index, value);
+  present.insert(present.begin() + index, true);
+  firstYear = slotYears.front();
+  count++;
+  return appended;
+}
+
+/*
+  Change from storing every year from the first to the last to storing only
+  the years with a value, and the year of each.
+*/
+void Measure::makeSparse() {
+  std::size_t kept = 0;
+  slotYears.reserve(count + 1);
+  for (std::size_t i = 0; i < values.size(); i++) {
+    if (present[i]) {
+      slotYears.push_back(firstYear + static_cast<int>(i));
+      values[kept++] = values[i];
+    }
+  }
+  values.resize(kept);
+  present.assign(kept, true);
+}
+
+/*
+  Update the summary statistics with a value added after every other value.
+  The sum is added to in year order, as getAverage() used to add the values
+  up, and the variance uses Welford's method.
+
+  @param value
+    The value added
+*/
+void Measure::accumulate(double value) {
+  if (count == 1) {
+    sum = value;
+    minValue = value;
+    maxValue = value;
+    mean = value;
+    sumSquaredDeviations = 0;
+    return;
+  }
+
+  sum += value;
+  if (value < minValue) {
+    minValue = value;
+  }
+  if (value > maxValue) {
+    maxValue = value;
+  }
+
+  double delta = value - mean;
+  mean += delta / count;
+  sumSquaredDeviations += delta * (value - mean);
+}
+
+/*
+  Recalculate the summary statistics from every value, in year order, giving
+  the same results as if the values had been set in year order.
+*/
+void Measure::recalculate() {
+  std::size_t total = count;
+  count = 0;
+  for (std::size_t i = 0; i < values.size(); i++) {
+    if (present[i]) {
+      count++;
+      accumulate(values[i]);
+    }
+  }
+  count = total;
 }
 
 
@@ -179,7 +372,7 @@ void Measure::setValue(int year, double value) {
     auto size = measure.size(); // returns 1
 */
 int Measure::size() const {
-    return values.size();
+    return count;
 }
 
 
@@ -201,16 +394,12 @@ int Measure::size() const {
 */
 double Measure::getDifference() const {
     // If there are no values, or only one value, return 0.0
-    if (values.empty() || values.size() == 1) {
+    if (count <= 1) {
         return 0;
     }
-    
-    // Find the first and last year
-    auto first = values.begin()->first;
-    auto last = values.rbegin()->first;
-    
-    // Calculate the difference
-    return values.at(last) - values.at(first);
+
+    // The first and last slots always hold the first and last years
+    return values.back() - values.front();
 }
 
 
@@ -232,13 +421,13 @@ double Measure::getDifference() const {
 */
 double Measure::getDifferenceAsPercentage() const {
   // If there are no values, return 0
-  if (values.empty()) {
+  if (count == 0) {
     return 0;
   }
 
   // Find the first and last year
-  double firstYear = values.begin()->second;
-  double lastYear = values.rbegin()->second;
+  double firstYear = values.front();
+  double lastYear = values.back();
 
   // Return 0 if the first year's value is 0
   if (firstYear == 0) {
@@ -254,7 +443,8 @@ double Measure::getDifferenceAsPercentage() const {
 /*
   Calculates the average/mean value for all the values. This function should be
   callable from a constant context and must promise to not change the state of 
-  the instance or throw an exception.
+  the instance or throw an exception. The sum of the values is kept up to date
+  as they are set, so this does not have to add them up.
 
   @return
     The average value for all the years, or 0 if it cannot be calculated
@@ -267,20 +457,60 @@ double Measure::getDifferenceAsPercentage() const {
 */
 double Measure::getAverage() const {
   // Check if the measure has any values
-  if (values.empty()) {
+  if (count == 0) {
     return 0;
   }
 
-  // Initialize sum variable to 0
-  double sum = 0;
+  return sum / count;
+}
+
+
+
+/*
+  Calculates the (population) variance of all the values, i.e. the mean of
+  the squared differences from their average. Like the other statistics it
+  is kept up to date as values are set, rather than calculated here.
 
-  // Loop through all the years and add the values to sum
-  for (const auto& kv : values) {
-    sum += kv.second;
+  @return
+    The variance of the values, or 0 if there are no values
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 1);
+    measure.setValue(2000, 3);
+    auto variance = measure.getVariance(); // returns 1.0
+*/
+double Measure::getVariance() const {
+  if (count == 0) {
+    return 0;
   }
 
-  // Calculate the average and return it
-  return sum / values.size();
+  return sumSquaredDeviations / count;
+}
+
+
+
+/*
+  Retrieves the last year the Measure has a value for.
+
+  @return
+    The last year, or 0 if there are no values
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 12345678.9);
+    measure.setValue(2001, 12345679.9);
+    auto last = measure.getLastYear(); // returns 2001
+*/
+int Measure::getLastYear() const {
+  if (count == 0) {
+    return 0;
+  }
+
+  if (!slotYears.empty()) {
+    return slotYears.back();
+  }
+  return firstYear + static_cast<int>(values.size()) - 1;
 }
 
 
@@ -320,18 +550,18 @@ double Measure::getAverage() const {
 std::ostream& operator<<(std::ostream& os, const Measure& measure) {
     os << std::right << std::setw(6) << "Year" << "  " << std::setw(15) << "Value" << std::endl;
     os << std::setfill('-') << std::setw(23) << "-" << std::setfill(' ') << std::endl;
-    if (measure.values.empty()) {
+    if (measure.count == 0) {
         os << measure.label << " (" << measure.codename << ")" << std::endl;
         os << "<no data>" << std::endl;
         return os;
     }
-    double firstYearValue = measure.values.begin()->second;
-    double lastYearValue = measure.values.rbegin()->second;
+    double firstYearValue = measure.values.front();
+    double lastYearValue = measure.values.back();
     double difference = lastYearValue - firstYearValue;
     double percentageDifference = (difference / firstYearValue) * 100;
-    for (auto it = measure.values.begin(); it != measure.values.end(); ++it) {
-        int year = it->first;
-        double value = it->second;
+    for (const auto &yearPair : measure.getYears()) {
+        int year = yearPair.first;
+        double value = yearPair.second;
         os << std::right << std::setw(6) << year << "  " << std::setw(15) << value << std::endl;
     }
 
@@ -358,15 +588,153 @@ std::ostream& operator<<(std::ostream& os, const Measure& measure) {
     otherwise
 */
 bool operator==(const Measure& lhs, const Measure& rhs) {
-    return lhs.getCodename() == rhs.getCodename() &&
-           lhs.getLabel() == rhs.getLabel() &&
-           lhs.values == rhs.values;
+    return lhs.codename == rhs.codename &&
+           lhs.label == rhs.label &&
+           lhs.count == rhs.count &&
+           std::equal(lhs.getYears().begin(), lhs.getYears().end(),
+                      rhs.getYears().begin());
+}
+
+Measure::Measure() : firstYear(0), count(0) {}
+
+/*
+  Constructs an empty Measure whose readings are allocated from `alloc`,
+  e.g. when a container of an Area creates one in place.
+
+  @param alloc
+    The allocator to use
+*/
+Measure::Measure(const allocator_type& alloc)
+    : firstYear(0), values(alloc), present(alloc), slotYears(alloc), count(0) {}
+
+/*
+  Copy (or move) a Measure, allocating the copy's readings from `alloc`.
+  Containers in Area use these constructors to keep their Measures in the
+  same arena as themselves.
+
+  @param other
+    The Measure to copy
+
+  @param alloc
+    The allocator to use
+*/
+Measure::Measure(const Measure& other, const allocator_type& alloc)
+    : codename(other.codename),
+      label(other.label),
+      firstYear(other.firstYear),
+      values(other.values, alloc),
+      present(other.present, alloc),
+      slotYears(other.slotYears, alloc),
+      count(other.count),
+      sum(other.sum),
+      minValue(other.minValue),
+      maxValue(other.maxValue),
+      mean(other.mean),
+      sumSquaredDeviations(other.sumSquaredDeviations) {}
+
+Measure::Measure(Measure&& other, const allocator_type& alloc)
+    : codename(other.codename),
+      label(other.label),
+      firstYear(other.firstYear),
+      values(std::move(other.values), alloc),
+      present(std::move(other.present), alloc),
+      slotYears(std::move(other.slotYears), alloc),
+      count(other.count),
+      sum(other.sum),
+      minValue(other.minValue),
+      maxValue(other.maxValue),
+      mean(other.mean),
+      sumSquaredDeviations(other.sumSquaredDeviations) {
+  other.reset();
+}
+
+/*
+  Move a Measure. The Measure moved from keeps its codename and label but
+  is left empty, with no values and the statistics of no values, rather
+  than with a count and statistics that no longer match its readings.
+
+  @param other
+    The Measure to move
+*/
+Measure::Measure(Measure&& other) noexcept
+    : codename(other.codename),
+      label(other.label),
+      firstYear(other.firstYear),
+      values(std::move(other.values)),
+      present(std::move(other.present)),
+      slotYears(std::move(other.slotYears)),
+      count(other.count),
+      sum(other.sum),
+      minValue(other.minValue),
+      maxValue(other.maxValue),
+      mean(other.mean),
+      sumSquaredDeviations(other.sumSquaredDeviations) {
+  other.reset();
 }
 
-Measure::Measure() : codename(""), label(""), values({}) {}
+Measure& Measure::operator=(Measure&& other) {
+  if (this != &other) {
+    codename = other.codename;
+    label = other.label;
+    firstYear = other.firstYear;
+    values = std::move(other.values);
+    present = std::move(other.present);
+    slotYears = std::move(other.slotYears);
+    count = other.count;
+    sum = other.sum;
+    minValue = other.minValue;
+    maxValue = other.maxValue;
+    mean = other.mean;
+    sumSquaredDeviations = other.sumSquaredDeviations;
+    other.reset();
+  }
+  return *this;
+}
 
+/*
+  Remove every value, keeping the codename, label and allocator.
+*/
+void Measure::reset() {
+  firstYear = 0;
+  values.clear();
+  present.clear();
+  slotYears.clear();
+  count = 0;
+  sum = 0;
+  minValue = 0;
+  maxValue = 0;
+  mean = 0;
+  sumSquaredDeviations = 0;
+}
+
+/*
+  Adds every value of another Measure to this one, replacing the values of
+  any years they both have. The summary statistics are recalculated at most
+  once, at the end, rather than for every value.
+
+  @param other
+    The Measure whose values to add
+
+  @example
+    Measure measure("pop", "Population");
+    measure.setValue(1999, 12345678.9);
+
+    Measure more("pop", "Population");
+    more.setValue(2000, 12345679.9);
+
+    measure.combine(more);
+*/
 void Measure::combine(const Measure& other) {
-  for (const auto& value : other.values) {
-    this->values[value.first] = value.second;
+  bool inOrder = true;
+  for (const auto& yearPair : other.getYears()) {
+    if (place(yearPair.first, yearPair.second) && inOrder) {
+      accumulate(yearPair.second);
+    } else {
+      inOrder = false;
+    }
+  }
+
+  if (!inOrder) {
+    recalculate();
   }
 }
\ No newline at end of file
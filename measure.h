@@ -11,26 +11,158 @@
   This file contains the decalaration of the Measure class.
  */
 
+#include <cstddef>
 #include <string>
 #include <unordered_set>
 #include <map>
+#include <memory_resource>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "symbol.h"
 
 /*
   The Measure class contains a measure code, label, and a container for readings
   from across a number of years.
+
+  As a measure's years are nearly always consecutive, the readings are stored
+  contiguously: values[i] is the reading for the year firstYear + i, if
+  present[i] is set. The first and last slots are always present, and the
+  slots of years without a reading hold NaN, so that batch kernels (see
+  kernels.h) can work on the values directly.
+
+  A few far-flung years (e.g. a typo of year 1, or 2000000000) must not
+  allocate a slot for every year in between, so once the years would span
+  more than MIN_DENSE_SPAN + DENSE_SPAN_PER_VALUE slots per reading, the
+  Measure stores only the readings it has, in order of year, and the year
+  of each one in slotYears (see isDense()).
+
+  The summary statistics (sum, minimum, maximum and variance) are kept up to
+  date as values are set, so reading them never rescans the values. Setting
+  a value for a year after the last one, as the datasets nearly always do,
+  updates them in constant time; any other change (replacing a value, or
+  setting one before the last year) recalculates them once.
+
+  Measure is allocator-aware, so a Measure stored in an Area that belongs to
+  an Areas object allocates its readings from that Areas object's arena.
+  Measures constructed on their own use the default (heap) resource.
 */
 class Measure {
   private:
-    std::string codename;
-    std::string label;
-    std::map<int, double> values;
+    Symbol codename;
+    Symbol label;
+    int firstYear;
+    std::pmr::vector<double> values;
+    std::pmr::vector<bool> present;
+    std::pmr::vector<int> slotYears;
+    std::size_t count;
+    double sum = 0;
+    double minValue = 0;
+    double maxValue = 0;
+    double mean = 0;
+    double sumSquaredDeviations = 0;
+
+    bool place(int year, double value);
+    bool placeSparse(int year, double value);
+    void makeSparse();
+    void accumulate(double value);
+    void recalculate();
+    void reset();
   public:
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    /*
+      The most slots a Measure stores densely is MIN_DENSE_SPAN, plus
+      DENSE_SPAN_PER_VALUE for each of its readings
+    */
+    static constexpr std::size_t MIN_DENSE_SPAN = 64;
+    static constexpr std::size_t DENSE_SPAN_PER_VALUE = 4;
+
+    /*
+      A read-only view of a Measure's readings that can be iterated in
+      chronological order like a std::map<int, double>, yielding
+      (year, value) pairs.
+    */
+    class YearValues {
+      public:
+        class const_iterator {
+          public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::pair<int, double>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            const_iterator(const Measure& measure, std::size_t index)
+                : measure(&measure), index(index) {
+              skipAbsent();
+            }
+
+            value_type operator*() const {
+              return {measure->getSlotYear(index), measure->values[index]};
+            }
+
+            const_iterator& operator++() {
+              index++;
+              skipAbsent();
+              return *this;
+            }
+
+            const_iterator operator++(int) {
+              const_iterator previous = *this;
+              ++*this;
+              return previous;
+            }
+
+            bool operator==(const const_iterator& other) const {
+              return index == other.index;
+            }
+
+            bool operator!=(const const_iterator& other) const {
+              return index != other.index;
+            }
+
+          private:
+            void skipAbsent() {
+              while (index < measure->values.size() && !measure->present[index]) {
+                index++;
+              }
+            }
+
+            const Measure* measure;
+            std::size_t index;
+        };
+
+        YearValues(const Measure& measure) : measure(measure) {}
+
+        const_iterator begin() const { return const_iterator(measure, 0); }
+        const_iterator end() const {
+          return const_iterator(measure, measure.values.size());
+        }
+        std::size_t size() const { return measure.count; }
+        bool empty() const { return measure.count == 0; }
+
+      private:
+        const Measure& measure;
+    };
+
     Measure();
+    explicit Measure(const allocator_type& alloc);
+    Measure(const Measure& other) = default;
+    Measure(Measure&& other) noexcept;
+    Measure(const Measure& other, const allocator_type& alloc);
+    Measure(Measure&& other, const allocator_type& alloc);
+    Measure& operator=(const Measure& other) = default;
+    Measure& operator=(Measure&& other);
     Measure(std::string code, const std::string &label);
-    std::string getCodename() const;
-    std::string getLabel() const;
+    Measure(Symbol code, Symbol label, const allocator_type& alloc = {});
+    const std::string& getCodename() const;
+    const std::string& getLabel() const;
+    Symbol getCodenameSymbol() const { return codename; }
+    Symbol getLabelSymbol() const { return label; }
     void setLabel(std::string newlabel);
     void setValue(int year, double value);
     double getValue(int year) const;
@@ -38,10 +170,30 @@ class Measure {
     double getDifference() const;
     double getDifferenceAsPercentage() const;
     double getAverage() const;
+    double getSum() const { return sum; }
+    double getMin() const { return minValue; }
+    double getMax() const { return maxValue; }
+    double getVariance() const;
+    int getFirstYear() const { return firstYear; }
+    int getLastYear() const;
+
+    /*
+      The contiguous values in order of year. If isDense(), they are the
+      values of every year from getFirstYear() to getLastYear(), with NaN
+      for the years without a value; otherwise they are only the values the
+      Measure has, and getSlotYear() gives the year of each.
+    */
+    const double* data() const { return values.data(); }
+    std::size_t slots() const { return values.size(); }
+    bool isDense() const { return slotYears.empty(); }
+    int getSlotYear(std::size_t slot) const {
+      return slotYears.empty() ? firstYear + static_cast<int>(slot) : slotYears[slot];
+    }
+
     friend std::ostream& operator<<(std::ostream& os, const Measure& measure);
     friend bool operator==(const Measure& lhs, const Measure& rhs);
-    const std::map<int, double>& getYears() const {
-      return values;
+    YearValues getYears() const {
+      return YearValues(*this);
     };
     void combine(const Measure& other);
 };
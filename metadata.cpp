@@ -0,0 +1,356 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the MetadataIndex class.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "lib_json.hpp"
+
+#include "areas.h"
+#include "metadata.h"
+#include "profile.h"
+
+/*
+  An alias for the imported JSON parsing library.
+*/
+using json = nlohmann::json;
+
+/*
+  A SAX event handler that only records the values of one key in each
+  element of the top-level "value" array of a WelshStatsJSON file, without
+  building any JSON objects.
+*/
+class MeasureCodeScanner : public nlohmann::json_sax<json> {
+public:
+  MeasureCodeScanner(const std::string& measureKey) : measureKey(measureKey) {}
+
+  bool null() override { return scalar(); }
+  bool boolean(bool) override { return scalar(); }
+  bool number_integer(number_integer_t) override { return scalar(); }
+  bool number_unsigned(number_unsigned_t) override { return scalar(); }
+  bool number_float(number_float_t, const string_t&) override { return scalar(); }
+  bool binary(binary_t&) override { return scalar(); }
+
+  bool string(string_t& val) override {
+    if (isMeasure && depth == 3) {
+      std::transform(val.begin(), val.end(), val.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+      if (seen.insert(val).second) {
+        codes.push_back(val);
+      }
+    }
+    return scalar();
+  }
+
+  bool start_object(std::size_t) override {
+    depth++;
+    return true;
+  }
+
+  bool key(string_t& val) override {
+    if (depth == 1) {
+      inValue = (val == "value");
+    }
+    isMeasure = inValue && depth == 3 && val == measureKey;
+    return true;
+  }
+
+  bool end_object() override {
+    depth--;
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    depth++;
+    isMeasure = false;
+    return true;
+  }
+
+  bool end_array() override {
+    depth--;
+    return true;
+  }
+
+  bool parse_error(std::size_t,
+                   const std::string&,
+                   const nlohmann::detail::exception& ex) override {
+    throw std::runtime_error(ex.what());
+  }
+
+  std::vector<std::string> codes;
+
+private:
+  bool scalar() {
+    isMeasure = false;
+    return true;
+  }
+
+  const std::string& measureKey;
+  std::unordered_set<std::string> seen;
+  std::size_t depth = 0;
+  bool inValue = false;
+  bool isMeasure = false;
+};
+
+/*
+  Construct an empty MetadataIndex.
+*/
+MetadataIndex::MetadataIndex() {}
+
+/*
+  Add the local authority code of every Area in an Areas instance, e.g. one
+  populated from areas.csv, to the index.
+
+  @param areas
+    The Areas to index
+
+  @example
+    Areas areas;
+    BethYw::loadAreas(areas, "datasets/", {});
+
+    MetadataIndex index;
+    index.addAreas(areas);
+*/
+void MetadataIndex::addAreas(const Areas& areas) {
+  for (const auto &areaPair : areas.getAreas()) {
+    areaCodes.insert(areaPair.first);
+  }
+}
+
+/*
+  Check whether a local authority code is in the index.
+
+  @param code
+    The local authority code
+
+  @return
+    true if the code is in the index
+*/
+bool MetadataIndex::hasArea(const std::string& code) const {
+  return areaCodes.find(code) != areaCodes.end();
+}
+
+/*
+  Retrieve every local authority code in the index.
+
+  @return
+    The set of local authority codes
+*/
+const std::unordered_set<std::string>& MetadataIndex::getAreaCodes() const {
+  return areaCodes;
+}
+
+/*
+  Add (or replace) the measure codes found in a dataset.
+
+  @param dataset
+    The code of the dataset, as in BethYw::InputFileSource::CODE
+
+  @param measures
+    The measure codes, and the fingerprint of the file they were found in
+*/
+void MetadataIndex::addMeasures(const std::string& dataset,
+                                DatasetMeasures measures) {
+  datasetMeasures[dataset] = std::move(measures);
+
+  measureCodes.clear();
+  for (const auto &datasetPair : datasetMeasures) {
+    measureCodes.insert(datasetPair.second.codes.begin(),
+                        datasetPair.second.codes.end());
+  }
+}
+
+/*
+  Find the measure codes of every dataset in BethYw::InputFiles::DATASETS,
+  unless they are already in the index for an unchanged file (e.g. they came
+  from a snapshot). A dataset with a single measure is indexed from its
+  column mapping alone; other datasets are scanned (see scanMeasures()).
+  Datasets whose file is missing or unreadable are left out.
+
+  @param dir
+    The directory where the datasets are
+
+  @example
+    MetadataIndex index;
+    index.indexMeasures("datasets/");
+    if (index.hasMeasure("pop")) {
+      ...
+    }
+*/
+void MetadataIndex::indexMeasures(const std::string& dir) {
+  Profile::Timer timer("indexMeasures");
+  for (const auto &dataset : BethYw::InputFiles::DATASETS) {
+    auto single = dataset.COLS.find(BethYw::SINGLE_MEASURE_CODE);
+    if (single != dataset.COLS.end()) {
+      DatasetMeasures measures;
+      std::string code = single->second;
+      std::transform(code.begin(), code.end(), code.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+      measures.codes.push_back(code);
+      addMeasures(dataset.CODE, std::move(measures));
+      continue;
+    }
+
+    std::string path = findInputFile(dir + dataset.FILE);
+    auto existing = datasetMeasures.find(dataset.CODE);
+    if (existing != datasetMeasures.end() &&
+        existing->second.source.path == path &&
+        existing->second.source.matchesFile()) {
+      continue;
+    }
+
+    try {
+      DatasetMeasures measures;
+      measures.source = SourceFingerprint::of(path);
+
+      if (detectCompression(path) != Compression::NONE) {
+        InputCompressedFile input(path);
+        measures.codes = scanMeasures(input.open(), dataset);
+      } else {
+        InputMappedFile input(path);
+        measures.codes = scanMeasures(input.open(), dataset);
+      }
+      addMeasures(dataset.CODE, std::move(measures));
+    } catch (const std::exception &) {
+      // A dataset that cannot be read has no measures to offer
+    }
+  }
+}
+
+/*
+  Check whether a measure code (in lowercase) is in any indexed dataset.
+
+  @param code
+    The measure code
+
+  @return
+    true if the code is in the index
+*/
+bool MetadataIndex::hasMeasure(const std::string& code) const {
+  return measureCodes.find(code) != measureCodes.end();
+}
+
+/*
+  Check whether a dataset may hold any of the given measures, and so
+  whether it needs to be imported for them. A dataset whose measures have
+  not been indexed (e.g. because its file could not be read) may hold any
+  measure, so that importing it still reports why it cannot be read.
+
+  @param dataset
+    The code of the dataset, as in BethYw::InputFileSource::CODE
+
+  @param measures
+    The measure codes (in lowercase), or an empty set for every measure
+
+  @return
+    false only if the dataset is known to hold none of the measures
+
+  @example
+    if (index.mayContain(BethYw::InputFiles::BIZ.CODE, measuresFilter)) {
+      BethYw::importDataset(areas, dir, BethYw::InputFiles::BIZ, filter);
+    }
+*/
+bool MetadataIndex::mayContain(const std::string& dataset,
+                               const std::unordered_set<std::string>& measures) const {
+  if (measures.empty()) {
+    return true;
+  }
+
+  auto found = datasetMeasures.find(dataset);
+  if (found == datasetMeasures.end()) {
+    return true;
+  }
+  return std::any_of(found->second.codes.begin(), found->second.codes.end(),
+                     [&](const std::string& code) { return measures.count(code) > 0; });
+}
+
+/*
+  Retrieve every measure code in the index.
+
+  @return
+    The set of measure codes, in lowercase
+*/
+const std::unordered_set<std::string>& MetadataIndex::getMeasureCodes() const {
+  return measureCodes;
+}
+
+/*
+  Retrieve the measure codes of each indexed dataset.
+
+  @return
+    A map of dataset codes to their measures
+*/
+const std::map<std::string, MetadataIndex::DatasetMeasures>&
+MetadataIndex::getDatasetMeasures() const {
+  return datasetMeasures;
+}
+
+/*
+  Find the distinct measure codes in the contents of a WelshStatsJSON file,
+  in the order they first appear, by streaming through it and only looking
+  at the dataset's measure code column.
+
+  @param contents
+    The contents of the file
+
+  @param dataset
+    The InputFileSource describing the file
+
+  @return
+    The measure codes, in lowercase
+
+  @throws
+    std::runtime_error if the file is not valid JSON
+    std::out_of_range if the dataset has no measure code column
+
+  @example
+    InputMappedFile input("datasets/econ0080.json");
+    auto codes = MetadataIndex::scanMeasures(input.open(),
+                                             BethYw::InputFiles::BIZ);
+*/
+std::vector<std::string> MetadataIndex::scanMeasures(
+    std::string_view contents,
+    const BethYw::InputFileSource& dataset) {
+  MeasureCodeScanner scanner(dataset.COLS.at(BethYw::MEASURE_CODE));
+  json::sax_parse(contents.data(), contents.data() + contents.size(), &scanner,
+                  json::input_format_t::json, false);
+  return scanner.codes;
+}
+
+/*
+  Find the distinct measure codes in a WelshStatsJSON file read from a
+  stream, e.g. one being decompressed, in the order they first appear. The
+  stream is parsed as it is read, so the file is never held in memory.
+
+  @param is
+    The input stream to read the file from
+
+  @param dataset
+    The InputFileSource describing the file
+
+  @return
+    The measure codes, in lowercase
+
+  @throws
+    std::runtime_error if the file is not valid JSON
+    std::out_of_range if the dataset has no measure code column
+
+  @example
+    InputCompressedFile input("datasets/econ0080.json.gz");
+    auto codes = MetadataIndex::scanMeasures(input.open(),
+                                             BethYw::InputFiles::BIZ);
+*/
+std::vector<std::string> MetadataIndex::scanMeasures(
+    std::istream& is,
+    const BethYw::InputFileSource& dataset) {
+  MeasureCodeScanner scanner(dataset.COLS.at(BethYw::MEASURE_CODE));
+  json::sax_parse(is, &scanner, json::input_format_t::json, false);
+  return scanner.codes;
+}
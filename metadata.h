@@ -0,0 +1,73 @@
+#ifndef METADATA_H_
+#define METADATA_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the MetadataIndex class, which lists
+  the area and measure codes that exist in the datasets, so that program
+  arguments can be validated without importing the datasets.
+ */
+
+#include <istream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "datasets.h"
+#include "input.h"
+
+class Areas;
+
+/*
+  A MetadataIndex contains the set of valid local authority codes (from
+  areas.csv) and, for each dataset, the set of measure codes in it (in
+  lowercase). The measure codes of a dataset are only found when they are
+  first needed, either from a snapshot of a previous run or by scanning the
+  dataset's file for its measure column, which is much cheaper than
+  importing it.
+*/
+class MetadataIndex {
+public:
+  /*
+    The measure codes of one dataset, and the file they were found in.
+  */
+  struct DatasetMeasures {
+    SourceFingerprint source;
+    std::vector<std::string> codes;
+  };
+
+  MetadataIndex();
+
+  void addAreas(const Areas& areas);
+  bool hasArea(const std::string& code) const;
+  const std::unordered_set<std::string>& getAreaCodes() const;
+
+  void addMeasures(const std::string& dataset, DatasetMeasures measures);
+  void indexMeasures(const std::string& dir);
+  bool hasMeasure(const std::string& code) const;
+  bool mayContain(const std::string& dataset,
+                  const std::unordered_set<std::string>& measures) const;
+  const std::unordered_set<std::string>& getMeasureCodes() const;
+  const std::map<std::string, DatasetMeasures>& getDatasetMeasures() const;
+
+  static std::vector<std::string> scanMeasures(
+      std::string_view contents,
+      const BethYw::InputFileSource& dataset);
+  static std::vector<std::string> scanMeasures(
+      std::istream& is,
+      const BethYw::InputFileSource& dataset);
+
+private:
+  std::unordered_set<std::string> areaCodes;
+  std::unordered_set<std::string> measureCodes;
+  std::map<std::string, DatasetMeasures> datasetMeasures;
+};
+
+#endif // METADATA_H_
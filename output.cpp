@@ -0,0 +1,285 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the OutputBuffer class and of
+  saveAtomically().
+ */
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "lib_json.hpp"
+
+#include "output.h"
+
+/*
+  Construct an OutputBuffer writing to an output stream.
+
+  @param os
+    The stream to write to, which must outlive the OutputBuffer
+
+  @example
+    OutputBuffer out(std::cout);
+    out.write("Beth Yw?\n");
+*/
+OutputBuffer::OutputBuffer(std::ostream& os)
+    : os(os), buffer(new char[CAPACITY]) {}
+
+/*
+  Write anything still in the buffer to the stream.
+*/
+OutputBuffer::~OutputBuffer() {
+  flush();
+}
+
+/*
+  Make room for `length` more bytes in the buffer, writing its contents to
+  the stream first if they would not fit.
+
+  @param length
+    The number of bytes needed, which must be no more than CAPACITY
+
+  @return
+    Where to write the bytes
+*/
+char* OutputBuffer::reserve(std::size_t length) {
+  if (used + length > CAPACITY) {
+    flush();
+  }
+  return buffer.get() + used;
+}
+
+/*
+  Write text to the output.
+
+  @param text
+    The text to write
+
+  @example
+    out.write("Average");
+*/
+void OutputBuffer::write(std::string_view text) {
+  if (text.size() > CAPACITY) {
+    // Too big to be worth copying into the buffer
+    flush();
+    os.write(text.data(), text.size());
+    return;
+  }
+  std::memcpy(reserve(text.size()), text.data(), text.size());
+  used += text.size();
+}
+
+/*
+  Write a single character to the output.
+
+  @param c
+    The character to write
+*/
+void OutputBuffer::write(char c) {
+  *reserve(1) = c;
+  used++;
+}
+
+/*
+  Write text to the output, right-aligned in a field of at least `width`
+  characters, as std::setw() would.
+
+  @param text
+    The text to write
+
+  @param width
+    The minimum number of characters to write, which must be no more than
+    CAPACITY
+
+  @example
+    out.writePadded("Average", 11);
+*/
+void OutputBuffer::writePadded(std::string_view text, std::size_t width) {
+  if (text.size() < width) {
+    const std::size_t padding = width - text.size();
+    std::memset(reserve(padding), ' ', padding);
+    used += padding;
+  }
+  write(text);
+}
+
+/*
+  Write an integer to the output, right-aligned in a field of at least
+  `width` characters.
+
+  @param value
+    The integer to write
+
+  @param width
+    The minimum number of characters to write, or 0 for no padding
+
+  @example
+    out.writeInteger(2015, 11);
+*/
+void OutputBuffer::writeInteger(long long value, std::size_t width) {
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  writePadded(std::string_view(digits, result.ptr - digits), width);
+}
+
+/*
+  Write a number to the output in fixed-point notation with `precision`
+  digits after the decimal point, right-aligned in a field of at least
+  `width` characters. The output is the same as that of std::fixed and
+  std::setprecision() (e.g. "nan" and "inf" for values that are not finite).
+
+  @param value
+    The number to write
+
+  @param precision
+    The number of digits after the decimal point
+
+  @param width
+    The minimum number of characters to write, or 0 for no padding
+
+  @example
+    out.writeFixed(measure.getAverage(), 6, 11);
+*/
+void OutputBuffer::writeFixed(double value, int precision, std::size_t width) {
+  // Enough for the largest double, DBL_MAX, with any sensible precision
+  char digits[512];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value,
+                              std::chars_format::fixed, precision);
+  writePadded(std::string_view(digits, result.ptr - digits), width);
+}
+
+/*
+  Write text to the output as a quoted JSON string, escaping it as
+  nlohmann::json::dump() does (UTF-8 is written as it is).
+
+  @param text
+    The text to write
+
+  @example
+    out.writeJSONString("Ynys Môn");
+*/
+void OutputBuffer::writeJSONString(std::string_view text) {
+  static const char HEX[] = "0123456789abcdef";
+
+  write('"');
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < text.size(); i++) {
+    const unsigned char c = text[i];
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    write(text.substr(start, i - start));
+    start = i + 1;
+    switch (c) {
+    case '"':  write("\\\""); break;
+    case '\\': write("\\\\"); break;
+    case '\b': write("\\b"); break;
+    case '\f': write("\\f"); break;
+    case '\n': write("\\n"); break;
+    case '\r': write("\\r"); break;
+    case '\t': write("\\t"); break;
+    default: {
+      const char escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+      write(std::string_view(escaped, sizeof(escaped)));
+    }
+    }
+  }
+  write(text.substr(start));
+  write('"');
+}
+
+/*
+  Write a number to the output as nlohmann::json::dump() would, i.e. the
+  shortest representation that reads back as the same double (always with
+  a decimal point or exponent), or null if the number is not finite.
+
+  @param value
+    The number to write
+
+  @example
+    out.writeJSONNumber(69123);  // 69123.0
+*/
+void OutputBuffer::writeJSONNumber(double value) {
+  if (!std::isfinite(value)) {
+    write("null");
+    return;
+  }
+
+  char digits[64];
+  char* end = nlohmann::detail::to_chars(digits, digits + sizeof(digits), value);
+  write(std::string_view(digits, end - digits));
+}
+
+/*
+  Write everything in the buffer to the stream.
+*/
+void OutputBuffer::flush() {
+  if (used > 0) {
+    os.write(buffer.get(), used);
+    used = 0;
+  }
+}
+
+/*
+  Write a file under a temporary name (`path` followed by .tmp) and then
+  rename it to `path`, so a concurrent reader never sees a partly written
+  file, and an earlier file at `path` is only replaced once the new one is
+  complete.
+
+  @param path
+    The path of the file to write
+
+  @param write
+    Writes the contents of the file to the stream it is given, which is
+    opened in binary mode
+
+  @throws
+    std::runtime_error if the file cannot be written, or anything that
+    `write` throws. The temporary file is removed on any failure.
+
+  @example
+    saveAtomically("bethyw.cache", [&](std::ostream& os) {
+      snapshot.write(os);
+    });
+*/
+void saveAtomically(const std::string& path,
+                    const std::function<void(std::ostream&)>& write) {
+  std::string tempPath = path + ".tmp";
+  std::error_code error;
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      throw std::runtime_error("saveAtomically: Failed to open file " + tempPath);
+    }
+
+    // The temporary file is removed on any failure, including one found
+    // only when the buffered data is flushed by close()
+    try {
+      write(file);
+    } catch (...) {
+      file.close();
+      std::filesystem::remove(tempPath, error);
+      throw;
+    }
+    file.close();
+    if (!file) {
+      std::filesystem::remove(tempPath, error);
+      throw std::runtime_error("saveAtomically: Failed to write file " + tempPath);
+    }
+  }
+
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    throw std::runtime_error("saveAtomically: Failed to write file " + path);
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the OutputBuffer class, a buffered
+  sink that the JSON and table writers of Areas format their output into,
+  and of saveAtomically(), which the file formats are saved with.
+ */
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/*
+  OutputBuffer collects output in a fixed-size buffer and writes it to an
+  output stream a buffer at a time, so that writing a large result set
+  takes a constant amount of memory and few calls into the stream.
+
+  As well as plain text it formats the values the writers need (integers,
+  fixed-point numbers, and JSON strings and numbers) straight into the
+  buffer, without going through iostream formatting or temporary strings.
+
+  Anything still in the buffer is written when the OutputBuffer is
+  destroyed, or by calling flush().
+*/
+class OutputBuffer {
+public:
+  /*
+    The number of bytes collected before they are written to the stream
+  */
+  static constexpr std::size_t CAPACITY = 64 * 1024;
+
+  explicit OutputBuffer(std::ostream& os);
+  ~OutputBuffer();
+
+  OutputBuffer(const OutputBuffer& other) = delete;
+  OutputBuffer& operator=(const OutputBuffer& other) = delete;
+
+  void write(std::string_view text);
+  void write(char c);
+  void writePadded(std::string_view text, std::size_t width);
+  void writeInteger(long long value, std::size_t width = 0);
+  void writeFixed(double value, int precision, std::size_t width = 0);
+  void writeJSONString(std::string_view text);
+  void writeJSONNumber(double value);
+
+  void flush();
+
+private:
+  char* reserve(std::size_t length);
+
+  std::ostream& os;
+  std::unique_ptr<char[]> buffer;
+  std::size_t used = 0;
+};
+
+void saveAtomically(const std::string& path,
+                    const std::function<void(std::ostream&)>& write);
+
+#endif // OUTPUT_H_
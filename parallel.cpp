@@ -0,0 +1,108 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains a minimal thread pool for running independent tasks,
+  such as the import of each dataset, at the same time.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+/*
+  Resolve a requested number of threads.
+
+  @param requested
+    The number of threads asked for, or 0 for one per hardware thread
+
+  @return
+    The number of threads to use, which is always at least 1
+
+  @example
+    auto threads = BethYw::resolveThreads(args["threads"].as<unsigned int>());
+*/
+unsigned int BethYw::resolveThreads(unsigned int requested) {
+  if (requested == 0) {
+    requested = std::thread::hardware_concurrency();
+  }
+  return std::max(1u, requested);
+}
+
+/*
+  Run a task for every index in [0, count) using a pool of worker threads.
+  Each worker repeatedly claims the next unclaimed index, so tasks of very
+  different lengths (e.g. small and large files) keep every thread busy.
+  With one thread, or one task, everything runs on the calling thread.
+
+  @param count
+    The number of tasks
+
+  @param threads
+    The maximum number of threads to use
+
+  @param task
+    The function to run for each index. Tasks run concurrently, so must not
+    modify shared state without synchronisation.
+
+  @throws
+    The first exception thrown by any task, after all workers have finished
+
+  @example
+    std::vector<Areas> results(datasets.size());
+    BethYw::parallelFor(datasets.size(), 4, [&](std::size_t i) {
+      importDataset(results[i], dir, datasets[i], ...);
+    });
+*/
+void BethYw::parallelFor(std::size_t count,
+                         unsigned int threads,
+                         const std::function<void(std::size_t)> &task) {
+  std::size_t workers = std::min<std::size_t>(threads, count);
+  if (workers <= 1) {
+    for (std::size_t i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> nextIndex(0);
+  std::exception_ptr firstError;
+  std::mutex errorMutex;
+
+  auto work = [&]() {
+    std::size_t i;
+    while ((i = nextIndex++) < count) {
+      try {
+        task(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!firstError) {
+          firstError = std::current_exception();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(workers - 1);
+  for (std::size_t t = 1; t < workers; t++) {
+    pool.emplace_back(work);
+  }
+  work();
+
+  for (auto &thread : pool) {
+    thread.join();
+  }
+
+  if (firstError) {
+    std::rethrow_exception(firstError);
+  }
+}
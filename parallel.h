@@ -0,0 +1,36 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declarations of the helpers used to spread work
+  (e.g. importing datasets) over a number of threads.
+ */
+
+#include <cstddef>
+#include <functional>
+
+namespace BethYw {
+
+/*
+  Resolve a requested number of threads, where 0 means one thread per
+  hardware thread.
+*/
+unsigned int resolveThreads(unsigned int requested);
+
+/*
+  Run task(0) ... task(count - 1) on up to `threads` worker threads, and
+  wait for them all to finish.
+*/
+void parallelFor(std::size_t count,
+                 unsigned int threads,
+                 const std::function<void(std::size_t)> &task);
+
+} // namespace BethYw
+
+#endif // PARALLEL_H_
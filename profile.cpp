@@ -0,0 +1,313 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the Profile class. The timings
+  and counters are kept in a table guarded by a mutex, which is only taken
+  once a phase ends (or a parser finishes counting its rows), so the
+  profiled loops themselves never touch it.
+ */
+
+#include <mutex>
+#include <vector>
+
+#include "output.h"
+#include "profile.h"
+
+std::atomic<bool> Profile::active{false};
+
+/*
+  The time spent in one phase of a dataset
+*/
+struct PhaseTime {
+  const char* phase;
+  std::uint64_t calls = 0;
+  double seconds = 0;
+};
+
+/*
+  Everything recorded for one dataset, with its phases in the order they
+  first ended
+*/
+struct DatasetProfile {
+  std::string code;
+  std::vector<PhaseTime> phases;
+  std::array<std::uint64_t, Profile::NUM_COUNTERS> counters{};
+};
+
+static std::mutex profileMutex;
+static std::vector<DatasetProfile> profiles;
+
+// The dataset the thread is working on, set by Profile::Dataset
+static thread_local const std::string* currentDataset = nullptr;
+
+static const std::string RUN = "run";
+
+/*
+  The record of the calling thread's dataset, created the first time it
+  is needed. profileMutex must be held.
+*/
+static DatasetProfile& currentProfile() {
+  const std::string& code = currentDataset ? *currentDataset : RUN;
+  for (auto& profile : profiles) {
+    if (profile.code == code) {
+      return profile;
+    }
+  }
+  profiles.push_back({code, {}, {}});
+  return profiles.back();
+}
+
+/*
+  Forwards the arenas' block allocations to the default resource, counting
+  their size as BYTES_ALLOCATED.
+*/
+class CountingResource : public std::pmr::memory_resource {
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    Profile::count(Profile::BYTES_ALLOCATED, bytes);
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+/*
+  Write text left-aligned in a field of at least `width` characters.
+*/
+static void writeLeft(OutputBuffer& out, const std::string& text, std::size_t width) {
+  out.write(text);
+  if (text.size() < width) {
+    out.writePadded("", width - text.size());
+  }
+}
+
+/*
+  Start recording the calling thread's work as being for a dataset.
+
+  @param code
+    The dataset's code (e.g. InputFiles::POPDEN.CODE), which must outlive
+    the object
+
+  @example
+    Profile::Dataset dataset(dataset.CODE);
+*/
+Profile::Dataset::Dataset(const std::string& code)
+    : previous(currentDataset), active(enabled()) {
+  if (active) {
+    currentDataset = &code;
+  }
+}
+
+/*
+  Go back to recording the calling thread's work as being for the dataset
+  it was for before.
+*/
+Profile::Dataset::~Dataset() {
+  if (active) {
+    currentDataset = previous;
+  }
+}
+
+/*
+  Start timing a phase, if profiling is on.
+
+  @param phase
+    The name of the phase
+
+  @example
+    Profile::Timer timer("writeOutput");
+*/
+Profile::Timer::Timer(const char* phase) : phase(phase), running(enabled()) {
+  if (running) {
+    start = std::chrono::steady_clock::now();
+  }
+}
+
+/*
+  Stop timing the phase, if stop() has not been called already.
+*/
+Profile::Timer::~Timer() {
+  stop();
+}
+
+/*
+  Stop timing the phase and record how long it took. Later calls do
+  nothing.
+
+  @example
+    Profile::Timer timer("run");
+    ...
+    timer.stop();
+    Profile::writeReport(std::cerr);
+*/
+void Profile::Timer::stop() {
+  if (running) {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    addTime(phase, elapsed.count());
+    running = false;
+  }
+}
+
+/*
+  Add the rows counted to the calling thread's dataset's counters.
+*/
+Profile::Rows::~Rows() {
+  if (enabled()) {
+    add(ROWS_READ, read);
+    add(ROWS_FILTERED, filtered);
+  }
+}
+
+/*
+  Turn profiling on, for the rest of the program.
+
+  @example
+    if (args.count("profile")) {
+      Profile::enable();
+    }
+*/
+void Profile::enable() {
+  active.store(true, std::memory_order_relaxed);
+}
+
+/*
+  The memory resource the Areas arenas allocate their blocks from, which
+  counts the bytes allocated while profiling is on.
+
+  @return
+    A resource that lives as long as the program
+*/
+std::pmr::memory_resource* Profile::upstream() noexcept {
+  static CountingResource resource;
+  return &resource;
+}
+
+void Profile::add(Counter counter, std::uint64_t n) {
+  std::lock_guard<std::mutex> lock(profileMutex);
+  currentProfile().counters[counter] += n;
+}
+
+void Profile::addTime(const char* phase, double seconds) {
+  std::lock_guard<std::mutex> lock(profileMutex);
+  auto& phases = currentProfile().phases;
+  for (auto& recorded : phases) {
+    if (std::string(recorded.phase) == phase) {
+      recorded.calls++;
+      recorded.seconds += seconds;
+      return;
+    }
+  }
+  phases.push_back({phase, 1, seconds});
+}
+
+/*
+  Write the timings and counters recorded so far as two tables: the time of
+  each phase of each dataset, and each dataset's counters.
+
+  @param os
+    The stream to write to, e.g. std::cerr
+
+  @example
+    Profile::writeReport(std::cerr);
+*/
+void Profile::writeReport(std::ostream& os) {
+  std::lock_guard<std::mutex> lock(profileMutex);
+  OutputBuffer out(os);
+
+  writeLeft(out, "Dataset", 20);
+  writeLeft(out, "Phase", 32);
+  out.writePadded("Calls", 8);
+  out.writePadded("Time (ms)", 14);
+  out.write('\n');
+  for (const auto& profile : profiles) {
+    for (const auto& phase : profile.phases) {
+      writeLeft(out, profile.code, 20);
+      writeLeft(out, phase.phase, 32);
+      out.writeInteger(phase.calls, 8);
+      out.writeFixed(phase.seconds * 1000, 3, 14);
+      out.write('\n');
+    }
+  }
+
+  out.write('\n');
+  writeLeft(out, "Dataset", 20);
+  out.writePadded("Rows read", 16);
+  out.writePadded("Rows filtered", 16);
+  out.writePadded("Bytes read", 16);
+  out.writePadded("Bytes allocated", 16);
+  out.write('\n');
+  for (const auto& profile : profiles) {
+    writeLeft(out, profile.code, 20);
+    for (auto value : profile.counters) {
+      out.writeInteger(value, 16);
+    }
+    out.write('\n');
+  }
+}
+
+/*
+  Write the timings and counters recorded so far as JSON, e.g.
+
+    {"datasets":[{"code":"popden","counters":{"bytesAllocated":65536,
+    "bytesRead":10240,"rowsFiltered":0,"rowsRead":118},"phases":[{"calls":1,
+    "name":"read","seconds":0.0001}, ...]}, ...]}
+
+  @param os
+    The stream to write to, e.g. std::cerr
+
+  @example
+    Profile::writeJSON(std::cerr);
+*/
+void Profile::writeJSON(std::ostream& os) {
+  std::lock_guard<std::mutex> lock(profileMutex);
+  OutputBuffer out(os);
+
+  out.write("{\"datasets\":[");
+  bool firstProfile = true;
+  for (const auto& profile : profiles) {
+    if (!firstProfile) {
+      out.write(',');
+    }
+    firstProfile = false;
+
+    out.write("{\"code\":");
+    out.writeJSONString(profile.code);
+    out.write(",\"counters\":{\"bytesAllocated\":");
+    out.writeInteger(profile.counters[BYTES_ALLOCATED]);
+    out.write(",\"bytesRead\":");
+    out.writeInteger(profile.counters[BYTES_READ]);
+    out.write(",\"rowsFiltered\":");
+    out.writeInteger(profile.counters[ROWS_FILTERED]);
+    out.write(",\"rowsRead\":");
+    out.writeInteger(profile.counters[ROWS_READ]);
+    out.write("},\"phases\":[");
+
+    bool firstPhase = true;
+    for (const auto& phase : profile.phases) {
+      if (!firstPhase) {
+        out.write(',');
+      }
+      firstPhase = false;
+
+      out.write("{\"calls\":");
+      out.writeInteger(phase.calls);
+      out.write(",\"name\":");
+      out.writeJSONString(phase.phase);
+      out.write(",\"seconds\":");
+      out.writeJSONNumber(phase.seconds);
+      out.write('}');
+    }
+    out.write("]}");
+  }
+  out.write("]}");
+}
@@ -0,0 +1,142 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the Profile class, which collects
+  the phase timings and counters printed by --profile.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+
+/*
+  Profile collects how long each phase of a run takes (reading a file,
+  parsing it, merging datasets, writing the output, ...) and how many rows
+  and bytes it handles, broken down by the dataset being imported.
+
+  Profiling is off unless enable() is called (by --profile). While it is
+  off, every Timer, Dataset and Rows object, and every count(), only checks
+  a flag: no clock is read and nothing is recorded.
+
+  Timings are inclusive, so a phase includes the time of any phase it
+  contains (e.g. "run" includes everything). They are charged to the
+  dataset the calling thread is working on, as set by a Dataset object, or
+  to "run" if there is none.
+
+  @example
+    Profile::enable();
+    {
+      Profile::Dataset dataset("popden");
+      Profile::Timer timer("read");
+      Profile::count(Profile::BYTES_READ, contents.size());
+    }
+    Profile::writeReport(std::cerr);
+*/
+class Profile {
+public:
+  /*
+    The counters kept for each dataset
+  */
+  enum Counter {
+    ROWS_READ,
+    ROWS_FILTERED,
+    BYTES_READ,
+    BYTES_ALLOCATED,
+    NUM_COUNTERS
+  };
+
+  /*
+    Record the dataset the calling thread is working on for as long as the
+    object exists, restoring the previous one when it is destroyed.
+  */
+  class Dataset {
+  public:
+    explicit Dataset(const std::string& code);
+    ~Dataset();
+
+    Dataset(const Dataset&) = delete;
+    Dataset& operator=(const Dataset&) = delete;
+
+  private:
+    const std::string* previous;
+    bool active;
+  };
+
+  /*
+    Time a phase, from construction until stop() is called or the object is
+    destroyed. The phase name must outlive the object (e.g. a literal).
+  */
+  class Timer {
+  public:
+    explicit Timer(const char* phase);
+    ~Timer();
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    void stop();
+
+  private:
+    const char* phase;
+    std::chrono::steady_clock::time_point start;
+    bool running;
+  };
+
+  /*
+    Count the rows a parser reads and filters out locally, and add them to
+    the counters once, when destroyed (including when an error stops the
+    parse).
+  */
+  struct Rows {
+    std::uint64_t read = 0;
+    std::uint64_t filtered = 0;
+
+    Rows() = default;
+    ~Rows();
+
+    Rows(const Rows&) = delete;
+    Rows& operator=(const Rows&) = delete;
+  };
+
+  static void enable();
+
+  /*
+    Whether profiling is on
+  */
+  static bool enabled() noexcept {
+    return active.load(std::memory_order_relaxed);
+  }
+
+  /*
+    Add to one of the calling thread's dataset's counters, if profiling is on
+  */
+  static void count(Counter counter, std::uint64_t n) {
+    if (enabled()) {
+      add(counter, n);
+    }
+  }
+
+  static std::pmr::memory_resource* upstream() noexcept;
+
+  static void writeReport(std::ostream& os);
+  static void writeJSON(std::ostream& os);
+
+private:
+  static std::atomic<bool> active;
+
+  static void add(Counter counter, std::uint64_t n);
+  static void addTime(const char* phase, double seconds);
+};
+
+#endif // PROFILE_H_
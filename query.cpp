@@ -0,0 +1,575 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the Query class.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <stdexcept>
+
+#include "kernels.h"
+#include "output.h"
+#include "query.h"
+
+/*
+  The running count, sum, minimum and maximum of one group of aggregate().
+*/
+struct GroupAccumulator {
+  std::size_t count = 0;
+  double sum = 0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+
+  void add(double value) {
+    count++;
+    sum += value;
+    if (value < min) {
+      min = value;
+    }
+    if (value > max) {
+      max = value;
+    }
+  }
+
+  void add(const BethYw::SeriesStats &stats) {
+    if (stats.count == 0) {
+      return;
+    }
+    count += stats.count;
+    sum += stats.sum;
+    min = std::min(min, stats.min);
+    max = std::max(max, stats.max);
+  }
+};
+
+/*
+  The groups of one measure (or of every measure, if the values are not
+  grouped by measure): one per year from firstYear, or just one if the
+  values are not grouped by year. If the years would span more than
+  MAX_DENSE_YEARS groups, the groups are kept by year in sparseYears
+  instead.
+*/
+struct YearGroups {
+  static constexpr std::size_t MAX_DENSE_YEARS = 4096;
+
+  int firstYear = 0;
+  std::vector<GroupAccumulator> years;
+  std::map<int, GroupAccumulator> sparseYears;
+  bool sparse = false;
+
+  /*
+    Make sure there is a group for each of the `length` years from `first`,
+    and return the group for `first`, or null if the groups are sparse (see
+    at()).
+  */
+  GroupAccumulator* cover(int first, std::size_t length) {
+    if (sparse) {
+      return nullptr;
+    }
+
+    const long long spanStart = years.empty() ? first : std::min(firstYear, first);
+    const long long spanEnd = years.empty()
+        ? first + static_cast<long long>(length)
+        : std::max<long long>(firstYear + static_cast<long long>(years.size()),
+                              first + static_cast<long long>(length));
+    if (static_cast<unsigned long long>(spanEnd - spanStart) > MAX_DENSE_YEARS) {
+      for (std::size_t i = 0; i < years.size(); i++) {
+        if (years[i].count > 0) {
+          sparseYears[firstYear + static_cast<int>(i)] = years[i];
+        }
+      }
+      years.clear();
+      sparse = true;
+      return nullptr;
+    }
+
+    if (years.empty()) {
+      firstYear = first;
+    } else if (first < firstYear) {
+      years.insert(years.begin(), firstYear - first, GroupAccumulator());
+      firstYear = first;
+    }
+
+    const std::size_t end = first - firstYear + length;
+    if (end > years.size()) {
+      years.resize(end);
+    }
+    return years.data() + (first - firstYear);
+  }
+
+  /*
+    The group for one year.
+  */
+  GroupAccumulator& at(int year) {
+    GroupAccumulator* group = cover(year, 1);
+    return group != nullptr ? *group : sparseYears[year];
+  }
+
+  /*
+    Call f(year, group) for every group, in order of year.
+  */
+  template <typename F>
+  void forEach(F f) const {
+    if (sparse) {
+      for (const auto &yearPair : sparseYears) {
+        f(yearPair.first, yearPair.second);
+      }
+      return;
+    }
+    for (std::size_t i = 0; i < years.size(); i++) {
+      f(firstYear + static_cast<int>(i), years[i]);
+    }
+  }
+};
+
+/*
+  Construct a Query that sums the values of each measure in each year, and
+  ranks every percentage difference.
+
+  @example
+    Query query;
+    query.setReduction(Query::Reduction::AVERAGE);
+*/
+Query::Query()
+    : reduction(Reduction::SUM),
+      byMeasure(true),
+      byYear(true),
+      minValue(-std::numeric_limits<double>::infinity()),
+      maxValue(std::numeric_limits<double>::infinity()) {}
+
+/*
+  Set how aggregate() reduces each group of values.
+
+  @param reduction
+    The reduction to use
+*/
+void Query::setReduction(Reduction reduction) {
+  this->reduction = reduction;
+}
+
+/*
+  Set how aggregate() groups the values. If neither is set, every value is
+  in a single group.
+
+  @param measure
+    Whether to group the values by measure codename
+
+  @param year
+    Whether to group the values by year
+
+  @example
+    Query query;
+    query.setGroupBy(false, true); // e.g. the sum of every measure each year
+*/
+void Query::setGroupBy(bool measure, bool year) {
+  byMeasure = measure;
+  byYear = year;
+}
+
+/*
+  Set the inclusive range of values the query considers: the values that
+  aggregate() reduces, and the percentage differences that top() ranks.
+
+  @param min
+    The smallest value to consider, or -infinity for no lower bound
+
+  @param max
+    The largest value to consider, or +infinity for no upper bound
+
+  @example
+    Query query;
+    query.setRange(0, std::numeric_limits<double>::infinity());
+*/
+void Query::setRange(double min, double max) {
+  minValue = min;
+  maxValue = max;
+}
+
+/*
+  Whether the range is the default one, which every value (other than NaN)
+  is in.
+*/
+bool Query::unbounded() const {
+  return minValue == -std::numeric_limits<double>::infinity() &&
+         maxValue == std::numeric_limits<double>::infinity();
+}
+
+/*
+  Group and reduce the values of every Measure in an Areas object.
+
+  This makes a single pass over the areas, looking up each Measure's groups
+  once and then adding its contiguous values to them in order. When the
+  values are not grouped by year and the range is unbounded, each Measure is
+  summarised with the SIMD kernels of kernels.h instead.
+
+  @param areas
+    The Areas object to query
+
+  @return
+    The groups that have at least one value, in alphabetical order of their
+    measure codename then in order of year
+
+  @example
+    Query query;
+    query.setGroupBy(true, true);
+    for (const auto &group : query.aggregate(data)) {
+      std::cout << group.measure << " " << group.year << " "
+                << group.value << std::endl;
+    }
+*/
+std::vector<Query::Group> Query::aggregate(const Areas &areas) const {
+  std::map<Symbol, YearGroups> groups;
+  const Symbol everyMeasure;
+
+  for (const auto &areaPair : areas.getAreas()) {
+    for (const auto &measurePair : areaPair.second.getMeasures()) {
+      const auto &measure = measurePair.second;
+      const std::size_t length = measure.slots();
+      if (length == 0) {
+        continue;
+      }
+
+      auto &measureGroups = groups[byMeasure ? measurePair.first : everyMeasure];
+      const double* values = measure.data();
+
+      if (!byYear && unbounded()) {
+        measureGroups.cover(0, 1)->add(BethYw::summariseSeries(values, length));
+        continue;
+      }
+
+      GroupAccumulator* group = nullptr;
+      if (!byYear) {
+        group = measureGroups.cover(0, 1);
+      } else if (measure.isDense()) {
+        group = measureGroups.cover(measure.getFirstYear(), length);
+      }
+      if (group == nullptr) {
+        // The years are too far apart to give each one a slot
+        for (std::size_t i = 0; i < length; i++) {
+          if (inRange(values[i])) {
+            measureGroups.at(measure.getSlotYear(i)).add(values[i]);
+          }
+        }
+        continue;
+      }
+
+      const std::size_t step = byYear ? 1 : 0;
+      for (std::size_t i = 0; i < length; i++, group += step) {
+        // Years without a value are NaN, which no range contains
+        if (inRange(values[i])) {
+          group->add(values[i]);
+        }
+      }
+    }
+  }
+
+  std::vector<Group> results;
+  for (const auto &groupPair : groups) {
+    groupPair.second.forEach([&](int year, const GroupAccumulator &acc) {
+      if (acc.count == 0) {
+        return;
+      }
+
+      double value = 0;
+      switch (reduction) {
+      case Reduction::SUM:     value = acc.sum; break;
+      case Reduction::AVERAGE: value = acc.sum / acc.count; break;
+      case Reduction::MIN:     value = acc.min; break;
+      case Reduction::MAX:     value = acc.max; break;
+      }
+
+      results.push_back({groupPair.first, byYear ? year : 0, acc.count, value});
+    });
+  }
+  return results;
+}
+
+/*
+  Rank every (area, measure) pair in an Areas object by the Measure's
+  percentage difference (see Measure::getDifferenceAsPercentage()).
+
+  @param areas
+    The Areas object to query
+
+  @param k
+    The number of pairs to keep
+
+  @return
+    Up to k pairs, from the largest percentage difference to the smallest.
+    Equal percentage differences are in order of local authority code then
+    measure codename.
+
+  @example
+    Query query;
+    auto rows = query.top(data, 5);
+*/
+std::vector<Query::Ranked> Query::top(const Areas &areas, std::size_t k) const {
+  std::vector<Ranked> rows;
+  for (const auto &areaPair : areas.getAreas()) {
+    for (const auto &measurePair : areaPair.second.getMeasures()) {
+      const double value = measurePair.second.getDifferenceAsPercentage();
+      if (inRange(value)) {
+        rows.push_back({&areaPair.second, &measurePair.second, value});
+      }
+    }
+  }
+
+  // The rows are already in order of area then measure, which only needs
+  // to be kept for equal values
+  auto before = [](const Ranked &lhs, const Ranked &rhs) {
+    if (lhs.value != rhs.value) {
+      return lhs.value > rhs.value;
+    }
+    if (lhs.area != rhs.area) {
+      return lhs.area->getLocalAuthoritySymbol() < rhs.area->getLocalAuthoritySymbol();
+    }
+    return lhs.measure->getCodenameSymbol() < rhs.measure->getCodenameSymbol();
+  };
+
+  k = std::min(k, rows.size());
+  std::partial_sort(rows.begin(), rows.begin() + k, rows.end(), before);
+  rows.resize(k);
+  return rows;
+}
+
+/*
+  Write the results of aggregate() to an output stream as JSON, as an array
+  of objects with the keys count, measure (if grouped by measure), value and
+  year (if grouped by year), e.g.
+    [{"count":22,"measure":"pop","value":3063456.0,"year":2011}]
+
+  @param os
+    The stream to write to
+
+  @param groups
+    The results of aggregate()
+*/
+void Query::writeAggregateJSON(std::ostream &os,
+                               const std::vector<Group> &groups) const {
+  OutputBuffer out(os);
+
+  out.write('[');
+  bool first = true;
+  for (const auto &group : groups) {
+    if (!first) {
+      out.write(',');
+    }
+    first = false;
+
+    out.write("{\"count\":");
+    out.writeInteger(group.count);
+    if (byMeasure) {
+      out.write(",\"measure\":");
+      out.writeJSONString(group.measure.str());
+    }
+    out.write(",\"value\":");
+    out.writeJSONNumber(group.value);
+    if (byYear) {
+      out.write(",\"year\":");
+      out.writeInteger(group.year);
+    }
+    out.write('}');
+  }
+  out.write(']');
+}
+
+/*
+  Write the results of aggregate() to an output stream as a table, with
+  columns for the measure and year (if grouped by them), the number of
+  values in the group, and the reduced value to 6 decimal places.
+
+  @param os
+    The stream to write to
+
+  @param groups
+    The results of aggregate()
+*/
+void Query::writeAggregateTable(std::ostream &os,
+                                const std::vector<Group> &groups) const {
+  static const char* HEADINGS[] = {"Sum", "Average", "Min", "Max"};
+  OutputBuffer out(os);
+
+  if (groups.empty()) {
+    out.write("<no values>\n");
+    return;
+  }
+
+  // As with Areas::writeStatsTable(), each column is at least 15
+  // characters wide and always starts with a space
+  if (byMeasure) {
+    out.write(" ");
+    out.writePadded("Measure", 14);
+  }
+  if (byYear) {
+    out.write(" ");
+    out.writePadded("Year", 14);
+  }
+  out.write(" ");
+  out.writePadded("Count", 14);
+  out.write(" ");
+  out.writePadded(HEADINGS[static_cast<int>(reduction)], 14);
+  out.write('\n');
+
+  for (const auto &group : groups) {
+    if (byMeasure) {
+      out.write(" ");
+      out.writePadded(group.measure.str(), 14);
+    }
+    if (byYear) {
+      out.write(" ");
+      out.writeInteger(group.year, 14);
+    }
+    out.write(" ");
+    out.writeInteger(group.count, 14);
+    out.write(" ");
+    out.writeFixed(group.value, 6, 14);
+    out.write('\n');
+  }
+}
+
+/*
+  Write the results of top() to an output stream as JSON, as an array of
+  objects with the keys area, differencePercentage, measure and names, e.g.
+    [{"area":"W06000022","differencePercentage":4.2,"measure":"dens",
+    "names":{"cym":"Casnewydd","eng":"Newport"}}]
+
+  @param os
+    The stream to write to
+
+  @param rows
+    The results of top()
+*/
+void Query::writeTopJSON(std::ostream &os,
+                         const std::vector<Ranked> &rows) const {
+  OutputBuffer out(os);
+
+  out.write('[');
+  bool first = true;
+  for (const auto &row : rows) {
+    if (!first) {
+      out.write(',');
+    }
+    first = false;
+
+    out.write("{\"area\":");
+    out.writeJSONString(row.area->getLocalAuthoritySymbol().str());
+    out.write(",\"differencePercentage\":");
+    out.writeJSONNumber(row.value);
+    out.write(",\"measure\":");
+    out.writeJSONString(row.measure->getCodename());
+    out.write(",\"names\":");
+
+    const auto &names = row.area->getNames();
+    if (names.empty()) {
+      out.write("null");
+    } else {
+      out.write('{');
+      bool firstName = true;
+      for (const auto &namePair : names) {
+        if (!firstName) {
+          out.write(',');
+        }
+        firstName = false;
+        out.writeJSONString(namePair.first.str());
+        out.write(':');
+        out.writeJSONString(namePair.second.str());
+      }
+      out.write('}');
+    }
+    out.write('}');
+  }
+  out.write(']');
+}
+
+/*
+  Write the results of top() to an output stream as a table, with columns
+  for the rank, local authority code, measure codename and percentage
+  difference (to 6 decimal places), followed by the area's names.
+
+  @param os
+    The stream to write to
+
+  @param rows
+    The results of top()
+*/
+void Query::writeTopTable(std::ostream &os,
+                          const std::vector<Ranked> &rows) const {
+  static const Symbol LANG_ENG("eng");
+  static const Symbol LANG_CYM("cym");
+  OutputBuffer out(os);
+
+  if (rows.empty()) {
+    out.write("<no measures>\n");
+    return;
+  }
+
+  for (const char* heading : {"Rank", "Area", "Measure", "% Diff."}) {
+    out.write(" ");
+    out.writePadded(heading, 14);
+  }
+  out.write("  Name\n");
+
+  std::size_t rank = 1;
+  for (const auto &row : rows) {
+    out.write(" ");
+    out.writeInteger(rank++, 14);
+    out.write(" ");
+    out.writePadded(row.area->getLocalAuthoritySymbol().str(), 14);
+    out.write(" ");
+    out.writePadded(row.measure->getCodename(), 14);
+    out.write(" ");
+    out.writeFixed(row.value, 6, 14);
+    out.write("  ");
+
+    const auto &names = row.area->getNames();
+    auto eng = names.find(LANG_ENG);
+    auto cym = names.find(LANG_CYM);
+    if (eng != nullptr) {
+      out.write(eng->second.str());
+    }
+    if (cym != nullptr) {
+      out.write(" / ");
+      out.write(cym->second.str());
+    }
+    out.write('\n');
+  }
+}
+
+/*
+  Parse the name of a reduction, case-insensitively.
+
+  @param name
+    One of sum, avg (or average), min or max
+
+  @return
+    The reduction
+
+  @throws
+    std::invalid_argument if the name is not a reduction, with the message:
+    No reduction matches key: <name>
+
+  @example
+    auto reduction = Query::parseReduction("avg"); // Reduction::AVERAGE
+*/
+Query::Reduction Query::parseReduction(const std::string &name) {
+  std::string lower = name;
+  std::transform(lower.begin(), lower.end(), lower.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (lower == "sum") {
+    return Reduction::SUM;
+  } else if (lower == "avg" || lower == "average") {
+    return Reduction::AVERAGE;
+  } else if (lower == "min") {
+    return Reduction::MIN;
+  } else if (lower == "max") {
+    return Reduction::MAX;
+  }
+  throw std::invalid_argument("No reduction matches key: " + name);
+}
@@ -0,0 +1,93 @@
+#ifndef QUERY_H_
+#define QUERY_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the Query class, which answers
+  questions across all of the areas held by an Areas object (e.g. the total
+  population of Wales each year) without going through JSON.
+ */
+
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "areas.h"
+
+/*
+  A Query reduces or ranks the values of every Measure in an Areas object,
+  in a single pass over the areas and each Measure's contiguous values.
+
+  aggregate() groups the values by measure, by year, by both, or not at
+  all, and reduces each group to its sum, average, minimum or maximum.
+
+  top() ranks every (area, measure) pair by the Measure's percentage
+  difference, from largest to smallest, and keeps the first k.
+
+  Both only consider the values within the query's range (by default,
+  everything): the individual values for aggregate(), and the percentage
+  differences for top().
+*/
+class Query {
+public:
+  enum class Reduction { SUM, AVERAGE, MIN, MAX };
+
+  /*
+    One group of aggregate(). The measure is an empty Symbol if the values
+    are not grouped by measure, and the year is 0 if they are not grouped by
+    year.
+  */
+  struct Group {
+    Symbol measure;
+    int year;
+    std::size_t count;
+    double value;
+  };
+
+  /*
+    One row of top(). The pointers are into the Areas object that was
+    queried, and are valid for as long as it is not modified.
+  */
+  struct Ranked {
+    const Area* area;
+    const Measure* measure;
+    double value;
+  };
+
+  Query();
+
+  void setReduction(Reduction reduction);
+  void setGroupBy(bool measure, bool year);
+  void setRange(double min, double max);
+  bool inRange(double value) const {
+    return value >= minValue && value <= maxValue;
+  }
+
+  std::vector<Group> aggregate(const Areas& areas) const;
+  std::vector<Ranked> top(const Areas& areas, std::size_t k) const;
+
+  void writeAggregateJSON(std::ostream& os, const std::vector<Group>& groups) const;
+  void writeAggregateTable(std::ostream& os, const std::vector<Group>& groups) const;
+  void writeTopJSON(std::ostream& os, const std::vector<Ranked>& rows) const;
+  void writeTopTable(std::ostream& os, const std::vector<Ranked>& rows) const;
+
+  static Reduction parseReduction(const std::string& name);
+
+private:
+  Reduction reduction;
+  bool byMeasure;
+  bool byYear;
+  double minValue;
+  double maxValue;
+
+  bool unbounded() const;
+};
+
+#endif // QUERY_H_
@@ -0,0 +1,425 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the Server class. The sockets are
+  POSIX sockets, so serve() is not available on Windows, but handle() is.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include "bethyw.h"
+#include "filter.h"
+#include "server.h"
+
+/*
+  The query string options a request may give, i.e. those that shape the
+  output rather than what is imported. Options that take no value are
+  flagged.
+*/
+static const struct {
+  const char* name;
+  bool flag;
+} REQUEST_OPTIONS[] = {
+  {"areas", false},
+  {"measures", false},
+  {"years", false},
+  {"json", true},
+  {"stats-only", true},
+  {"aggregate", false},
+  {"group-by", false},
+  {"top", false},
+  {"range", false},
+};
+
+/*
+  Decode a percent-encoded query string component, in which '+' is also a
+  space.
+*/
+static std::string decodeComponent(const std::string &text) {
+  std::string decoded;
+  decoded.reserve(text.size());
+  for (std::size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '+') {
+      decoded += ' ';
+    } else if (text[i] == '%' && i + 2 < text.size() &&
+               std::isxdigit(static_cast<unsigned char>(text[i + 1])) &&
+               std::isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+      decoded += static_cast<char>(std::stoi(text.substr(i + 1, 2), nullptr, 16));
+      i += 2;
+    } else {
+      decoded += text[i];
+    }
+  }
+  return decoded;
+}
+
+/*
+  Turn a query string into the equivalent command line arguments.
+
+  @throws
+    std::invalid_argument if the query string has an option that a request
+    may not give
+*/
+static std::vector<std::string> queryArguments(const std::string &query) {
+  std::vector<std::string> arguments = {"bethyw"};
+
+  std::size_t start = 0;
+  while (start < query.size()) {
+    std::size_t end = query.find('&', start);
+    if (end == std::string::npos) {
+      end = query.size();
+    }
+    const std::string pair = query.substr(start, end - start);
+    start = end + 1;
+    if (pair.empty()) {
+      continue;
+    }
+
+    const std::size_t equals = pair.find('=');
+    const std::string name = decodeComponent(pair.substr(0, equals));
+    const std::string value = equals == std::string::npos
+        ? std::string()
+        : decodeComponent(pair.substr(equals + 1));
+
+    auto option = std::find_if(std::begin(REQUEST_OPTIONS),
+                               std::end(REQUEST_OPTIONS),
+                               [&](const auto &o) { return name == o.name; });
+    if (option == std::end(REQUEST_OPTIONS)) {
+      throw std::invalid_argument("Unknown query option: " + name);
+    }
+
+    if (option->flag) {
+      arguments.push_back("--" + name);
+    } else {
+      arguments.push_back("--" + name + "=" + value);
+    }
+  }
+
+  return arguments;
+}
+
+/*
+  The reason phrase of the status codes that handle() gives.
+*/
+static const char* reasonPhrase(int status) {
+  switch (status) {
+  case 200: return "OK";
+  case 400: return "Bad Request";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 408: return "Request Timeout";
+  case 503: return "Service Unavailable";
+  default:  return "Internal Server Error";
+  }
+}
+
+/*
+  Construct a Server for imported data.
+
+  @param live
+    The imported data, and the metadata index to validate requests against,
+    which must outlive the Server
+
+  @example
+    LiveAreas live(dir, datasets, filter, std::move(base), std::move(index));
+    Server server(live);
+    server.serve(8080, 4);
+*/
+Server::Server(LiveAreas &live) : live(live) {}
+
+/*
+  Answer a single request from the current Version of the data, once it
+  holds the datasets the request needs (importing any that have not been
+  imported yet). Otherwise this reads the shared data only, so it may be
+  called from several threads at once.
+
+  @param method
+    The request method, of which only GET is supported
+
+  @param target
+    The request target, i.e. the path (which must be /) and query string
+
+  @return
+    The response: the output for the query with status 200, or the error
+    message with a 4xx status
+
+  @example
+    auto response = server.handle("GET", "/?areas=W06000011&json");
+*/
+Server::Response Server::handle(const std::string &method,
+                                const std::string &target) const {
+  if (method != "GET") {
+    return {405, "text/plain; charset=utf-8", "Only GET is supported\n"};
+  }
+
+  const std::size_t question = target.find('?');
+  const std::string path = target.substr(0, question);
+  if (path != "/") {
+    return {404, "text/plain; charset=utf-8", "No such path: " + path + "\n"};
+  }
+
+  try {
+    const std::string query = question == std::string::npos
+        ? std::string()
+        : target.substr(question + 1);
+    const auto arguments = queryArguments(query);
+
+    // cxxopts wants a mutable argv, which it may reorder
+    std::vector<char*> argv;
+    for (const auto &argument : arguments) {
+      argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+    int argc = static_cast<int>(arguments.size());
+    char** argvp = argv.data();
+
+    auto options = BethYw::cxxoptsSetup();
+    auto args = options.parse(argc, argvp);
+
+    // Validate the request against the current Version's metadata index
+    const auto indexed = live.current();
+    const auto &index = indexed->index;
+    const auto areasFilter = BethYw::parseAreasArg(args, index);
+    const auto measuresFilter = BethYw::parseMeasuresArg(args, index);
+    const auto yearsFilter = args.count("years")
+        ? BethYw::parseYearsArg(args["years"].as<std::string>())
+        : YearFilterTuple(0, 0);
+    const Filter filter(&areasFilter, &measuresFilter, &yearsFilter);
+
+    // Hold on to this Version until the response is written, whatever is
+    // published meanwhile
+    const auto version = live.require(measuresFilter);
+
+    std::ostringstream body;
+    BethYw::writeOutput(body, version->data.select(filter), args);
+
+    return {200,
+            args.count("json") ? "application/json" : "text/plain; charset=utf-8",
+            body.str()};
+  } catch (const std::exception &e) {
+    return {400, "text/plain; charset=utf-8", std::string(e.what()) + "\n"};
+  }
+}
+
+#ifndef _WIN32
+/*
+  Write all of a buffer to a socket, giving up if the client has gone (or,
+  with MSG_DONTWAIT in `flags`, as soon as the socket would block).
+*/
+static void sendAll(int fd, const std::string &text, int flags = 0) {
+  std::size_t sent = 0;
+  while (sent < text.size()) {
+    const ssize_t n = send(fd, text.data() + sent, text.size() - sent, flags);
+    if (n <= 0) {
+      return;
+    }
+    sent += n;
+  }
+}
+
+/*
+  Write a response, with its status line and headers, to a socket and close
+  the connection.
+*/
+static void sendResponse(int fd, const Server::Response &response, int flags = 0) {
+  std::ostringstream head;
+  head << "HTTP/1.1 " << response.status << " " << reasonPhrase(response.status)
+       << "\r\nContent-Type: " << response.contentType
+       << "\r\nContent-Length: " << response.body.size()
+       << "\r\nConnection: close\r\n\r\n";
+  sendAll(fd, head.str() + response.body, flags);
+  close(fd);
+}
+
+/*
+  Read one request from a connection, answer it and close the connection.
+  A client that has not sent the whole request within REQUEST_TIMEOUT_MS
+  is answered with 408, so a slow or idle client cannot hold on to a worker
+  thread.
+
+  @param fd
+    The connected socket
+*/
+void Server::handleConnection(int fd) const {
+  // Bounds each send() of the response, for a client that stops reading
+  timeval sendTimeout{};
+  sendTimeout.tv_sec = REQUEST_TIMEOUT_MS / 1000;
+  sendTimeout.tv_usec = (REQUEST_TIMEOUT_MS % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+  const auto deadline = std::chrono::steady_clock::now()
+                        + std::chrono::milliseconds(REQUEST_TIMEOUT_MS);
+  std::string request;
+  char chunk[4096];
+  bool timedOut = false;
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < MAX_REQUEST_SIZE) {
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (wait.count() <= 0) {
+      timedOut = true;
+      break;
+    }
+    pollfd readable{fd, POLLIN, 0};
+    const int ready = poll(&readable, 1, wait.count());
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    } else if (ready == 0) {
+      timedOut = true;
+      break;
+    } else if (ready < 0) {
+      break;
+    }
+
+    const ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      break;
+    }
+    request.append(chunk, n);
+  }
+
+  Response response;
+  const std::size_t lineEnd = request.find("\r\n");
+  std::istringstream line(request.substr(0, lineEnd));
+  std::string method, target, version;
+  if (timedOut) {
+    response = {408, "text/plain; charset=utf-8", "Request timed out\n"};
+  } else if (lineEnd == std::string::npos || !(line >> method >> target >> version)) {
+    response = {400, "text/plain; charset=utf-8", "Malformed request\n"};
+  } else {
+    response = handle(method, target);
+  }
+
+  sendResponse(fd, response);
+}
+#endif
+
+/*
+  Listen for HTTP requests on a port of the loopback interface, and answer
+  them (see handle()) until the process is stopped. At most
+  MAX_QUEUED_CONNECTIONS accepted connections wait for a worker; a client
+  that arrives when the queue is full is answered with 503 at once, rather
+  than waiting for a worker with its timeout not yet started. If accept()
+  fails (e.g. when out of file descriptors), the next attempt waits
+  ACCEPT_BACKOFF_MS rather than spinning.
+
+  @param port
+    The TCP port to listen on
+
+  @param threads
+    The number of worker threads answering requests, or 0 for one per
+    hardware thread
+
+  @throws
+    std::runtime_error if the port cannot be listened on, or on platforms
+    without POSIX sockets
+
+  @example
+    LiveAreas live(dir, datasets, filter, std::move(base), std::move(index));
+    Server server(live);
+    server.serve(8080, 4);
+*/
+void Server::serve(unsigned short port, unsigned int threads) const {
+#ifdef _WIN32
+  (void) port;
+  (void) threads;
+  throw std::runtime_error("--serve is not supported on this platform");
+#else
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  const int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw std::runtime_error("Could not create a socket");
+  }
+  const int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listener, SOMAXCONN) != 0) {
+    close(listener);
+    throw std::runtime_error("Could not listen on port " + std::to_string(port));
+  }
+
+  // A client hanging up mid-response must not stop the server
+  signal(SIGPIPE, SIG_IGN);
+
+  // The accepted connections waiting for a worker
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<int> connections;
+
+  std::vector<std::thread> workers;
+  for (unsigned int i = 0; i < threads; i++) {
+    workers.emplace_back([&] {
+      while (true) {
+        int fd;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          ready.wait(lock, [&] { return !connections.empty(); });
+          fd = connections.front();
+          connections.pop_front();
+        }
+        handleConnection(fd);
+      }
+    });
+  }
+
+  std::cerr << "Serving on http://127.0.0.1:" << port << "/" << std::endl;
+  while (true) {
+    const int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno != EINTR && errno != ECONNABORTED) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ACCEPT_BACKOFF_MS));
+      }
+      continue;
+    }
+
+    bool queued = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (connections.size() < MAX_QUEUED_CONNECTIONS) {
+        connections.push_back(fd);
+        queued = true;
+      }
+    }
+    if (queued) {
+      ready.notify_one();
+    } else {
+      // Never block the accepting thread on a client
+      sendResponse(fd, {503, "text/plain; charset=utf-8", "Server busy\n"},
+                   MSG_DONTWAIT);
+    }
+  }
+#endif
+}
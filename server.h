@@ -0,0 +1,93 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the Server class, which keeps the
+  imported data in memory and answers queries for it over HTTP (--serve).
+ */
+
+#include <string>
+
+#include "live.h"
+
+/*
+  Server answers HTTP GET requests for the data in a LiveAreas object, which
+  is shared (read-only) by all of the requests. Each request is answered
+  from the Version of the data that holds the datasets it needs (see
+  LiveAreas::require(), which imports each dataset the first time a request
+  needs it), even if a newer one is published (see LiveAreas::reload())
+  before it finishes.
+
+  A request's query string takes the same options as the command line
+  (without the leading hyphens, and with the lists comma-separated as
+  usual), from: areas, measures, years, json, stats-only, aggregate,
+  group-by, top and range. They are parsed and validated exactly as
+  parseAreasArg(), parseMeasuresArg() and parseYearsArg() do, and the
+  matching data is written by the same table and JSON writers, e.g.
+
+    GET /?areas=W06000011,W06000010&measures=pop&years=2010-2015&json
+
+  gives the same output as
+
+    bethyw -a W06000011,W06000010 -m pop -y 2010-2015 -j
+
+  for the datasets the server was started with. Invalid options are
+  answered with 400 Bad Request and the error message.
+
+  Requests are handled concurrently by a fixed number of worker threads,
+  one connection (and request) at a time each, from a bounded queue of
+  accepted connections.
+*/
+class Server {
+public:
+  /*
+    The outcome of a request
+  */
+  struct Response {
+    int status;
+    std::string contentType;
+    std::string body;
+  };
+
+  /*
+    The largest request (line and headers) that is read
+  */
+  static constexpr std::size_t MAX_REQUEST_SIZE = 16 * 1024;
+
+  /*
+    How long, in milliseconds, a client has to send the whole of its
+    request, and to accept each part of the response, before the worker
+    thread gives up on it
+  */
+  static constexpr int REQUEST_TIMEOUT_MS = 10 * 1000;
+
+  /*
+    The most accepted connections that may wait for a worker thread; any
+    more are answered with 503 straight away
+  */
+  static constexpr std::size_t MAX_QUEUED_CONNECTIONS = 128;
+
+  /*
+    How long, in milliseconds, to wait before accepting again when accept()
+    fails, e.g. because the process has run out of file descriptors
+  */
+  static constexpr int ACCEPT_BACKOFF_MS = 100;
+
+  explicit Server(LiveAreas& live);
+
+  Response handle(const std::string& method, const std::string& target) const;
+  void serve(unsigned short port, unsigned int threads) const;
+
+private:
+  LiveAreas& live;
+
+  void handleConnection(int fd) const;
+};
+
+#endif // SERVER_H_
@@ -0,0 +1,525 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the Snapshot class, which reads
+  and writes the binary snapshot format.
+
+  A snapshot file is laid out as follows, with all integers little-endian:
+
+    "BYWSNAP\0"                  magic
+    u32                          format version
+    u64                          payload length
+    u64                          payload checksum (64-bit FNV-1a)
+
+  followed by the payload:
+
+    u32 n, n * (u32 len, bytes)  string table
+    u32                          query (string index)
+    u32 n, n * source            sources: path (string index), u64 size,
+                                 i64 modification time, u64 hash
+    u32 n, n * area              areas: code (string index), u32 n names
+                                 (language and name string indexes), u32 n
+                                 measures (key, codename and label string
+                                 indexes, u32 n values, n * i32 years,
+                                 n * f64 values)
+    u32 n, n * dataset           metadata index: dataset code (string
+                                 index), source as above, u32 n measure
+                                 codes (string indexes)
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "hash.h"
+#include "input.h"
+#include "output.h"
+#include "snapshot.h"
+
+/*
+  Identifies the snapshot format, and the version of it.
+*/
+static const char SNAPSHOT_MAGIC[8] = {'B', 'Y', 'W', 'S', 'N', 'A', 'P', '\0'};
+static const std::uint32_t SNAPSHOT_VERSION = 3;
+
+/*
+  The payload is read from the stream in chunks of this many bytes, so a
+  corrupt payload length makes the read fail at the end of the file rather
+  than allocating the whole length up front.
+*/
+static const std::size_t SNAPSHOT_READ_CHUNK = 1 << 20;
+
+/*
+  Check whether every source file of the Snapshot is unchanged.
+
+  @return
+    true if the Snapshot can be used in place of importing its sources
+*/
+bool Snapshot::isFresh() const {
+  for (const auto &source : sources) {
+    if (!source.matchesFile()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  Helpers for writing little-endian integers and table indexes.
+*/
+static void writeU32(std::ostream& os, std::uint32_t value) {
+  char bytes[4];
+  for (int i = 0; i < 4; i++) {
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+  os.write(bytes, sizeof(bytes));
+}
+
+static void writeU64(std::ostream& os, std::uint64_t value) {
+  char bytes[8];
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+  os.write(bytes, sizeof(bytes));
+}
+
+static void writeDouble(std::ostream& os, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeU64(os, bits);
+}
+
+/*
+  Builds the string table for a snapshot, giving each distinct string an
+  index the first time it is seen.
+*/
+class SnapshotStringTable {
+public:
+  std::uint32_t add(const std::string& str) {
+    auto it = indexes.find(str);
+    if (it != indexes.end()) {
+      return it->second;
+    }
+    std::uint32_t index = strings.size();
+    indexes.emplace(str, index);
+    strings.push_back(str);
+    return index;
+  }
+
+  std::uint32_t at(const std::string& str) const {
+    return indexes.at(str);
+  }
+
+  const std::vector<std::string>& all() const {
+    return strings;
+  }
+
+private:
+  std::unordered_map<std::string, std::uint32_t> indexes;
+  std::vector<std::string> strings;
+};
+
+/*
+  Write the Snapshot in the binary format to an output stream.
+
+  @param os
+    The output stream to write to, which should be opened in binary mode
+
+  @throws
+    std::runtime_error if the stream could not be written to
+
+  @example
+    std::ofstream file("bethyw.cache", std::ios::binary);
+    snapshot.write(file);
+*/
+void Snapshot::write(std::ostream& os) const {
+  // Intern every string first, so the table can be written up front
+  SnapshotStringTable table;
+  table.add(query);
+  for (const auto &source : sources) {
+    table.add(source.path);
+  }
+  for (const auto &areaPair : areas.getAreas()) {
+    table.add(areaPair.first);
+    for (const auto &name : areaPair.second.getNames()) {
+      table.add(name.first);
+      table.add(name.second);
+    }
+    for (const auto &measurePair : areaPair.second.getMeasures()) {
+      table.add(measurePair.first);
+      table.add(measurePair.second.getCodename());
+      table.add(measurePair.second.getLabel());
+    }
+  }
+  for (const auto &datasetPair : index.getDatasetMeasures()) {
+    table.add(datasetPair.first);
+    table.add(datasetPair.second.source.path);
+    for (const auto &code : datasetPair.second.codes) {
+      table.add(code);
+    }
+  }
+
+  // The payload is built in memory so its length and checksum can be
+  // written ahead of it
+  std::ostringstream out;
+  writeU32(out, table.all().size());
+  for (const auto &str : table.all()) {
+    writeU32(out, str.size());
+    out.write(str.data(), str.size());
+  }
+
+  writeU32(out, table.at(query));
+
+  auto writeSource = [&](const SourceFingerprint& source) {
+    writeU32(out, table.at(source.path));
+    writeU64(out, source.size);
+    writeU64(out, static_cast<std::uint64_t>(source.modified));
+    writeU64(out, source.hash);
+  };
+
+  writeU32(out, sources.size());
+  for (const auto &source : sources) {
+    writeSource(source);
+  }
+
+  writeU32(out, areas.getAreas().size());
+  for (const auto &areaPair : areas.getAreas()) {
+    const Area &area = areaPair.second;
+    writeU32(out, table.at(areaPair.first));
+
+    writeU32(out, area.getNames().size());
+    for (const auto &name : area.getNames()) {
+      writeU32(out, table.at(name.first));
+      writeU32(out, table.at(name.second));
+    }
+
+    writeU32(out, area.getMeasures().size());
+    for (const auto &measurePair : area.getMeasures()) {
+      const Measure &measure = measurePair.second;
+      writeU32(out, table.at(measurePair.first));
+      writeU32(out, table.at(measure.getCodename()));
+      writeU32(out, table.at(measure.getLabel()));
+
+      writeU32(out, measure.getYears().size());
+      for (const auto &yearPair : measure.getYears()) {
+        writeU32(out, static_cast<std::uint32_t>(yearPair.first));
+      }
+      for (const auto &yearPair : measure.getYears()) {
+        writeDouble(out, yearPair.second);
+      }
+    }
+  }
+
+  writeU32(out, index.getDatasetMeasures().size());
+  for (const auto &datasetPair : index.getDatasetMeasures()) {
+    writeU32(out, table.at(datasetPair.first));
+    writeSource(datasetPair.second.source);
+    writeU32(out, datasetPair.second.codes.size());
+    for (const auto &code : datasetPair.second.codes) {
+      writeU32(out, table.at(code));
+    }
+  }
+
+  const std::string payload = out.str();
+  os.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  writeU32(os, SNAPSHOT_VERSION);
+  writeU64(os, payload.size());
+  writeU64(os, fnv1a(payload));
+  os.write(payload.data(), payload.size());
+
+  if (!os) {
+    throw std::runtime_error("Snapshot::write: Failed to write snapshot");
+  }
+}
+
+/*
+  Read exactly `count` bytes from a stream.
+*/
+static void readBytes(std::istream& is, char* out, std::size_t count) {
+  is.read(out, count);
+  if (static_cast<std::size_t>(is.gcount()) != count) {
+    throw std::runtime_error("Snapshot::read: Unexpected end of snapshot");
+  }
+}
+
+static std::uint64_t readU64(std::istream& is) {
+  unsigned char in[8];
+  readBytes(is, reinterpret_cast<char*>(in), sizeof(in));
+  std::uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | in[i];
+  }
+  return value;
+}
+
+/*
+  Reads the payload of the binary format, checking that it is neither
+  truncated nor refers to strings outside of its string table. Every count
+  is checked against the bytes left, so a corrupt count cannot make the
+  reader allocate more than the payload could hold.
+*/
+class SnapshotReader {
+public:
+  SnapshotReader(std::string_view data) : data(data), pos(0) {}
+
+  std::size_t remaining() const {
+    return data.size() - pos;
+  }
+
+  std::string_view bytes(std::size_t count) {
+    if (count > remaining()) {
+      throw std::runtime_error("Snapshot::read: Unexpected end of snapshot");
+    }
+    std::string_view out = data.substr(pos, count);
+    pos += count;
+    return out;
+  }
+
+  std::uint32_t u32() {
+    std::string_view in = bytes(4);
+    std::uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+      value = (value << 8) | static_cast<unsigned char>(in[i]);
+    }
+    return value;
+  }
+
+  std::uint64_t u64() {
+    std::string_view in = bytes(8);
+    std::uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+      value = (value << 8) | static_cast<unsigned char>(in[i]);
+    }
+    return value;
+  }
+
+  double f64() {
+    std::uint64_t bits = u64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  /*
+    Read a count of items which each take at least `minBytes` bytes.
+  */
+  std::uint32_t count(std::size_t minBytes) {
+    std::uint32_t n = u32();
+    if (n > remaining() / minBytes) {
+      throw std::runtime_error("Snapshot::read: Corrupt snapshot");
+    }
+    return n;
+  }
+
+  const std::string& string() {
+    return strings.at(u32());
+  }
+
+  SourceFingerprint source() {
+    SourceFingerprint source;
+    source.path = string();
+    source.size = u64();
+    source.modified = static_cast<std::int64_t>(u64());
+    source.hash = u64();
+    return source;
+  }
+
+  std::vector<std::string> strings;
+
+private:
+  std::string_view data;
+  std::size_t pos;
+};
+
+/*
+  The smallest number of payload bytes taken by each kind of item, used to
+  bound the counts read from a snapshot.
+*/
+static const std::size_t SNAPSHOT_STRING_BYTES = 4;
+static const std::size_t SNAPSHOT_SOURCE_BYTES = 28;
+static const std::size_t SNAPSHOT_AREA_BYTES = 12;
+static const std::size_t SNAPSHOT_NAME_BYTES = 8;
+static const std::size_t SNAPSHOT_MEASURE_BYTES = 16;
+static const std::size_t SNAPSHOT_VALUE_BYTES = 12;
+static const std::size_t SNAPSHOT_CODE_BYTES = 4;
+
+/*
+  Read a Snapshot in the binary format from an input stream.
+
+  @param is
+    The input stream to read from, which should be opened in binary mode
+
+  @return
+    The Snapshot
+
+  @throws
+    std::runtime_error if the stream does not contain a valid snapshot
+
+  @example
+    std::ifstream file("bethyw.cache", std::ios::binary);
+    Snapshot snapshot = Snapshot::read(file);
+*/
+Snapshot Snapshot::read(std::istream& is) {
+  char magic[sizeof(SNAPSHOT_MAGIC)];
+  readBytes(is, magic, sizeof(magic));
+  if (std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+    throw std::runtime_error("Snapshot::read: Not a snapshot file");
+  }
+  char version[4];
+  readBytes(is, version, sizeof(version));
+  if (SnapshotReader(std::string_view(version, sizeof(version))).u32()
+      != SNAPSHOT_VERSION) {
+    throw std::runtime_error("Snapshot::read: Unsupported snapshot version");
+  }
+
+  try {
+    const std::uint64_t length = readU64(is);
+    const std::uint64_t expected = readU64(is);
+
+    std::string payload;
+    while (payload.size() < length) {
+      std::size_t chunk = std::min<std::uint64_t>(SNAPSHOT_READ_CHUNK,
+                                                  length - payload.size());
+      std::size_t offset = payload.size();
+      payload.resize(offset + chunk);
+      readBytes(is, &payload[offset], chunk);
+    }
+    if (fnv1a(payload) != expected) {
+      throw std::runtime_error("Snapshot::read: Corrupt snapshot");
+    }
+
+    SnapshotReader reader(payload);
+
+    std::uint32_t numStrings = reader.count(SNAPSHOT_STRING_BYTES);
+    reader.strings.reserve(numStrings);
+    for (std::uint32_t i = 0; i < numStrings; i++) {
+      std::size_t size = reader.u32();
+      reader.strings.emplace_back(reader.bytes(size));
+    }
+
+    Snapshot snapshot;
+    snapshot.query = reader.string();
+
+    std::uint32_t numSources = reader.count(SNAPSHOT_SOURCE_BYTES);
+    for (std::uint32_t i = 0; i < numSources; i++) {
+      snapshot.sources.push_back(reader.source());
+    }
+
+    std::uint32_t numAreas = reader.count(SNAPSHOT_AREA_BYTES);
+    for (std::uint32_t i = 0; i < numAreas; i++) {
+      Area area(reader.string());
+
+      std::uint32_t numNames = reader.count(SNAPSHOT_NAME_BYTES);
+      for (std::uint32_t n = 0; n < numNames; n++) {
+        const std::string &lang = reader.string();
+        area.setName(lang, reader.string());
+      }
+
+      std::uint32_t numMeasures = reader.count(SNAPSHOT_MEASURE_BYTES);
+      for (std::uint32_t m = 0; m < numMeasures; m++) {
+        const std::string &key = reader.string();
+        const std::string &codename = reader.string();
+        Measure measure(codename, reader.string());
+
+        // Years are written in ascending order, which also rules out the
+        // same year being given twice
+        std::vector<int> years(reader.count(SNAPSHOT_VALUE_BYTES));
+        for (std::size_t y = 0; y < years.size(); y++) {
+          years[y] = static_cast<int>(reader.u32());
+          if (y > 0 && years[y] <= years[y - 1]) {
+            throw std::runtime_error("Snapshot::read: Corrupt snapshot");
+          }
+        }
+        for (int year : years) {
+          measure.setValue(year, reader.f64());
+        }
+
+        area.setMeasure(key, measure);
+      }
+
+      snapshot.areas.setArea(area.getLocalAuthorityCode(), area);
+    }
+
+    std::uint32_t numDatasets = reader.count(SNAPSHOT_STRING_BYTES
+                                             + SNAPSHOT_SOURCE_BYTES
+                                             + SNAPSHOT_CODE_BYTES);
+    for (std::uint32_t i = 0; i < numDatasets; i++) {
+      const std::string &dataset = reader.string();
+      MetadataIndex::DatasetMeasures measures;
+      measures.source = reader.source();
+      measures.codes.resize(reader.count(SNAPSHOT_CODE_BYTES));
+      for (auto &code : measures.codes) {
+        code = reader.string();
+      }
+      snapshot.index.addMeasures(dataset, std::move(measures));
+    }
+
+    if (reader.remaining() != 0) {
+      throw std::runtime_error("Snapshot::read: Corrupt snapshot");
+    }
+
+    return snapshot;
+  } catch (const std::out_of_range &) {
+    throw std::runtime_error("Snapshot::read: Corrupt snapshot");
+  } catch (const std::length_error &) {
+    throw std::runtime_error("Snapshot::read: Corrupt snapshot");
+  } catch (const std::bad_alloc &) {
+    throw std::runtime_error("Snapshot::read: Corrupt snapshot");
+  }
+}
+
+/*
+  Save the Snapshot to a file. The snapshot is written to a temporary file
+  which then replaces `path` (see saveAtomically()), so a concurrent reader
+  never sees a partly written snapshot.
+
+  @param path
+    The path of the file to write
+
+  @throws
+    std::runtime_error if the file could not be written
+
+  @example
+    snapshot.save("bethyw.cache");
+*/
+void Snapshot::save(const std::string& path) const {
+  saveAtomically(path, [&](std::ostream& os) {
+    write(os);
+  });
+}
+
+/*
+  Load a Snapshot from a file.
+
+  @param path
+    The path of the file to read
+
+  @return
+    The Snapshot
+
+  @throws
+    std::runtime_error if the file could not be opened or is not a valid
+    snapshot
+
+  @example
+    Snapshot snapshot = Snapshot::load("bethyw.cache");
+    if (snapshot.isFresh()) {
+      ...
+    }
+*/
+Snapshot Snapshot::load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Snapshot::load: Failed to open file " + path);
+  }
+  return read(file);
+}
@@ -0,0 +1,51 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the Snapshot class, a compact binary
+  copy of a populated Areas object that can be saved to disk and loaded
+  again without parsing any of the source datasets.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "areas.h"
+#include "input.h"
+#include "metadata.h"
+
+/*
+  A Snapshot holds a populated Areas object, the query (i.e. the datasets
+  and filters) that produced it, fingerprints of the files it was
+  imported from, and the measure codes of the MetadataIndex used to
+  validate the query.
+
+  In the file, every string (area codes, names, measure codes and labels)
+  is stored once in a string table and referred to by its index, and each
+  Measure's years and values are stored as two contiguous arrays.
+*/
+class Snapshot {
+public:
+  std::string query;
+  std::vector<SourceFingerprint> sources;
+  Areas areas;
+  MetadataIndex index;
+
+  bool isFresh() const;
+
+  void write(std::ostream& os) const;
+  static Snapshot read(std::istream& is);
+
+  void save(const std::string& path) const;
+  static Snapshot load(const std::string& path);
+};
+
+#endif // SNAPSHOT_H_
@@ -0,0 +1,114 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the Symbol class and the global
+  interning table behind it.
+ */
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "symbol.h"
+
+/*
+  The interning table. Strings are kept in a std::deque, which never moves
+  its elements, and indexed by views of themselves so that they can be
+  looked up without constructing a std::string. Almost every lookup is of a
+  string that is already interned, so lookups only take a shared lock.
+*/
+class SymbolTable {
+public:
+  const std::string* find(std::string_view str) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = index.find(str);
+    return it == index.end() ? nullptr : it->second;
+  }
+
+  const std::string* intern(std::string_view str) {
+    if (const std::string* text = find(str)) {
+      return text;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = index.find(str);
+    if (it != index.end()) {
+      return it->second;
+    }
+    const std::string* text = &strings.emplace_back(str);
+    index.emplace(*text, text);
+    return text;
+  }
+
+  static SymbolTable& instance() {
+    static SymbolTable table;
+    return table;
+  }
+
+private:
+  std::shared_mutex mutex;
+  std::deque<std::string> strings;
+  std::unordered_map<std::string_view, const std::string*> index;
+};
+
+/*
+  The string referred to by the default Symbol. It is a function-local
+  static, so Symbols can be created during static initialisation.
+*/
+static const std::string* emptyText() {
+  static const std::string empty;
+  return &empty;
+}
+
+/*
+  Construct a Symbol for the empty string.
+*/
+Symbol::Symbol() : text(emptyText()) {}
+
+/*
+  Construct a Symbol for a string, adding the string to the interning table
+  if it is not there yet.
+
+  @param str
+    The string to intern
+
+  @example
+    Symbol code("pop");
+    Symbol again("pop");
+    bool same = code == again; // true
+*/
+Symbol::Symbol(std::string_view str)
+    : text(str.empty() ? emptyText()
+                       : SymbolTable::instance().intern(str)) {}
+
+/*
+  Find the Symbol for a string without interning it, e.g. to check a value
+  against a set of Symbols without growing the table for values that are
+  not in it.
+
+  @param str
+    The string to look up
+
+  @return
+    The Symbol for the string, or no value if it has never been interned
+
+  @example
+    auto code = Symbol::find("W06000023");
+    if (code && areasFilter.count(*code)) {
+      ...
+    }
+*/
+std::optional<Symbol> Symbol::find(std::string_view str) {
+  if (str.empty()) {
+    return Symbol();
+  }
+  if (const std::string* text = SymbolTable::instance().find(str)) {
+    return Symbol(text);
+  }
+  return std::nullopt;
+}
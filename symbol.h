@@ -0,0 +1,85 @@
+#ifndef SYMBOL_H_
+#define SYMBOL_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the Symbol class, a handle to a
+  string stored once in a global interning table. Area codes, measure codes,
+  labels and language codes repeat across thousands of Area and Measure
+  objects, so they are stored as Symbols rather than as copies.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/*
+  A Symbol refers to an interned string. Two Symbols are equal only if they
+  refer to the same interned string, so comparing or hashing them is an
+  integer operation. Ordering compares the strings themselves, so that
+  containers keyed by Symbols iterate in the same (alphabetical) order as
+  containers keyed by std::string.
+
+  The interning table is shared by all threads and is never emptied, so a
+  Symbol stays valid for the lifetime of the program.
+*/
+class Symbol {
+public:
+  Symbol();
+  explicit Symbol(std::string_view str);
+
+  static std::optional<Symbol> find(std::string_view str);
+
+  const std::string& str() const { return *text; }
+  operator const std::string&() const { return *text; }
+  bool empty() const { return text->empty(); }
+
+  /*
+    A number identifying the interned string, unique for the lifetime of
+    the program (but not between runs).
+  */
+  std::uintptr_t id() const { return reinterpret_cast<std::uintptr_t>(text); }
+
+  friend bool operator==(const Symbol& lhs, const Symbol& rhs) {
+    return lhs.text == rhs.text;
+  }
+
+  friend bool operator!=(const Symbol& lhs, const Symbol& rhs) {
+    return lhs.text != rhs.text;
+  }
+
+  friend bool operator<(const Symbol& lhs, const Symbol& rhs) {
+    return lhs.text != rhs.text && *lhs.text < *rhs.text;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const Symbol& symbol) {
+    return os << *symbol.text;
+  }
+
+private:
+  explicit Symbol(const std::string* text) : text(text) {}
+
+  const std::string* text;
+};
+
+namespace std {
+
+template <>
+struct hash<Symbol> {
+  std::size_t operator()(const Symbol& symbol) const noexcept {
+    return std::hash<std::uintptr_t>()(symbol.id());
+  }
+};
+
+} // namespace std
+
+#endif // SYMBOL_H_
@@ -0,0 +1,254 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the implementation of the synthetic dataset generator.
+  The values are pseudo-random but depend only on the shape (and its seed),
+  so the same shape always gives the same files.
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "output.h"
+#include "synthetic.h"
+
+/*
+  The local authority code of the i-th synthetic area, e.g. W90000001.
+  The W9 prefix keeps them apart from the real codes.
+*/
+static std::string areaCode(unsigned int i) {
+  std::string digits = std::to_string(i + 1);
+  return "W9" + std::string(digits.size() < 7 ? 7 - digits.size() : 0, '0') + digits;
+}
+
+/*
+  The column name of a source, or an empty string if it has none.
+*/
+static std::string column(const BethYw::InputFileSource &source,
+                          BethYw::SourceColumn col) {
+  auto it = source.COLS.find(col);
+  return it == source.COLS.end() ? std::string() : it->second;
+}
+
+/*
+  Write an areas.csv of the synthetic areas.
+*/
+static std::size_t writeAreasCSV(OutputBuffer &out,
+                                 const BethYw::InputFileSource &source,
+                                 const BethYw::SyntheticShape &shape) {
+  out.write(column(source, BethYw::AUTH_CODE));
+  out.write(',');
+  out.write(column(source, BethYw::AUTH_NAME_ENG));
+  out.write(',');
+  out.write(column(source, BethYw::AUTH_NAME_CYM));
+  out.write('\n');
+
+  for (unsigned int i = 0; i < shape.areas; i++) {
+    out.write(areaCode(i));
+    out.write(",Area ");
+    out.writeInteger(i + 1);
+    out.write(",Ardal ");
+    out.writeInteger(i + 1);
+    out.write('\n');
+  }
+  return shape.areas;
+}
+
+/*
+  Write a StatsWales-style JSON dataset, with one row per area, measure and
+  year, and the measure columns only if the source has them.
+*/
+static std::size_t writeWelshStatsJSON(OutputBuffer &out,
+                                       const BethYw::InputFileSource &source,
+                                       const BethYw::SyntheticShape &shape,
+                                       std::mt19937_64 &random) {
+  std::uniform_real_distribution<double> values(0, 100000);
+
+  const std::string codeColumn = column(source, BethYw::AUTH_CODE);
+  const std::string nameColumn = column(source, BethYw::AUTH_NAME_ENG);
+  const std::string measureColumn = column(source, BethYw::MEASURE_CODE);
+  const std::string labelColumn = column(source, BethYw::MEASURE_NAME);
+  const std::string yearColumn = column(source, BethYw::YEAR);
+  const std::string valueColumn = column(source, BethYw::VALUE);
+  const unsigned int measures = measureColumn.empty() ? 1 : shape.measures;
+
+  out.write("{\n  \"odata.metadata\":\"synthetic#");
+  out.write(source.CODE);
+  out.write("\",\"value\":[\n");
+
+  std::size_t rows = 0;
+  for (unsigned int a = 0; a < shape.areas; a++) {
+    for (unsigned int m = 0; m < measures; m++) {
+      for (unsigned int y = 0; y < shape.years; y++) {
+        out.write(rows == 0 ? "    {\n      " : ",{\n      ");
+        out.writeJSONString(valueColumn);
+        out.write(':');
+        out.writeJSONNumber(values(random));
+        out.write(',');
+        out.writeJSONString(codeColumn);
+        out.write(':');
+        out.writeJSONString(areaCode(a));
+        out.write(',');
+        out.writeJSONString(nameColumn);
+        out.write(":\"Area ");
+        out.writeInteger(a + 1);
+        out.write('"');
+        if (!measureColumn.empty()) {
+          out.write(',');
+          out.writeJSONString(measureColumn);
+          out.write(":\"M");
+          out.writeInteger(m + 1);
+          out.write('"');
+        }
+        if (!labelColumn.empty() && labelColumn != measureColumn) {
+          out.write(',');
+          out.writeJSONString(labelColumn);
+          out.write(":\"Measure ");
+          out.writeInteger(m + 1);
+          out.write('"');
+        }
+        out.write(',');
+        out.writeJSONString(yearColumn);
+        out.write(":\"");
+        out.writeInteger(shape.firstYear + y);
+        out.write("\"\n    }");
+        rows++;
+      }
+    }
+  }
+
+  out.write("\n  ]\n}");
+  return rows;
+}
+
+/*
+  Write an AuthorityByYearCSV dataset, with one row per area and a column
+  per year. As with the real files, the lines end with CRLF.
+*/
+static std::size_t writeAuthorityByYearCSV(OutputBuffer &out,
+                                           const BethYw::InputFileSource &source,
+                                           const BethYw::SyntheticShape &shape,
+                                           std::mt19937_64 &random) {
+  std::uniform_real_distribution<double> values(0, 100000);
+
+  out.write(column(source, BethYw::AUTH_CODE));
+  for (unsigned int y = 0; y < shape.years; y++) {
+    out.write(',');
+    out.writeInteger(shape.firstYear + y);
+  }
+  out.write("\r\n");
+
+  for (unsigned int a = 0; a < shape.areas; a++) {
+    out.write(areaCode(a));
+    for (unsigned int y = 0; y < shape.years; y++) {
+      out.write(',');
+      out.writeJSONNumber(values(random));
+    }
+    out.write("\r\n");
+  }
+  return shape.areas;
+}
+
+/*
+  Write a synthetic dataset in the format, and with the column names, of a
+  source (one of InputFiles::AREAS or InputFiles::DATASETS).
+
+  @param os
+    The stream to write to
+
+  @param source
+    The source whose format to follow
+
+  @param shape
+    The number of areas, measures and years
+
+  @return
+    The number of rows (i.e. JSON objects or CSV lines, not counting the
+    header) written
+
+  @throws
+    std::invalid_argument if the source's format is not supported
+
+  @example
+    std::ofstream file("popu1009.json");
+    BethYw::writeSynthetic(file, BethYw::InputFiles::POPDEN, {});
+*/
+std::size_t BethYw::writeSynthetic(std::ostream &os,
+                                   const InputFileSource &source,
+                                   const SyntheticShape &shape) {
+  // Each source gets its own values, whatever order they are written in
+  std::uint64_t sourceSeed = shape.seed;
+  for (unsigned char c : source.CODE) {
+    sourceSeed = (sourceSeed ^ c) * 1099511628211ull;
+  }
+  std::mt19937_64 random(sourceSeed);
+
+  OutputBuffer out(os);
+  switch (source.PARSER) {
+  case AuthorityCodeCSV:
+    return writeAreasCSV(out, source, shape);
+  case WelshStatsJSON:
+    return writeWelshStatsJSON(out, source, shape, random);
+  case AuthorityByYearCSV:
+    return writeAuthorityByYearCSV(out, source, shape, random);
+  default:
+    throw std::invalid_argument("No synthetic format for dataset: " + source.CODE);
+  }
+}
+
+/*
+  Write a synthetic areas.csv, and a synthetic version of every dataset in
+  InputFiles::DATASETS, to a directory (which is created if need be) under
+  their usual file names, so that the directory can be given to bethyw as
+  --dir.
+
+  @param dir
+    The directory to write to, ending with a directory separator
+
+  @param shape
+    The number of areas, measures and years
+
+  @return
+    The files written, starting with areas.csv
+
+  @throws
+    std::runtime_error if a file cannot be written
+
+  @example
+    BethYw::SyntheticShape shape;
+    shape.areas = 10000;
+    auto files = BethYw::generateSynthetic("/tmp/synthetic/", shape);
+*/
+std::vector<BethYw::SyntheticFile> BethYw::generateSynthetic(
+    const std::string &dir,
+    const SyntheticShape &shape) {
+  std::filesystem::create_directories(dir);
+
+  std::vector<const InputFileSource*> sources = {&InputFiles::AREAS};
+  for (const auto &dataset : InputFiles::DATASETS) {
+    sources.push_back(&dataset);
+  }
+
+  std::vector<SyntheticFile> files;
+  for (const auto* source : sources) {
+    const std::string path = dir + source->FILE;
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Could not write synthetic dataset " + path);
+    }
+
+    const std::size_t rows = writeSynthetic(file, *source, shape);
+    file.close();
+    if (!file) {
+      throw std::runtime_error("Could not write synthetic dataset " + path);
+    }
+    files.push_back({source, path, rows, std::filesystem::file_size(path)});
+  }
+  return files;
+}
@@ -0,0 +1,66 @@
+#ifndef SYNTHETIC_H_
+#define SYNTHETIC_H_
+
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  This file contains the declaration of the synthetic dataset generator,
+  which writes scaled-up datasets in the same formats as the files in the
+  datasets directory (e.g. for bethyw-bench).
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "datasets.h"
+
+namespace BethYw {
+
+/*
+  The size of a set of synthetic datasets: every dataset has a value for
+  each of `areas` areas, `measures` measures (or just one, for datasets of a
+  single measure) and `years` years from firstYear.
+*/
+struct SyntheticShape {
+  unsigned int areas = 1000;
+  unsigned int measures = 10;
+  unsigned int years = 30;
+  unsigned int firstYear = 1991;
+  std::uint64_t seed = 1;
+};
+
+/*
+  A synthetic file written by generateSynthetic()
+*/
+struct SyntheticFile {
+  const InputFileSource* source;
+  std::string path;
+  std::size_t rows;
+  std::uintmax_t bytes;
+};
+
+/*
+  Writes a synthetic areas.csv, and a synthetic version of every dataset in
+  InputFiles::DATASETS, to a directory under their usual file names.
+*/
+std::vector<SyntheticFile> generateSynthetic(const std::string& dir,
+                                             const SyntheticShape& shape);
+
+/*
+  Write a synthetic dataset of one source's format (and column names) to an
+  output stream, returning the number of rows written.
+*/
+std::size_t writeSynthetic(std::ostream& os,
+                           const InputFileSource& source,
+                           const SyntheticShape& shape);
+
+} // namespace BethYw
+
+#endif // SYNTHETIC_H_
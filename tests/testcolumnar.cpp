@@ -0,0 +1,385 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license
+
+  This file tests the Arrow IPC file written by ColumnarFile, by reading its
+  schema, dictionaries and record batches back at the byte level. It can be
+  run with:
+
+    bash build.sh testcolumnar && ./bin/bethyw-test
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../lib_catch.hpp"
+
+#include "../areas.h"
+#include "../columnar.h"
+
+/*
+  Reads the little-endian integers and flatbuffer tables of a file, failing
+  the test on any read outside of it.
+*/
+class ArrowBytes {
+public:
+  explicit ArrowBytes(const std::string& data) : data(data) {}
+
+  std::uint64_t uint(std::size_t pos, std::size_t size) const {
+    REQUIRE(pos + size <= data.size());
+    std::uint64_t value = 0;
+    for (std::size_t i = size; i > 0; i--) {
+      value = (value << 8) | static_cast<unsigned char>(data[pos + i - 1]);
+    }
+    return value;
+  }
+
+  std::uint32_t u32(std::size_t pos) const { return uint(pos, 4); }
+  std::int64_t i64(std::size_t pos) const { return uint(pos, 8); }
+
+  double f64(std::size_t pos) const {
+    std::uint64_t bits = uint(pos, 8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  const std::string& data;
+};
+
+/*
+  A flatbuffer table, of which a field is read by its slot in the schema
+  (.fbs) of the table, or its default if the table leaves the field out.
+*/
+class FlatTable {
+public:
+  FlatTable(const ArrowBytes& bytes, std::size_t pos)
+      : bytes(bytes), pos(pos) {
+    vtable = pos - static_cast<std::int32_t>(bytes.u32(pos));
+    vtableSize = bytes.uint(vtable, 2);
+  }
+
+  static FlatTable root(const ArrowBytes& bytes, std::size_t pos) {
+    REQUIRE(pos % 8 == 0);
+    return FlatTable(bytes, pos + bytes.u32(pos));
+  }
+
+  std::size_t field(std::size_t slot) const {
+    std::size_t entry = 4 + 2 * slot;
+    return entry < vtableSize ? bytes.uint(vtable + entry, 2) : 0;
+  }
+
+  std::int64_t scalar(std::size_t slot, std::size_t size) const {
+    std::size_t offset = field(slot);
+    if (offset == 0) {
+      return 0;
+    }
+    std::uint64_t value = bytes.uint(pos + offset, size);
+    if (size < 8 && (value >> (8 * size - 1)) != 0) {
+      value |= ~std::uint64_t(0) << (8 * size);
+    }
+    return static_cast<std::int64_t>(value);
+  }
+
+  bool has(std::size_t slot) const { return field(slot) != 0; }
+
+  FlatTable table(std::size_t slot) const {
+    REQUIRE(has(slot));
+    std::size_t at = pos + field(slot);
+    return FlatTable(bytes, at + bytes.u32(at));
+  }
+
+  // The position of the first element of a vector, and its length
+  std::pair<std::size_t, std::size_t> vector(std::size_t slot) const {
+    REQUIRE(has(slot));
+    std::size_t at = pos + field(slot);
+    at += bytes.u32(at);
+    return {at + 4, bytes.u32(at)};
+  }
+
+  std::vector<FlatTable> tables(std::size_t slot) const {
+    std::vector<FlatTable> out;
+    auto vec = vector(slot);
+    for (std::size_t i = 0; i < vec.second; i++) {
+      std::size_t at = vec.first + 4 * i;
+      out.emplace_back(bytes, at + bytes.u32(at));
+    }
+    return out;
+  }
+
+  std::string string(std::size_t slot) const {
+    auto vec = vector(slot);
+    REQUIRE(bytes.data.at(vec.first + vec.second) == '\0');
+    return bytes.data.substr(vec.first, vec.second);
+  }
+
+private:
+  const ArrowBytes& bytes;
+  std::size_t pos;
+  std::size_t vtable;
+  std::size_t vtableSize;
+};
+
+/*
+  The nodes and buffers of a record batch, and where its body starts
+*/
+struct ArrowBatch {
+  std::int64_t length;
+  std::vector<std::pair<std::int64_t, std::int64_t>> nodes;
+  std::vector<std::string> buffers;
+};
+
+static ArrowBatch readBatch(const ArrowBytes& bytes,
+                            const FlatTable& batch,
+                            std::size_t body) {
+  ArrowBatch out;
+  out.length = batch.scalar(0, 8);
+  auto nodes = batch.vector(1);
+  for (std::size_t i = 0; i < nodes.second; i++) {
+    out.nodes.emplace_back(bytes.i64(nodes.first + 16 * i),
+                           bytes.i64(nodes.first + 16 * i + 8));
+  }
+  auto buffers = batch.vector(2);
+  for (std::size_t i = 0; i < buffers.second; i++) {
+    std::int64_t offset = bytes.i64(buffers.first + 16 * i);
+    std::int64_t size = bytes.i64(buffers.first + 16 * i + 8);
+    REQUIRE(offset % 8 == 0);
+    out.buffers.push_back(bytes.data.substr(body + offset, size));
+  }
+  return out;
+}
+
+/*
+  Read the message of a footer Block, checking its sizes, and return its
+  header table and the position of its body.
+*/
+static std::pair<FlatTable, std::size_t> readBlock(const ArrowBytes& bytes,
+                                                   std::size_t pos) {
+  std::int64_t offset = bytes.i64(pos);
+  std::size_t metadataSize = bytes.u32(pos + 8);
+  std::int64_t bodySize = bytes.i64(pos + 16);
+  REQUIRE(offset % 8 == 0);
+  REQUIRE(bytes.u32(offset) == 0xFFFFFFFF);
+  REQUIRE(8 + bytes.u32(offset + 4) == metadataSize);
+
+  FlatTable message = FlatTable::root(bytes, offset + 8);
+  REQUIRE(message.scalar(0, 2) == 4);
+  REQUIRE(message.scalar(3, 8) == bodySize);
+  return {message, offset + metadataSize};
+}
+
+static std::string writeColumnar(const Areas& areas) {
+  std::ostringstream os(std::ios::binary);
+  ColumnarFile::write(os, areas);
+  return os.str();
+}
+
+static Areas makeAreas() {
+  Areas areas;
+
+  Area swansea("W06000011");
+  swansea.setName("eng", "Swansea");
+  swansea.setName("cym", "Abertawe");
+  Measure pop("pop", "Population");
+  pop.setValue(2011, 2.5);
+  pop.setValue(2010, 1.5);
+  swansea.setMeasure("pop", pop);
+  areas.setArea("W06000011", swansea);
+
+  Area carmarthenshire("W06000010");
+  carmarthenshire.setName("eng", "Carmarthenshire");
+  Measure dens("dens", "Density");
+  dens.setValue(2015, 3.0);
+  carmarthenshire.setMeasure("dens", dens);
+  areas.setArea("W06000010", carmarthenshire);
+
+  return areas;
+}
+
+TEST_CASE( "ColumnarFile writes the Arrow IPC file framing", "[ColumnarFile]" ) {
+  const std::string file = writeColumnar(makeAreas());
+  ArrowBytes bytes(file);
+
+  REQUIRE(file.substr(0, 8) == std::string("ARROW1\0\0", 8));
+  REQUIRE(file.substr(file.size() - 6) == "ARROW1");
+
+  const std::size_t footerSize = bytes.u32(file.size() - 10);
+  const std::size_t footerPos = file.size() - 10 - footerSize;
+  FlatTable footer = FlatTable::root(bytes, footerPos);
+  REQUIRE(footer.scalar(0, 2) == 4);
+
+  SECTION( "the stream of messages starts with the schema and ends before "
+           "the footer" ) {
+    std::vector<std::int64_t> headers;
+    std::size_t pos = 8;
+    while (true) {
+      REQUIRE(pos % 8 == 0);
+      REQUIRE(bytes.u32(pos) == 0xFFFFFFFF);
+      const std::size_t size = bytes.u32(pos + 4);
+      if (size == 0) {
+        break;
+      }
+      FlatTable message = FlatTable::root(bytes, pos + 8);
+      headers.push_back(message.scalar(1, 1));
+      pos += 8 + size + message.scalar(3, 8);
+    }
+    REQUIRE(pos + 8 == footerPos);
+
+    // The schema, the five dictionary batches, then one record batch
+    REQUIRE(headers == std::vector<std::int64_t>{1, 2, 2, 2, 2, 2, 3});
+  }
+
+  SECTION( "the footer schema describes the seven columns" ) {
+    std::vector<FlatTable> fields = footer.table(1).tables(1);
+    REQUIRE(fields.size() == 7);
+
+    const char* names[] = {"area_code", "name_eng", "name_cym",
+                           "measure_code", "measure_label", "year", "value"};
+    const std::int64_t types[] = {5, 5, 5, 5, 5, 2, 3};
+    const std::int64_t nullable[] = {0, 1, 1, 0, 0, 0, 0};
+    for (std::size_t i = 0; i < fields.size(); i++) {
+      REQUIRE(fields[i].string(0) == names[i]);
+      REQUIRE(fields[i].scalar(1, 1) == nullable[i]);
+      REQUIRE(fields[i].scalar(2, 1) == types[i]);
+      REQUIRE(fields[i].vector(5).second == 0);
+
+      if (i < 5) {
+        FlatTable dictionary = fields[i].table(4);
+        REQUIRE(dictionary.scalar(0, 8) == static_cast<std::int64_t>(i));
+        REQUIRE(dictionary.table(1).scalar(0, 4) == 32);
+        REQUIRE(dictionary.table(1).scalar(1, 1) == 1);
+      } else {
+        REQUIRE_FALSE(fields[i].has(4));
+      }
+    }
+
+    REQUIRE(fields[5].table(3).scalar(0, 4) == 32);
+    REQUIRE(fields[5].table(3).scalar(1, 1) == 1);
+    REQUIRE(fields[6].table(3).scalar(0, 2) == 2);
+  }
+
+  SECTION( "the dictionaries hold each string once, in the order first "
+           "seen" ) {
+    std::vector<std::vector<std::string>> dictionaries;
+    auto blocks = footer.vector(2);
+    REQUIRE(blocks.second == 5);
+    for (std::size_t b = 0; b < blocks.second; b++) {
+      auto message = readBlock(bytes, blocks.first + 24 * b);
+      REQUIRE(message.first.scalar(1, 1) == 2);
+
+      FlatTable batch = message.first.table(2);
+      REQUIRE(batch.scalar(0, 8) == static_cast<std::int64_t>(b));
+      ArrowBatch data = readBatch(bytes, batch.table(1), message.second);
+      REQUIRE(data.buffers.size() == 3);
+      REQUIRE(data.buffers[0].empty());
+
+      ArrowBytes offsets(data.buffers[1]);
+      REQUIRE(data.buffers[1].size()
+              == static_cast<std::size_t>(4 * (data.length + 1)));
+      std::vector<std::string> strings;
+      for (std::int64_t i = 0; i < data.length; i++) {
+        std::size_t start = offsets.u32(4 * i);
+        std::size_t end = offsets.u32(4 * (i + 1));
+        strings.push_back(data.buffers[2].substr(start, end - start));
+      }
+      dictionaries.push_back(strings);
+    }
+
+    using Strings = std::vector<std::string>;
+    REQUIRE(dictionaries[0] == Strings{"W06000010", "W06000011"});
+    REQUIRE(dictionaries[1] == Strings{"Carmarthenshire", "Swansea"});
+    REQUIRE(dictionaries[2] == Strings{"Abertawe"});
+    REQUIRE(dictionaries[3] == Strings{"dens", "pop"});
+    REQUIRE(dictionaries[4] == Strings{"Density", "Population"});
+  }
+
+  SECTION( "the record batch holds the rows by area, measure and year" ) {
+    auto blocks = footer.vector(3);
+    REQUIRE(blocks.second == 1);
+    auto message = readBlock(bytes, blocks.first);
+    REQUIRE(message.first.scalar(1, 1) == 3);
+    ArrowBatch data = readBatch(bytes, message.first.table(2), message.second);
+
+    REQUIRE(data.length == 3);
+    REQUIRE(data.nodes.size() == 7);
+    REQUIRE(data.buffers.size() == 14);
+
+    // Only name_cym has a null, for Carmarthenshire, so only it has a
+    // validity bitmap
+    for (std::size_t c = 0; c < 7; c++) {
+      REQUIRE(data.nodes[c].first == 3);
+      REQUIRE(data.nodes[c].second == (c == 2 ? 1 : 0));
+      REQUIRE(data.buffers[2 * c].empty() == (c != 2));
+    }
+    REQUIRE(data.buffers[4] == std::string(1, '\x06'));
+
+    const std::uint32_t indexes[5][3] = {
+      {0, 1, 1}, {0, 1, 1}, {0, 0, 0}, {0, 1, 1}, {0, 1, 1}};
+    for (std::size_t c = 0; c < 5; c++) {
+      ArrowBytes column(data.buffers[2 * c + 1]);
+      REQUIRE(data.buffers[2 * c + 1].size() == 12);
+      for (std::size_t row = 0; row < 3; row++) {
+        REQUIRE(column.u32(4 * row) == indexes[c][row]);
+      }
+    }
+
+    ArrowBytes years(data.buffers[11]);
+    REQUIRE(data.buffers[11].size() == 12);
+    REQUIRE(years.u32(0) == 2015);
+    REQUIRE(years.u32(4) == 2010);
+    REQUIRE(years.u32(8) == 2011);
+
+    ArrowBytes values(data.buffers[13]);
+    REQUIRE(data.buffers[13].size() == 24);
+    REQUIRE(values.f64(0) == 3.0);
+    REQUIRE(values.f64(8) == 1.5);
+    REQUIRE(values.f64(16) == 2.5);
+  }
+}
+
+TEST_CASE( "ColumnarFile splits the rows into batches of BATCH_ROWS",
+           "[ColumnarFile]" ) {
+  const std::size_t numRows = ColumnarFile::BATCH_ROWS + 10;
+
+  Areas areas;
+  Area area("W06000011");
+  Measure measure("pop", "Population");
+  for (std::size_t i = 0; i < numRows; i++) {
+    measure.setValue(i, i * 0.5);
+  }
+  area.setMeasure("pop", measure);
+  areas.setArea("W06000011", area);
+
+  const std::string file = writeColumnar(areas);
+  ArrowBytes bytes(file);
+  const std::size_t footerSize = bytes.u32(file.size() - 10);
+  FlatTable footer = FlatTable::root(bytes, file.size() - 10 - footerSize);
+
+  auto blocks = footer.vector(3);
+  REQUIRE(blocks.second == 2);
+
+  std::size_t row = 0;
+  for (std::size_t b = 0; b < blocks.second; b++) {
+    auto message = readBlock(bytes, blocks.first + 24 * b);
+    ArrowBatch data = readBatch(bytes, message.first.table(2), message.second);
+    REQUIRE(static_cast<std::size_t>(data.length)
+            == (b == 0 ? ColumnarFile::BATCH_ROWS : 10));
+
+    ArrowBytes years(data.buffers[11]);
+    ArrowBytes values(data.buffers[13]);
+    for (std::int64_t i = 0; i < data.length; i++, row++) {
+      REQUIRE(years.u32(4 * i) == row);
+      REQUIRE(values.f64(8 * i) == row * 0.5);
+    }
+  }
+  REQUIRE(row == numRows);
+}
@@ -0,0 +1,201 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license
+
+  This file tests the FlatHashMap and SortedVectorMap containers: that
+  both iterate their entries in order of their keys, however they were
+  inserted, and that FlatHashMap finds every key after it has grown. It
+  can be run with:
+
+    bash build.sh testcontainers && ./bin/bethyw-test
+ */
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../lib_catch.hpp"
+
+#include "../containers.h"
+
+/*
+  A hash that puts every key in the same slot, so that every lookup has to
+  probe past the other keys
+*/
+struct CollidingHash {
+  std::size_t operator()(int) const { return 42; }
+};
+
+/*
+  The keys of a container, in the order it iterates them
+*/
+template <typename Map>
+static std::vector<int> keysOf(const Map& map) {
+  std::vector<int> keys;
+  for (const auto& entry : map) {
+    keys.push_back(entry.first);
+  }
+  return keys;
+}
+
+/*
+  The keys -n, 7 - n, 14 - n, ... of n entries, in a random order, so none
+  is less than -n
+*/
+static std::vector<int> shuffledKeys(int n) {
+  std::vector<int> keys(n);
+  for (int i = 0; i < n; i++) {
+    keys[i] = i * 7 - n;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(371));
+  return keys;
+}
+
+TEST_CASE( "FlatHashMap iterates its entries in order of their keys",
+           "[FlatHashMap]" ) {
+  FlatHashMap<int, std::string> map;
+  REQUIRE(map.empty());
+  REQUIRE(map.begin() == map.end());
+
+  for (int key : {5, 1, 9, 3}) {
+    REQUIRE(map.try_emplace(key, std::to_string(key)).second);
+  }
+  REQUIRE(keysOf(map) == std::vector<int>{1, 3, 5, 9});
+
+  SECTION( "keys inserted after iterating are sorted in too" ) {
+    map.try_emplace(4, "4");
+    map.try_emplace(10, "10");
+    REQUIRE(keysOf(map) == std::vector<int>{1, 3, 4, 5, 9, 10});
+    REQUIRE(map.end() - map.begin() == 6);
+  }
+
+  SECTION( "inserting an existing key keeps its value" ) {
+    auto emplaced = map.try_emplace(5, "five");
+    REQUIRE_FALSE(emplaced.second);
+    REQUIRE(emplaced.first->second == "5");
+    REQUIRE(map.size() == 4);
+  }
+
+  SECTION( "operator[] inserts a default value for a missing key" ) {
+    REQUIRE(map[3] == "3");
+    REQUIRE(map[7].empty());
+    REQUIRE(keysOf(map) == std::vector<int>{1, 3, 5, 7, 9});
+  }
+
+  SECTION( "at() throws for a missing key" ) {
+    REQUIRE(map.at(9) == "9");
+    REQUIRE(map.find(2) == nullptr);
+    REQUIRE_THROWS_AS(map.at(2), std::out_of_range);
+  }
+
+  SECTION( "clear() removes every entry" ) {
+    map.clear();
+    REQUIRE(map.empty());
+    REQUIRE(map.find(1) == nullptr);
+    map.try_emplace(2, "2");
+    REQUIRE(keysOf(map) == std::vector<int>{2});
+  }
+}
+
+TEST_CASE( "FlatHashMap finds every key as it grows", "[FlatHashMap]" ) {
+  const std::vector<int> keys = shuffledKeys(5000);
+
+  FlatHashMap<int, int> map;
+  std::vector<const std::pair<const int, int>*> entries;
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    auto emplaced = map.try_emplace(keys[i], keys[i] * 2);
+    REQUIRE(emplaced.second);
+    entries.push_back(emplaced.first);
+  }
+  REQUIRE(map.size() == keys.size());
+
+  // The table has been rehashed many times, but the entries never move
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    REQUIRE(map.find(keys[i]) == entries[i]);
+    REQUIRE(map.at(keys[i]) == keys[i] * 2);
+  }
+  REQUIRE(map.find(-5001) == nullptr);
+
+  std::vector<int> sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+  REQUIRE(keysOf(map) == sorted);
+}
+
+TEST_CASE( "FlatHashMap copes with keys that all collide", "[FlatHashMap]" ) {
+  const std::vector<int> keys = shuffledKeys(300);
+
+  FlatHashMap<int, int, CollidingHash> map;
+  for (int key : keys) {
+    REQUIRE(map.try_emplace(key, -key).second);
+  }
+  for (int key : keys) {
+    REQUIRE(map.at(key) == -key);
+    REQUIRE_FALSE(map.try_emplace(key, 0).second);
+  }
+  REQUIRE(map.find(-301) == nullptr);
+  REQUIRE(map.size() == keys.size());
+}
+
+TEST_CASE( "FlatHashMap copies compare equal, in order", "[FlatHashMap]" ) {
+  FlatHashMap<int, int> map;
+  for (int key : shuffledKeys(100)) {
+    map.try_emplace(key, key);
+  }
+
+  FlatHashMap<int, int> copy(map);
+  REQUIRE(copy == map);
+  REQUIRE(keysOf(copy) == keysOf(map));
+
+  copy[0] = 1;
+  REQUIRE(copy != map);
+
+  FlatHashMap<int, int> assigned;
+  assigned.try_emplace(-1000000, 0);
+  assigned = map;
+  REQUIRE(assigned == map);
+  REQUIRE(assigned.find(-1000000) == nullptr);
+}
+
+TEST_CASE( "SortedVectorMap keeps its entries in order of their keys",
+           "[SortedVectorMap]" ) {
+  std::pmr::monotonic_buffer_resource arena;
+  SortedVectorMap<int, std::string> map(&arena);
+  REQUIRE(map.empty());
+
+  const std::vector<int> keys = shuffledKeys(200);
+  for (int key : keys) {
+    REQUIRE(map.try_emplace(key, std::to_string(key)).second);
+  }
+
+  std::vector<int> sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+  REQUIRE(keysOf(map) == sorted);
+  REQUIRE(map.size() == keys.size());
+
+  for (int key : keys) {
+    REQUIRE(map.at(key) == std::to_string(key));
+  }
+  REQUIRE(map.find(-201) == nullptr);
+  REQUIRE_THROWS_AS(map.at(-201), std::out_of_range);
+
+  auto emplaced = map.try_emplace(keys[0], "again");
+  REQUIRE_FALSE(emplaced.second);
+  REQUIRE(emplaced.first->second == std::to_string(keys[0]));
+
+  SortedVectorMap<int, std::string> copy(map, &arena);
+  REQUIRE(copy == map);
+  copy[-201] = "-201";
+  REQUIRE(copy != map);
+  REQUIRE(copy.size() == map.size() + 1);
+
+  map.clear();
+  REQUIRE(map.empty());
+}
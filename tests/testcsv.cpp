@@ -0,0 +1,147 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license
+
+  This file tests the CSVReader tokenizer, reading the same CSV from a
+  stream and from a buffer: quoted fields (with commas, escaped quotes and
+  line breaks), carriage returns and blank lines, splitting only as far as
+  the fields asked for, and the number conversions. It can be run with:
+
+    bash build.sh testcsv && ./bin/bethyw-test
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../lib_catch.hpp"
+
+#include "../csv.h"
+
+using Rows = std::vector<std::vector<std::string>>;
+
+/*
+  Copy a field, so that Catch (compiled as C++11) can print it if a check
+  of it fails
+*/
+static std::string str(std::string_view field) {
+  return std::string(field);
+}
+
+/*
+  Read every row of CSV text from a stream and from a buffer, checking that
+  both readers give the same rows.
+*/
+static Rows readRows(const std::string& csv) {
+  std::istringstream is(csv);
+  CSVReader streamReader(is);
+  CSVReader bufferReader{std::string_view(csv)};
+
+  Rows rows;
+  while (true) {
+    const bool fromStream = streamReader.next();
+    REQUIRE(bufferReader.next() == fromStream);
+    if (!fromStream) {
+      break;
+    }
+
+    REQUIRE(streamReader.size() == bufferReader.size());
+    std::vector<std::string> row;
+    for (std::size_t i = 0; i < streamReader.fields().size(); i++) {
+      REQUIRE(str(streamReader.field(i)) == str(bufferReader.field(i)));
+      row.emplace_back(streamReader.field(i));
+    }
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+TEST_CASE( "CSVReader splits unquoted rows into fields", "[CSVReader]" ) {
+  REQUIRE(readRows("a,b,c\n1,2,3\n") == Rows{{"a", "b", "c"}, {"1", "2", "3"}});
+  REQUIRE(readRows("a,,c\n,\n") == Rows{{"a", "", "c"}, {"", ""}});
+
+  SECTION( "the last line need not end with a newline" ) {
+    REQUIRE(readRows("a,b\n1,2") == Rows{{"a", "b"}, {"1", "2"}});
+  }
+
+  SECTION( "carriage returns are stripped and blank lines skipped" ) {
+    REQUIRE(readRows("a,b\r\n\r\n\n1,2\r\n\n") == Rows{{"a", "b"}, {"1", "2"}});
+  }
+
+  SECTION( "an empty input has no rows" ) {
+    REQUIRE(readRows("").empty());
+    REQUIRE(readRows("\n\r\n").empty());
+  }
+}
+
+TEST_CASE( "CSVReader unquotes quoted fields", "[CSVReader]" ) {
+  SECTION( "a quoted field may contain commas" ) {
+    REQUIRE(readRows("W06000015,\"Cardiff, City of\",Caerdydd\n")
+            == Rows{{"W06000015", "Cardiff, City of", "Caerdydd"}});
+  }
+
+  SECTION( "a doubled quote is an escaped quote" ) {
+    REQUIRE(readRows("\"say \"\"hi\"\"\",x\n") == Rows{{"say \"hi\"", "x"}});
+    REQUIRE(readRows("\"\"\"\",\"\"\n") == Rows{{"\"", ""}});
+  }
+
+  SECTION( "a quoted field may span lines" ) {
+    REQUIRE(readRows("a,\"line 1\nline 2\",b\nc,d\n")
+            == Rows{{"a", "line 1\nline 2", "b"}, {"c", "d"}});
+    REQUIRE(readRows("\"x\n\n,\ny\",z\r\n")
+            == Rows{{"x\n\n,\ny", "z"}});
+  }
+
+  SECTION( "text after a closing quote is ignored" ) {
+    REQUIRE(readRows("\"ab\"cd,e\n") == Rows{{"ab", "e"}});
+  }
+
+  SECTION( "unquoted rows after a quoted one are split as usual" ) {
+    REQUIRE(readRows("\"a,b\",c\nd,e\n\"f\"\n")
+            == Rows{{"a,b", "c"}, {"d", "e"}, {"f"}});
+  }
+}
+
+TEST_CASE( "CSVReader only splits a row as far as needed", "[CSVReader]" ) {
+  const std::string csv = "W06000011,Swansea,Abertawe\n"
+                          "\"W06000015\",\"Cardiff, City of\",Caerdydd\n";
+  CSVReader reader{std::string_view(csv)};
+
+  REQUIRE(reader.next());
+  REQUIRE(str(reader.firstField()) == "W06000011");
+  REQUIRE(reader.size() == 3);
+  REQUIRE(str(reader.field(2)) == "Abertawe");
+  REQUIRE(str(reader.field(1)) == "Swansea");
+  REQUIRE_THROWS_AS(reader.field(3), std::out_of_range);
+
+  REQUIRE(reader.next());
+  REQUIRE(str(reader.firstField()) == "W06000015");
+  REQUIRE(str(reader.field(1)) == "Cardiff, City of");
+  REQUIRE(reader.size() == 3);
+  REQUIRE(reader.offset() == csv.size());
+
+  REQUIRE_FALSE(reader.next());
+}
+
+TEST_CASE( "CSVReader converts fields to numbers", "[CSVReader]" ) {
+  REQUIRE(CSVReader::toDouble("12.5") == 12.5);
+  REQUIRE(CSVReader::toDouble(" +3e2\t") == 300.0);
+  REQUIRE(CSVReader::toDouble("-0.25") == -0.25);
+  REQUIRE(CSVReader::toInt("2015") == 2015);
+  REQUIRE(CSVReader::toInt(" -7 ") == -7);
+
+  REQUIRE_THROWS_AS(CSVReader::toDouble(""), std::runtime_error);
+  REQUIRE_THROWS_AS(CSVReader::toDouble("1.5x"), std::runtime_error);
+  REQUIRE_THROWS_AS(CSVReader::toDouble("12\n"), std::runtime_error);
+  REQUIRE_THROWS_AS(CSVReader::toInt("20.5"), std::runtime_error);
+  REQUIRE_THROWS_AS(CSVReader::toInt("99999999999"), std::runtime_error);
+  REQUIRE_THROWS_WITH(CSVReader::toInt("abc"),
+                      "CSVReader::toInt: Invalid integer abc");
+}
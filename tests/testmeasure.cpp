@@ -0,0 +1,248 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license
+
+  This file tests the storage of a Measure's values: gaps between years,
+  values set out of order, combining Measures, the sparse storage of
+  far-apart years, and moving a Measure. It can be run with:
+
+    bash build.sh testmeasure && ./bin/bethyw-test
+ */
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../lib_catch.hpp"
+
+#include "../measure.h"
+
+using YearValues = std::vector<std::pair<int, double>>;
+
+/*
+  The years and values of a Measure, in the order it iterates them
+*/
+static YearValues yearsOf(const Measure& measure) {
+  YearValues years;
+  for (const auto& yearPair : measure.getYears()) {
+    years.emplace_back(yearPair.first, yearPair.second);
+  }
+  return years;
+}
+
+/*
+  Check that the summary statistics of a Measure are those of its values.
+*/
+static void requireStats(const Measure& measure) {
+  const YearValues years = yearsOf(measure);
+  REQUIRE(measure.size() == static_cast<int>(years.size()));
+  REQUIRE_FALSE(years.empty());
+
+  double sum = 0;
+  double minValue = years.front().second;
+  double maxValue = years.front().second;
+  for (const auto& yearPair : years) {
+    sum += yearPair.second;
+    minValue = std::min(minValue, yearPair.second);
+    maxValue = std::max(maxValue, yearPair.second);
+  }
+  const double mean = sum / years.size();
+  double squares = 0;
+  for (const auto& yearPair : years) {
+    squares += (yearPair.second - mean) * (yearPair.second - mean);
+  }
+
+  REQUIRE(measure.getSum() == Approx(sum));
+  REQUIRE(measure.getMin() == minValue);
+  REQUIRE(measure.getMax() == maxValue);
+  REQUIRE(measure.getAverage() == Approx(mean));
+  REQUIRE(measure.getVariance() == Approx(squares / years.size()));
+  REQUIRE(measure.getFirstYear() == years.front().first);
+  REQUIRE(measure.getLastYear() == years.back().first);
+  REQUIRE(measure.getDifference()
+          == Approx(years.back().second - years.front().second));
+}
+
+TEST_CASE( "Measure leaves gaps for the years without a value", "[Measure]" ) {
+  Measure measure("pop", "Population");
+  measure.setValue(2010, 1.5);
+  measure.setValue(2015, 4.5);
+
+  REQUIRE(measure.isDense());
+  REQUIRE(measure.size() == 2);
+  REQUIRE(measure.slots() == 6);
+  for (std::size_t slot = 1; slot < 5; slot++) {
+    REQUIRE(std::isnan(measure.data()[slot]));
+  }
+
+  REQUIRE(yearsOf(measure) == YearValues{{2010, 1.5}, {2015, 4.5}});
+  REQUIRE(measure.getValue(2015) == 4.5);
+  REQUIRE_THROWS_AS(measure.getValue(2012), std::out_of_range);
+  REQUIRE_THROWS_AS(measure.getValue(2009), std::out_of_range);
+  REQUIRE_THROWS_AS(measure.getValue(2016), std::out_of_range);
+  requireStats(measure);
+
+  SECTION( "filling a gap keeps the years in order" ) {
+    measure.setValue(2012, 3.0);
+    REQUIRE(yearsOf(measure)
+            == YearValues{{2010, 1.5}, {2012, 3.0}, {2015, 4.5}});
+    REQUIRE(measure.slots() == 6);
+    requireStats(measure);
+  }
+}
+
+TEST_CASE( "Measure orders values set out of order", "[Measure]" ) {
+  Measure measure("pop", "Population");
+  measure.setValue(2015, 10);
+  measure.setValue(2010, -2);
+  measure.setValue(2012, 7);
+  measure.setValue(2020, 3);
+
+  REQUIRE(yearsOf(measure)
+          == YearValues{{2010, -2}, {2012, 7}, {2015, 10}, {2020, 3}});
+  REQUIRE(measure.getFirstYear() == 2010);
+  REQUIRE(measure.getLastYear() == 2020);
+  requireStats(measure);
+
+  SECTION( "replacing a value recalculates the statistics" ) {
+    measure.setValue(2015, -20);
+    REQUIRE(measure.size() == 4);
+    REQUIRE(measure.getValue(2015) == -20);
+    REQUIRE(measure.getMin() == -20);
+    requireStats(measure);
+  }
+
+  SECTION( "the same values in a different order compare equal" ) {
+    Measure other("pop", "Population");
+    other.setValue(2010, -2);
+    other.setValue(2012, 7);
+    other.setValue(2015, 10);
+    other.setValue(2020, 3);
+    REQUIRE(other == measure);
+
+    other.setValue(2020, 4);
+    REQUIRE_FALSE(other == measure);
+  }
+}
+
+TEST_CASE( "Measure combines the values of another Measure", "[Measure]" ) {
+  Measure measure("pop", "Population");
+  measure.setValue(2010, 1);
+  measure.setValue(2011, 2);
+
+  Measure other("pop", "Population");
+  other.setValue(2011, 20);
+  other.setValue(2012, 30);
+  other.setValue(2008, 5);
+
+  measure.combine(other);
+  REQUIRE(yearsOf(measure)
+          == YearValues{{2008, 5}, {2010, 1}, {2011, 20}, {2012, 30}});
+  requireStats(measure);
+
+  SECTION( "combining values after the last year only appends them" ) {
+    Measure later("pop", "Population");
+    later.setValue(2013, 40);
+    later.setValue(2014, 50);
+    measure.combine(later);
+    REQUIRE(measure.size() == 6);
+    REQUIRE(measure.getLastYear() == 2014);
+    requireStats(measure);
+  }
+}
+
+TEST_CASE( "Measure stores far-apart years sparsely", "[Measure]" ) {
+  SECTION( "years close enough together are stored densely" ) {
+    Measure measure("pop", "Population");
+    measure.setValue(0, 1);
+    measure.setValue(50, 2);
+    REQUIRE(measure.isDense());
+    REQUIRE(measure.slots() == 51);
+  }
+
+  Measure measure("pop", "Population");
+  measure.setValue(2000, 1);
+  measure.setValue(2001, 2);
+  measure.setValue(1, 3);
+  measure.setValue(2000000000, 4);
+
+  REQUIRE_FALSE(measure.isDense());
+  REQUIRE(measure.slots() == 4);
+  REQUIRE(yearsOf(measure)
+          == YearValues{{1, 3}, {2000, 1}, {2001, 2}, {2000000000, 4}});
+  for (std::size_t slot = 0; slot < measure.slots(); slot++) {
+    REQUIRE(measure.getValue(measure.getSlotYear(slot)) == measure.data()[slot]);
+  }
+  REQUIRE(measure.getValue(2000000000) == 4);
+  REQUIRE_THROWS_AS(measure.getValue(1000), std::out_of_range);
+  requireStats(measure);
+
+  SECTION( "values can still be added and replaced" ) {
+    measure.setValue(1500, 5);
+    measure.setValue(2001, 6);
+    REQUIRE(yearsOf(measure)
+            == YearValues{{1, 3}, {1500, 5}, {2000, 1}, {2001, 6}, {2000000000, 4}});
+    requireStats(measure);
+  }
+
+  SECTION( "combining with a far-apart Measure makes it sparse" ) {
+    Measure dense("pop", "Population");
+    dense.setValue(2010, 7);
+    dense.setValue(2011, 8);
+    dense.combine(measure);
+    REQUIRE_FALSE(dense.isDense());
+    REQUIRE(yearsOf(dense)
+            == YearValues{{1, 3}, {2000, 1}, {2001, 2}, {2010, 7},
+                          {2011, 8}, {2000000000, 4}});
+    requireStats(dense);
+  }
+
+  SECTION( "copies compare equal" ) {
+    Measure copy(measure);
+    REQUIRE(copy == measure);
+    REQUIRE(yearsOf(copy) == yearsOf(measure));
+  }
+}
+
+TEST_CASE( "Measure is left empty when moved from", "[Measure]" ) {
+  for (bool dense : {true, false}) {
+    Measure measure("pop", "Population");
+    measure.setValue(2010, 1);
+    measure.setValue(dense ? 2011 : 1000000, 2);
+    const YearValues years = yearsOf(measure);
+
+    Measure moved(std::move(measure));
+    REQUIRE(yearsOf(moved) == years);
+    REQUIRE(moved.getSum() == 3);
+
+    REQUIRE(measure.size() == 0);
+    REQUIRE(measure.getYears().empty());
+    REQUIRE(measure.slots() == 0);
+    REQUIRE(measure.isDense());
+    REQUIRE(measure.getSum() == 0);
+    REQUIRE(measure.getMax() == 0);
+    REQUIRE(measure.getAverage() == 0);
+    REQUIRE(measure.getCodename() == "pop");
+
+    Measure assigned("dens", "Density");
+    assigned.setValue(1990, 5);
+    assigned = std::move(moved);
+    REQUIRE(yearsOf(assigned) == years);
+    REQUIRE(assigned.getCodename() == "pop");
+    REQUIRE(moved.size() == 0);
+    REQUIRE(moved.getYears().empty());
+    REQUIRE(moved.getVariance() == 0);
+
+    // A moved-from Measure can be used again
+    moved.setValue(2020, 9);
+    REQUIRE(yearsOf(moved) == YearValues{{2020, 9}});
+    requireStats(moved);
+  }
+}
@@ -0,0 +1,232 @@
+/*
+  +---------------------------------------+
+  | BETH YW? WELSH GOVERNMENT DATA PARSER |
+  +---------------------------------------+
+
+  AUTHOR: <Sacad Muhumed>
+
+  Catch2 test script — https://github.com/catchorg/Catch2
+  Catch2 is licensed under the BOOST license
+
+  This file tests the snapshot file: that saving and loading a Snapshot
+  gives back the same data, and that a damaged file (a flipped byte, a
+  truncated file, the wrong magic or an impossible length) is rejected
+  quickly with an error rather than loaded. It can be run with:
+
+    bash build.sh testsnapshot && ./bin/bethyw-test
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "../lib_catch.hpp"
+
+#include "../hash.h"
+#include "../snapshot.h"
+
+/*
+  The header of a snapshot: its magic, version, payload length and payload
+  checksum
+*/
+static const std::size_t LENGTH_OFFSET = 12;
+static const std::size_t CHECKSUM_OFFSET = 20;
+static const std::size_t PAYLOAD_OFFSET = 28;
+
+/*
+  A Snapshot of two areas, with names, gaps in their years and a sparse
+  Measure, and the query and sources that produced it
+*/
+static Snapshot exampleSnapshot() {
+  Snapshot snapshot;
+  snapshot.query = "datasets=popden;areas=W06000011,W06000015";
+
+  SourceFingerprint source;
+  source.path = "datasets/popu1009.json";
+  source.size = 123456;
+  source.modified = -42;
+  source.hash = 0xFEDCBA9876543210ULL;
+  snapshot.sources.push_back(source);
+
+  Area swansea("W06000011");
+  swansea.setName("eng", "Swansea");
+  swansea.setName("cym", "Abertawe");
+  Measure pop("pop", "Population");
+  pop.setValue(2010, 239023);
+  pop.setValue(2015, 242316.5);
+  swansea.setMeasure("pop", pop);
+  Measure area("area", "Land area");
+  area.setValue(1, 0.25);
+  area.setValue(2000000000, -380);
+  swansea.setMeasure("area", area);
+  snapshot.areas.setArea("W06000011", swansea);
+
+  Area cardiff("W06000015");
+  cardiff.setName("eng", "Cardiff");
+  Measure dens("dens", "Population density");
+  dens.setValue(2011, 2492.5);
+  cardiff.setMeasure("dens", dens);
+  snapshot.areas.setArea("W06000015", cardiff);
+
+  MetadataIndex::DatasetMeasures measures;
+  measures.source = source;
+  measures.codes = {"pop", "dens", "area"};
+  snapshot.index.addMeasures("popden", measures);
+
+  return snapshot;
+}
+
+/*
+  The bytes of a Snapshot written in the binary format
+*/
+static std::string bytesOf(const Snapshot& snapshot) {
+  std::ostringstream os;
+  snapshot.write(os);
+  return os.str();
+}
+
+static Snapshot readBytes(const std::string& bytes) {
+  std::istringstream is(bytes);
+  return Snapshot::read(is);
+}
+
+static void putU64(std::string& bytes, std::size_t offset, std::uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    bytes[offset + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  }
+}
+
+/*
+  Rewrite the payload length and checksum of a snapshot after its payload
+  has been changed, so that reading it gets past the checksum
+*/
+static void resealPayload(std::string& bytes) {
+  const std::string_view payload = std::string_view(bytes).substr(PAYLOAD_OFFSET);
+  putU64(bytes, LENGTH_OFFSET, payload.size());
+  putU64(bytes, CHECKSUM_OFFSET, fnv1a(payload));
+}
+
+/*
+  Check that two Snapshots hold the same query, sources, areas and index.
+*/
+static void requireSame(const Snapshot& lhs, const Snapshot& rhs) {
+  REQUIRE(lhs.query == rhs.query);
+  REQUIRE(lhs.sources.size() == rhs.sources.size());
+  for (std::size_t i = 0; i < lhs.sources.size(); i++) {
+    REQUIRE(lhs.sources[i].path == rhs.sources[i].path);
+    REQUIRE(lhs.sources[i].size == rhs.sources[i].size);
+    REQUIRE(lhs.sources[i].modified == rhs.sources[i].modified);
+    REQUIRE(lhs.sources[i].hash == rhs.sources[i].hash);
+  }
+
+  REQUIRE(lhs.areas.size() == rhs.areas.size());
+  REQUIRE(lhs.areas.getAreas() == rhs.areas.getAreas());
+
+  const auto &lhsDatasets = lhs.index.getDatasetMeasures();
+  const auto &rhsDatasets = rhs.index.getDatasetMeasures();
+  REQUIRE(lhsDatasets.size() == rhsDatasets.size());
+  for (const auto &datasetPair : lhsDatasets) {
+    const auto &other = rhsDatasets.at(datasetPair.first);
+    REQUIRE(datasetPair.second.codes == other.codes);
+    REQUIRE(datasetPair.second.source.path == other.source.path);
+    REQUIRE(datasetPair.second.source.hash == other.source.hash);
+  }
+  REQUIRE(lhs.index.getMeasureCodes() == rhs.index.getMeasureCodes());
+}
+
+TEST_CASE( "Snapshot reads back what it writes", "[Snapshot]" ) {
+  const Snapshot snapshot = exampleSnapshot();
+  const std::string bytes = bytesOf(snapshot);
+
+  Snapshot read = readBytes(bytes);
+  requireSame(read, snapshot);
+  REQUIRE(read.areas.getArea("W06000011").getMeasure("area").getValue(
+              2000000000) == -380);
+
+  SECTION( "writing it again gives the same bytes" ) {
+    REQUIRE(bytesOf(read) == bytes);
+  }
+
+  SECTION( "an empty Snapshot reads back empty" ) {
+    const Snapshot empty = readBytes(bytesOf(Snapshot()));
+    REQUIRE(empty.query.empty());
+    REQUIRE(empty.sources.empty());
+    REQUIRE(empty.areas.size() == 0);
+  }
+
+  SECTION( "saving and loading a file gives back the same Snapshot" ) {
+    const std::string path = (std::filesystem::temp_directory_path()
+                              / "bethyw-testsnapshot.cache").string();
+    snapshot.save(path);
+    requireSame(Snapshot::load(path), snapshot);
+    REQUIRE_FALSE(std::filesystem::exists(path + ".tmp"));
+    std::remove(path.c_str());
+
+    REQUIRE_THROWS_WITH(Snapshot::load(path),
+                        "Snapshot::load: Failed to open file " + path);
+  }
+}
+
+TEST_CASE( "Snapshot rejects a damaged snapshot", "[Snapshot]" ) {
+  const std::string bytes = bytesOf(exampleSnapshot());
+
+  SECTION( "any changed byte of the payload fails the checksum" ) {
+    for (std::size_t i = PAYLOAD_OFFSET; i < bytes.size(); i++) {
+      std::string damaged = bytes;
+      damaged[i] ^= 0x10;
+      REQUIRE_THROWS_WITH(readBytes(damaged), "Snapshot::read: Corrupt snapshot");
+    }
+  }
+
+  SECTION( "a truncated snapshot ends unexpectedly" ) {
+    for (std::size_t size : {std::size_t(10), PAYLOAD_OFFSET - 1,
+                             PAYLOAD_OFFSET, bytes.size() - 1}) {
+      REQUIRE_THROWS_WITH(readBytes(bytes.substr(0, size)),
+                          "Snapshot::read: Unexpected end of snapshot");
+    }
+  }
+
+  SECTION( "a file without the magic is not a snapshot" ) {
+    REQUIRE_THROWS_WITH(readBytes("W06000011,Swansea,Abertawe\n"),
+                        "Snapshot::read: Not a snapshot file");
+
+    std::string version = bytes;
+    version[8] = 2;
+    REQUIRE_THROWS_WITH(readBytes(version),
+                        "Snapshot::read: Unsupported snapshot version");
+  }
+
+  SECTION( "a huge payload length fails without reading it all" ) {
+    std::string huge = bytes;
+    putU64(huge, LENGTH_OFFSET, UINT64_MAX);
+    REQUIRE_THROWS_WITH(readBytes(huge),
+                        "Snapshot::read: Unexpected end of snapshot");
+  }
+
+  SECTION( "a payload with a valid checksum is still checked" ) {
+    // More strings than the payload could hold
+    std::string strings = bytes;
+    for (int i = 0; i < 4; i++) {
+      strings[PAYLOAD_OFFSET + i] = static_cast<char>(0xFF);
+    }
+    resealPayload(strings);
+    REQUIRE_THROWS_WITH(readBytes(strings), "Snapshot::read: Corrupt snapshot");
+
+    // Bytes after the end of the data
+    std::string trailing = bytes + '\0';
+    resealPayload(trailing);
+    REQUIRE_THROWS_WITH(readBytes(trailing), "Snapshot::read: Corrupt snapshot");
+
+    // A table index past the end of the string table (the last index is
+    // that of the last measure code of the last dataset)
+    std::string index = bytes;
+    for (int i = 1; i <= 4; i++) {
+      index[index.size() - i] = static_cast<char>(0xFF);
+    }
+    resealPayload(index);
+    REQUIRE_THROWS_WITH(readBytes(index), "Snapshot::read: Corrupt snapshot");
+  }
+}